@@ -0,0 +1,112 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue for many producers (Dmitry Vyukov's ring).
+// Every cell carries a sequence number that tells producers and consumers
+// whose turn it is, so a push or pop is one CAS on the position plus one
+// release store, and nobody waits for anybody else. Used with a single
+// consumer (the UI thread), although pops are safe from several threads too.
+// A full queue rejects the push, the producer decides how to back off.
+template <typename T>
+class BoundedQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit BoundedQueue(int capacity)
+    {
+        size_t size = 2;
+        while ( size < size_t(capacity) ) {
+            size *= 2;
+        }
+        mMask = size - 1;
+        mCells.reset(new Cell[size]);
+        for ( size_t i = 0; i < size; i++ ) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mEnqueuePos.store(0, std::memory_order_relaxed);
+        mDequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool tryPush(T value)
+    {
+        Cell* cell;
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for ( ;; ) {
+            cell = &mCells[pos & mMask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+            if ( diff == 0 ) {
+                // cell is free, claim it
+                if ( mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ) {
+                    break;
+                }
+            } else if ( diff < 0 ) {
+                return false;  // full, the consumer has not freed this cell yet
+            } else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T* value)
+    {
+        Cell* cell;
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        for ( ;; ) {
+            cell = &mCells[pos & mMask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos + 1);
+            if ( diff == 0 ) {
+                if ( mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ) {
+                    break;
+                }
+            } else if ( diff < 0 ) {
+                return false;  // empty
+            } else {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        *value = std::move(cell->value);
+        cell->value = T();  // do not keep the payload alive until the cell is reused
+        cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    int capacity() const { return int(mMask + 1); }
+
+    // only a hint while producers are running
+    int sizeApprox() const
+    {
+        size_t head = mDequeuePos.load(std::memory_order_relaxed);
+        size_t tail = mEnqueuePos.load(std::memory_order_relaxed);
+        return tail > head ? int(tail - head) : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t mMask;
+
+    // producers and the consumer write different cache lines
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) std::atomic<size_t> mDequeuePos;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -9,10 +9,66 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    CityCbor.cpp \
+    CityDelegate.cpp \
+    CityExporter.cpp \
+    CityHistory.cpp \
+    CityJsonReader.cpp \
+    CityPublisher.cpp \
+    CityQuadtree.cpp \
+    CitySearch.cpp \
+    CitySnapshot.cpp \
+    CityStore.cpp \
+    CityTableModel.cpp \
+    CityUpdateQueue.cpp \
+    DashboardView.cpp \
+    DataLoader.cpp \
+    ForecastStrip.cpp \
+    Gazetteer.cpp \
+    GeoIndex.cpp \
+    IconCache.cpp \
+    JsonStreamReader.cpp \
     main.cpp \
+    MapView.cpp \
+    RefreshScheduler.cpp \
+    ResponseCache.cpp \
+    SwapOverlay.cpp \
+    Theme.cpp \
+    WeatherAPI.cpp \
+    WeatherLog.cpp \
     widget.cpp
 
 HEADERS += \
+    BoundedQueue.h \
+    CityCbor.h \
+    CityDelegate.h \
+    CityExporter.h \
+    CityHistory.h \
+    CityJsonReader.h \
+    CityPublisher.h \
+    CityQuadtree.h \
+    CitySearch.h \
+    CitySnapshot.h \
+    CityStore.h \
+    CityTableModel.h \
+    CityUpdateQueue.h \
+    CurveCache.h \
+    DashboardView.h \
+    DataLoader.h \
+    ForecastStrip.h \
+    Gazetteer.h \
+    GeoIndex.h \
+    IconCache.h \
+    JsonStreamReader.h \
+    MapView.h \
+    RefreshScheduler.h \
+    ResponseCache.h \
+    SeriesRenderer.h \
+    SwapOverlay.h \
+    Theme.h \
+    WeatherAPI.h \
+    WeatherLog.h \
+    WeatherType.h \
     widget.h
 
 # Default rules for deployment.
@@ -0,0 +1,289 @@
+#include "CityCbor.h"
+#include <QCborStreamReader>
+#include <QIODevice>
+
+static const quint64 SELF_DESCRIBE_TAG = 55799;
+static const int CITY_FIELDS = 10;
+static const int DAY_FIELDS = 8;
+
+static bool readString(QCborStreamReader& reader, QString* out)
+{
+    if ( !reader.isString() ) {
+        return false;
+    }
+
+    // short strings arrive in one chunk, the loop is for chunked ones
+    out->clear();
+    auto chunk = reader.readString();
+    while ( chunk.status == QCborStreamReader::Ok ) {
+        *out += chunk.data;
+        chunk = reader.readString();
+    }
+    return chunk.status == QCborStreamReader::EndOfString;
+}
+
+static bool readInteger(QCborStreamReader& reader, qint64* out)
+{
+    if ( !reader.isInteger() ) {
+        return false;
+    }
+    *out = reader.toInteger();
+    return reader.next();
+}
+
+static bool readFloat(QCborStreamReader& reader, float* out)
+{
+    if ( reader.isNull() ) {
+        *out = qQNaN();
+    } else if ( reader.isFloat16() ) {
+        *out = float(reader.toFloat16());
+    } else if ( reader.isFloat() ) {
+        *out = reader.toFloat();
+    } else if ( reader.isDouble() ) {
+        *out = float(reader.toDouble());
+    } else {
+        return false;
+    }
+    return reader.next();
+}
+
+// fields appended by a newer writer
+static bool skipRest(QCborStreamReader& reader)
+{
+    while ( reader.hasNext() ) {
+        if ( !reader.next() ) {
+            return false;
+        }
+    }
+    return reader.leaveContainer();
+}
+
+CityCborWriter::CityCborWriter(QIODevice* device, Framing framing) : mWriter(device), mFraming(framing)
+{
+    start();
+}
+
+CityCborWriter::CityCborWriter(QByteArray* data, Framing framing) : mWriter(data), mFraming(framing)
+{
+    start();
+}
+
+void CityCborWriter::start()
+{
+    if ( mFraming == CitiesOnly ) {
+        return;
+    }
+    mWriter.append(QCborTag(SELF_DESCRIBE_TAG));
+    mWriter.startArray();
+    mWriter.append(VERSION);
+}
+
+void CityCborWriter::write(const CityView& city)
+{
+    mWriter.startArray(CITY_FIELDS);
+    mWriter.append(city.city());
+    mWriter.append(city.dateWeek());
+    mWriter.append(city.temp());
+    mWriter.append(city.ganMao());
+    mWriter.append(city.pm25());
+    mWriter.append(city.humidity());
+    mWriter.append(city.quality());
+    if ( city.hasLocation() ) {
+        mWriter.append(city.latitude());
+        mWriter.append(city.longitude());
+    } else {
+        mWriter.appendNull();
+        mWriter.appendNull();
+    }
+
+    mWriter.startArray(quint64(city.dayCount()));
+    for ( int day = 0; day < city.dayCount(); day++ ) {
+        mWriter.startArray(DAY_FIELDS);
+        mWriter.append(city.week(day));
+        mWriter.append(city.date(day));
+        mWriter.append(quint8(city.type(day)));
+        mWriter.append(city.aqi(day));
+        mWriter.append(city.highTemp(day));
+        mWriter.append(city.lowTemp(day));
+        mWriter.append(city.fx(day));
+        mWriter.append(city.fl(day));
+        mWriter.endArray();
+    }
+    mWriter.endArray();
+
+    mWriter.endArray();
+}
+
+void CityCborWriter::finish()
+{
+    if ( mFraming == Batch ) {
+        mWriter.endArray();
+    }
+}
+
+QByteArray CityCborWriter::encode(const CityStore& store)
+{
+    QByteArray data;
+    CityCborWriter writer(&data);
+    for ( int i = 0; i < store.size(); i++ ) {
+        writer.write(store.view(i));
+    }
+    writer.finish();
+    return data;
+}
+
+QByteArray CityCborWriter::batchStart()
+{
+    // an empty batch is start and end, the end is the one break byte
+    return encode(CityStore()).chopped(1);
+}
+
+QByteArray CityCborWriter::batchEnd()
+{
+    return QByteArray(1, char(0xff));
+}
+
+CityCborReader::CityCborReader(CityStore* store)
+    : CityCborReader([store](const WeatherInfo& info) { store->upsert(info); })
+{
+}
+
+CityCborReader::CityCborReader(Sink sink) : mSink(sink), mCityCount(0), mBytesRead(0)
+{
+}
+
+bool CityCborReader::isCbor(const QByteArray& head)
+{
+    return head.startsWith("\xd9\xd9\xf7");
+}
+
+bool CityCborReader::read(QIODevice* device)
+{
+    QCborStreamReader reader(device);
+    return readBatch(reader);
+}
+
+bool CityCborReader::read(const QByteArray& data)
+{
+    QCborStreamReader reader(data);
+    return readBatch(reader);
+}
+
+bool CityCborReader::fail(QCborStreamReader& reader, const char* what)
+{
+    mErrorString = reader.lastError() != QCborError::NoError ? reader.lastError().toString()
+                   : QString("Unexpected %1 at byte %2").arg(what).arg(reader.currentOffset());
+    return false;
+}
+
+bool CityCborReader::readBatch(QCborStreamReader& reader)
+{
+    // 1. Tag and version
+    if ( !reader.isTag() || reader.toTag() != QCborTag(SELF_DESCRIBE_TAG) || !reader.next() ) {
+        return fail(reader, "start of batch");
+    }
+    qint64 version = 0;
+    if ( !reader.isArray() || !reader.enterContainer() || !readInteger(reader, &version) ) {
+        return fail(reader, "batch header");
+    }
+    if ( version != CityCborWriter::VERSION ) {
+        mErrorString = QString("City batch version %1, only %2 is known").arg(version).arg(CityCborWriter::VERSION);
+        return false;
+    }
+
+    // 2. Cities
+    while ( reader.hasNext() ) {
+        if ( !readCity(reader) ) {
+            return false;
+        }
+        mCityCount++;
+        mSink(mCity);
+    }
+    if ( !reader.leaveContainer() ) {
+        return fail(reader, "end of batch");
+    }
+
+    mBytesRead = reader.currentOffset();
+    return true;
+}
+
+bool CityCborReader::readCity(QCborStreamReader& reader)
+{
+    if ( !reader.isArray() || !reader.enterContainer() ) {
+        return fail(reader, "city");
+    }
+
+    qint64 temp = 0;
+    qint64 pm25 = 0;
+    qint64 humidity = 0;
+    bool ok = readString(reader, &mCity.city)
+              && readString(reader, &mCity.dateWeek)
+              && readInteger(reader, &temp)
+              && readString(reader, &mCity.ganMao)
+              && readInteger(reader, &pm25)
+              && readInteger(reader, &humidity)
+              && readString(reader, &mCity.quality)
+              && readFloat(reader, &mCity.latitude)
+              && readFloat(reader, &mCity.longitude)
+              && reader.isArray() && reader.enterContainer();
+    if ( !ok ) {
+        return fail(reader, "city field");
+    }
+    mCity.temp = qint8(temp);
+    mCity.pm25 = quint16(qBound<qint64>(0, pm25, 0xFFFF));
+    mCity.humidity = quint8(qBound<qint64>(0, humidity, 100));
+
+    mCity.weekList.clear();
+    mCity.dateList.clear();
+    mCity.typeList.clear();
+    mCity.qualityList.clear();
+    mCity.highTemp.clear();
+    mCity.lowTemp.clear();
+    mCity.fx.clear();
+    mCity.fl.clear();
+    while ( reader.hasNext() ) {
+        if ( !readDay(reader) ) {
+            return false;
+        }
+    }
+    if ( !reader.leaveContainer() || !skipRest(reader) ) {
+        return fail(reader, "end of city");
+    }
+    return true;
+}
+
+bool CityCborReader::readDay(QCborStreamReader& reader)
+{
+    QString week;
+    QString date;
+    QString fx;
+    qint64 type = 0;
+    qint64 aqi = 0;
+    qint64 high = 0;
+    qint64 low = 0;
+    qint64 fl = 0;
+    bool ok = reader.isArray() && reader.enterContainer()
+              && readString(reader, &week)
+              && readString(reader, &date)
+              && readInteger(reader, &type)
+              && readInteger(reader, &aqi)
+              && readInteger(reader, &high)
+              && readInteger(reader, &low)
+              && readString(reader, &fx)
+              && readInteger(reader, &fl)
+              && skipRest(reader);
+    if ( !ok ) {
+        return fail(reader, "day field");
+    }
+
+    bool known = type >= 0 && type < qint64(WeatherType::Count);
+    mCity.weekList.append(week);
+    mCity.dateList.append(date);
+    mCity.typeList.append(weatherTypeLabel(known ? WeatherType(type) : WeatherType::Unknown));
+    mCity.qualityList.append(quint16(qBound<qint64>(0, aqi, 0xFFFF)));
+    mCity.highTemp.append(qint8(high));
+    mCity.lowTemp.append(qint8(low));
+    mCity.fx.append(fx);
+    mCity.fl.append(quint8(qBound<qint64>(0, fl, 255)));
+    return true;
+}
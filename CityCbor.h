@@ -0,0 +1,92 @@
+#ifndef CITYCBOR_H
+#define CITYCBOR_H
+
+#include <QByteArray>
+#include <QCborStreamWriter>
+#include <QString>
+#include <functional>
+
+#include "CityStore.h"
+
+class QCborStreamReader;
+class QIODevice;
+
+// Binary city batches for the relay between the collector and the display
+// boxes, JSON stays the format for everything else. The schema is fixed,
+// fields are told apart by position, not by name:
+//
+//   55799(                        self-describe tag, marks the file as CBOR
+//     [_ 1,                       schema version, then any number of cities
+//        [name, dateWeek, temp, ganMao, pm25, humidity, quality,
+//         latitude, longitude,    float, null when unknown
+//         [[week, date, type, aqi, high, low, fx, fl], ...]]
+//     ])
+//
+// type is the WeatherType value. Readers skip fields they do not know at
+// the end of a city or day, so fields can be appended without a new
+// version; anything else bumps the version.
+
+// Writes cities straight from a CityStore as they come, without building
+// the batch first.
+class CityCborWriter
+{
+public:
+    static constexpr int VERSION = 1;
+
+    // CitiesOnly leaves out everything around the cities, for parts of a
+    // batch that are put together elsewhere (see CityExporter)
+    enum Framing { Batch, CitiesOnly };
+
+    explicit CityCborWriter(QIODevice* device, Framing framing = Batch);
+    explicit CityCborWriter(QByteArray* data, Framing framing = Batch);
+
+    void write(const CityView& city);
+    void finish();  // closes the batch, nothing can be written after it
+
+    static QByteArray encode(const CityStore& store);
+    // what a Batch writer puts before the first and after the last city
+    static QByteArray batchStart();
+    static QByteArray batchEnd();
+
+private:
+    void start();
+
+    QCborStreamWriter mWriter;
+    Framing mFraming;
+};
+
+// Reads a batch one city at a time, like CityJsonReader: only the city
+// being read is held in memory.
+class CityCborReader
+{
+public:
+    using Sink = std::function<void(const WeatherInfo&)>;
+
+    explicit CityCborReader(CityStore* store);  // cities are updated or appended
+    explicit CityCborReader(Sink sink);
+
+    bool read(QIODevice* device);
+    bool read(const QByteArray& data);
+
+    bool hasError() const { return !mErrorString.isEmpty(); }
+    QString errorString() const { return mErrorString; }
+    int cityCount() const { return mCityCount; }
+    qint64 bytesRead() const { return mBytesRead; }
+
+    // data (or its first bytes) starts like a batch
+    static bool isCbor(const QByteArray& head);
+
+private:
+    bool readBatch(QCborStreamReader& reader);
+    bool readCity(QCborStreamReader& reader);
+    bool readDay(QCborStreamReader& reader);
+    bool fail(QCborStreamReader& reader, const char* what);
+
+    Sink mSink;
+    WeatherInfo mCity;  // reused, so its lists keep their capacity
+    int mCityCount;
+    qint64 mBytesRead;
+    QString mErrorString;
+};
+
+#endif // CITYCBOR_H
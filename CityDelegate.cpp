@@ -0,0 +1,68 @@
+#include "CityDelegate.h"
+#include <QApplication>
+#include <QPainter>
+#include <QPainterPath>
+
+#include "CityTableModel.h"
+#include "IconCache.h"
+#include "Theme.h"
+
+static const int ICON_SIZE = 20;
+static const int MARGIN = 4;
+
+CityDelegate::CityDelegate(QObject* parent) : QStyledItemDelegate(parent)
+{
+}
+
+void CityDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    int column = index.column();
+    if ( column != CityTableModel::TypeColumn && column != CityTableModel::AqiColumn ) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    // 1. Background and selection from the style, without the text
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+    QString text = opt.text;
+    opt.text.clear();
+    QStyle* style = opt.widget ? opt.widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, opt.widget);
+
+    painter->save();
+    QRect rect = opt.rect.adjusted(MARGIN, MARGIN / 2, -MARGIN, -MARGIN / 2);
+    QColor textColor = opt.palette.color(opt.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text);
+
+    if ( column == CityTableModel::TypeColumn ) {
+        // 2. Weather Icon + Label
+        WeatherType type = WeatherType(index.data(CityTableModel::WeatherTypeRole).toInt());
+        qreal dpr = painter->device()->devicePixelRatioF();
+        QPixmap icon = IconCache::instance().pixmap(type, QSize(ICON_SIZE, ICON_SIZE), dpr);
+        painter->drawPixmap(rect.left(), rect.center().y() - ICON_SIZE / 2, icon);
+
+        painter->setPen(textColor);
+        painter->drawText(rect.adjusted(ICON_SIZE + MARGIN, 0, 0, 0), Qt::AlignLeft | Qt::AlignVCenter,
+                          opt.fontMetrics.elidedText(text, Qt::ElideRight, rect.width() - ICON_SIZE - MARGIN));
+    } else {
+        // 3. AQI Chip
+        int band = index.data(CityTableModel::AqiBandRole).toInt();
+        if ( band >= 0 ) {
+            QPainterPath path;
+            path.addRoundedRect(rect, 4, 4);
+            painter->setRenderHint(QPainter::Antialiasing, true);
+            painter->fillPath(path, Theme::aqiColor(band));
+            textColor = Qt::white;
+        }
+        painter->setPen(textColor);
+        painter->drawText(rect, Qt::AlignCenter, text);
+    }
+    painter->restore();
+}
+
+QSize CityDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QSize size = QStyledItemDelegate::sizeHint(option, index);
+    size.setHeight(ROW_HEIGHT);
+    return size;
+}
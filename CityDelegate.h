@@ -0,0 +1,23 @@
+#ifndef CITYDELEGATE_H
+#define CITYDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Compact painting for the CityTableModel cells: the weather column gets
+// its icon from the IconCache, the air quality column a colored AQI chip,
+// everything else is plain text. Every row has the same height, so the
+// view never has to measure rows to scroll.
+class CityDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    static const int ROW_HEIGHT = 28;
+
+    explicit CityDelegate(QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+};
+
+#endif // CITYDELEGATE_H
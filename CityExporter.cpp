@@ -0,0 +1,273 @@
+#include "CityExporter.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "CityCbor.h"
+#include "WeatherLog.h"
+
+static const int BUFFER_SIZE = 256 * 1024;  // bytes a shard collects before it writes them
+static const int MIN_SHARD = 4096;          // cities, smaller exports are not split
+static const char CSV_HEADER[] = "city,date_week,temp,ganmao,pm25,humidity,quality,latitude,longitude,"
+                                 "week,date,type,aqi,high,low,fx,fl\n";
+
+static void appendJsonString(QByteArray* out, const QString& str)
+{
+    QByteArray utf8 = str.toUtf8();
+    out->append('"');
+    bool plain = std::none_of(utf8.cbegin(), utf8.cend(), [](char c) { return c == '"' || c == '\\' || uchar(c) < 0x20; });
+    if ( plain ) {
+        out->append(utf8);
+    } else {
+        for ( char c : utf8 ) {
+            if ( c == '"' || c == '\\' ) {
+                out->append('\\').append(c);
+            } else if ( uchar(c) < 0x20 ) {
+                out->append("\\u00").append("0123456789abcdef"[uchar(c) >> 4]).append("0123456789abcdef"[c & 15]);
+            } else {
+                out->append(c);
+            }
+        }
+    }
+    out->append('"');
+}
+
+static void appendJsonDay(QByteArray* out, const CityView& city, int day, int year, int month)
+{
+    const QString& date = city.date(day);  // MM/dd
+    QLatin1String type = city.typeLabel(day);
+
+    // days only carry MM/dd, a forecast past new year or a yesterday before it changes the year
+    int dayMonth = date.left(2).toInt();
+    if ( month - dayMonth > 6 ) {
+        year++;
+    } else if ( dayMonth - month > 6 ) {
+        year--;
+    }
+
+    out->append("{\"week\":");
+    appendJsonString(out, city.week(day));
+    out->append(",\"ymd\":");
+    appendJsonString(out, QString::number(year) + '-' + date.left(2) + '-' + date.mid(3));
+    out->append(",\"type\":\"").append(type.data(), type.size()).append('"');
+    out->append(",\"aqi\":").append(QByteArray::number(city.aqi(day)));
+    out->append(",\"high\":\"高温 ").append(QByteArray::number(city.highTemp(day))).append("℃\"");
+    out->append(",\"low\":\"低温 ").append(QByteArray::number(city.lowTemp(day))).append("℃\"");
+    out->append(",\"fx\":");
+    appendJsonString(out, city.fx(day));
+    out->append(",\"fl\":\"").append(QByteArray::number(city.fl(day))).append("级\"}");
+}
+
+// one sojson city object, laid out the way CityJsonReader reads it
+static void appendJson(QByteArray* out, const CityView& city)
+{
+    // dateWeek is "yyyy/MM/dd weekday", the provider sends yyyyMMdd
+    QString date = city.dateWeek().left(10);
+    out->append("{\"status\":200,\"date\":");
+    appendJsonString(out, date.left(4) + date.mid(5, 2) + date.mid(8, 2));
+
+    out->append(",\"cityInfo\":{\"city\":");
+    appendJsonString(out, city.city());
+    if ( city.hasLocation() ) {
+        out->append(",\"lat\":").append(QByteArray::number(city.latitude(), 'g', 7));
+        out->append(",\"lon\":").append(QByteArray::number(city.longitude(), 'g', 7));
+    }
+
+    out->append("},\"data\":{\"wendu\":\"").append(QByteArray::number(city.temp())).append('"');
+    out->append(",\"ganmao\":");
+    appendJsonString(out, city.ganMao());
+    out->append(",\"pm25\":").append(QByteArray::number(city.pm25()));
+    out->append(",\"shidu\":\"").append(QByteArray::number(city.humidity())).append("%\"");
+    out->append(",\"quality\":");
+    appendJsonString(out, city.quality());
+
+    // the reader takes the first day as yesterday, the rest as the forecast
+    int year = date.left(4).toInt();
+    int month = date.mid(5, 2).toInt();
+    if ( city.dayCount() > 0 ) {
+        out->append(",\"yesterday\":");
+        appendJsonDay(out, city, 0, year, month);
+    }
+    out->append(",\"forecast\":[");
+    for ( int day = 1; day < city.dayCount(); day++ ) {
+        if ( day > 1 ) {
+            out->append(',');
+        }
+        appendJsonDay(out, city, day, year, month);
+    }
+    out->append("]}}");
+}
+
+static void appendCsvField(QByteArray* out, const QString& str)
+{
+    QByteArray utf8 = str.toUtf8();
+    if ( utf8.contains(',') || utf8.contains('"') || utf8.contains('\n') || utf8.contains('\r') ) {
+        out->append('"').append(utf8.replace("\"", "\"\"")).append('"');
+    } else {
+        out->append(utf8);
+    }
+}
+
+// one row per day, the city columns repeated on each
+static void appendCsv(QByteArray* out, const CityView& city)
+{
+    QByteArray prefix;
+    appendCsvField(&prefix, city.city());
+    prefix.append(',');
+    appendCsvField(&prefix, city.dateWeek());
+    prefix.append(',').append(QByteArray::number(city.temp())).append(',');
+    appendCsvField(&prefix, city.ganMao());
+    prefix.append(',').append(QByteArray::number(city.pm25()));
+    prefix.append(',').append(QByteArray::number(city.humidity())).append(',');
+    appendCsvField(&prefix, city.quality());
+    prefix.append(',');
+    if ( city.hasLocation() ) {
+        prefix.append(QByteArray::number(city.latitude(), 'g', 7)).append(',');
+        prefix.append(QByteArray::number(city.longitude(), 'g', 7)).append(',');
+    } else {
+        prefix.append(",,");
+    }
+
+    if ( city.dayCount() == 0 ) {
+        out->append(prefix).append(",,,,,,,\n");
+    }
+    for ( int day = 0; day < city.dayCount(); day++ ) {
+        QLatin1String type = city.typeLabel(day);
+        out->append(prefix);
+        appendCsvField(out, city.week(day));
+        out->append(',');
+        appendCsvField(out, city.date(day));
+        out->append(',').append(type.data(), type.size());
+        out->append(',').append(QByteArray::number(city.aqi(day)));
+        out->append(',').append(QByteArray::number(city.highTemp(day)));
+        out->append(',').append(QByteArray::number(city.lowTemp(day))).append(',');
+        appendCsvField(out, city.fx(day));
+        out->append(',').append(QByteArray::number(city.fl(day))).append('\n');
+    }
+}
+
+// cities [begin, end), BUFFER_SIZE bytes per write
+static bool writeShard(const CityStore& store, int begin, int end, CityExporter::Format format, QFileDevice* file)
+{
+    int i = begin;
+    while ( i < end ) {
+        QByteArray buffer;
+        buffer.reserve(BUFFER_SIZE + BUFFER_SIZE / 8);
+        if ( format == CityExporter::Cbor ) {
+            // no state between cities, so every buffer gets its own writer
+            CityCborWriter writer(&buffer, CityCborWriter::CitiesOnly);
+            for ( ; i < end && buffer.size() < BUFFER_SIZE; i++ ) {
+                writer.write(store.view(i));
+            }
+        } else {
+            for ( ; i < end && buffer.size() < BUFFER_SIZE; i++ ) {
+                if ( format == CityExporter::Csv ) {
+                    appendCsv(&buffer, store.view(i));
+                    continue;
+                }
+                if ( i > begin ) {
+                    buffer.append(',');
+                }
+                appendJson(&buffer, store.view(i));
+            }
+        }
+        if ( file->write(buffer) != buffer.size() ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CityExporter::Format CityExporter::formatFor(const QString& path)
+{
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if ( suffix == "csv" ) {
+        return Csv;
+    }
+    if ( suffix == "cbor" ) {
+        return Cbor;
+    }
+    return Json;
+}
+
+bool CityExporter::write(const CityStore& store, const QString& path, Format format, QString* error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile out(path);
+    if ( !out.open(QIODevice::WriteOnly) ) {
+        *error = out.errorString();
+        return false;
+    }
+    out.write(format == Json ? QByteArray("[") : format == Csv ? QByteArray(CSV_HEADER) : CityCborWriter::batchStart());
+
+    // 1. Shards: the first goes straight into the target, the others into
+    //    temporary files next to it
+    int shardCount = qBound(1, store.size() / MIN_SHARD, QThread::idealThreadCount());
+    std::vector<std::unique_ptr<QTemporaryFile>> parts;
+    QVector<QFileDevice*> shards{&out};
+    for ( int s = 1; s < shardCount; s++ ) {
+        parts.emplace_back(new QTemporaryFile(path + ".XXXXXX.part"));
+        if ( !parts.back()->open() ) {
+            *error = parts.back()->errorString();
+            return false;
+        }
+        shards.append(parts.back().get());
+    }
+
+    QVector<bool> written(shardCount);
+    QThreadPool pool;
+    pool.setMaxThreadCount(shardCount);
+    for ( int s = 0; s < shardCount; s++ ) {
+        int begin = int(qint64(store.size()) * s / shardCount);
+        int end = int(qint64(store.size()) * (s + 1) / shardCount);
+        QFileDevice* file = shards[s];
+        bool* done = &written[s];
+        pool.start([&store, begin, end, format, file, done]() { *done = writeShard(store, begin, end, format, file); });
+    }
+    pool.waitForDone();
+
+    // 2. The other shards appended in order
+    QByteArray chunk(BUFFER_SIZE, Qt::Uninitialized);
+    for ( int s = 0; s < shardCount; s++ ) {
+        if ( !written[s] ) {
+            *error = shards[s]->errorString();
+            return false;
+        }
+        if ( s == 0 ) {
+            continue;
+        }
+        if ( format == Json ) {
+            out.write(",");  // every shard holds at least MIN_SHARD cities
+        }
+        shards[s]->seek(0);
+        qint64 n = 0;
+        while ( (n = shards[s]->read(chunk.data(), chunk.size())) > 0 ) {
+            out.write(chunk.constData(), n);
+        }
+        if ( n < 0 ) {
+            *error = shards[s]->errorString();
+            return false;
+        }
+    }
+
+    // 3. Renamed over the target, a failed write anywhere above makes this fail
+    out.write(format == Json ? QByteArray("]\n") : format == Csv ? QByteArray() : CityCborWriter::batchEnd());
+    qint64 bytes = out.size();
+    if ( !out.commit() ) {
+        *error = out.errorString();
+        return false;
+    }
+
+    double seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+    qCDebug(lcWeatherPerf) << "CityExporter:" << store.size() << "cities," << bytes << "bytes," << shardCount << "shards,"
+                           << bytes / 1e6 / seconds << "MB/s";
+    return true;
+}
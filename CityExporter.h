@@ -0,0 +1,34 @@
+#ifndef CITYEXPORTER_H
+#define CITYEXPORTER_H
+
+#include <QString>
+
+#include "CityStore.h"
+
+// Writes a whole CityStore to one file without building the document in
+// memory first:
+//
+//   1. the cities are cut into shards that are encoded in parallel, each
+//      into its own temporary file next to the target, through a fixed
+//      size buffer
+//   2. the shards are copied in order into a QSaveFile, which is renamed
+//      over the target when everything is written
+//
+// Memory stays at a few buffers however many cities there are, and readers
+// of the target see the old file or the new one, never a partial one.
+//
+// JSON is an array of provider (sojson) city objects, so DataLoader::load()
+// reads an export back. CSV has one row per city and day, CBOR is a
+// CityCbor batch.
+class CityExporter
+{
+public:
+    enum Format { Json, Csv, Cbor };
+
+    static bool write(const CityStore& store, const QString& path, Format format, QString* error);
+
+    // from the suffix (.json, .csv, .cbor), JSON when it is none of them
+    static Format formatFor(const QString& path);
+};
+
+#endif // CITYEXPORTER_H
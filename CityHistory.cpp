@@ -0,0 +1,562 @@
+#include "CityHistory.h"
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <limits>
+
+#include "WeatherLog.h"
+
+static const quint32 HISTORY_MAGIC = 0x57434831;  // "WCH1"
+static const quint32 HISTORY_VERSION = 2;
+static const int MAX_BLOCK_BITS = 128 + CityHistory::BLOCK_SIZE * 140;  // first reading + the longest codes
+// a series in the head: empty name, sealed count, empty open block, state
+static const qint64 MIN_SERIES_BYTES = 4 + 4 + (8 + 8 + 4 + 4 + 4) + (8 + 8 + 4 * (2 + 1 + 1));
+
+static void put(QVector<quint64>* words, int* bitCount, quint64 value, int bits)
+{
+    if ( bits < 64 ) {
+        value &= (quint64(1) << bits) - 1;
+    }
+    int used = *bitCount & 63;
+    if ( used == 0 ) {
+        words->append(0);
+    }
+
+    int room = 64 - used;
+    if ( bits <= room ) {
+        words->last() |= value << (room - bits);
+    } else {
+        words->last() |= value >> (bits - room);
+        words->append(value << (64 - (bits - room)));
+    }
+    *bitCount += bits;
+}
+
+// reads what put() wrote, zeros past the end
+class BitReader
+{
+public:
+    BitReader(const QVector<quint64>& words) : mWords(words.constData()), mSize(words.size()), mPos(0) {}
+
+    bool bit() { return get(1) != 0; }
+
+    quint64 get(int bits)
+    {
+        int word = mPos >> 6;
+        int used = mPos & 63;
+        int room = 64 - used;
+        mPos += bits;
+
+        quint64 value = (at(word) << used) >> (64 - bits);
+        if ( bits > room ) {
+            value |= at(word + 1) >> (64 - (bits - room));
+        }
+        return value;
+    }
+
+    qint64 getSigned(int bits)
+    {
+        quint64 value = get(bits);
+        quint64 sign = quint64(1) << (bits - 1);
+        return qint64((value ^ sign) - sign);
+    }
+
+private:
+    quint64 at(int word) const { return word < mSize ? mWords[word] : 0; }
+
+    const quint64* mWords;
+    int mSize;
+    qint64 mPos;
+};
+
+static void valuesOf(const Observation& observation, quint16* values)
+{
+    values[0] = quint8(observation.temp);
+    values[1] = observation.humidity;
+    values[2] = observation.pm25;
+    values[3] = observation.aqi;
+}
+
+bool CityHistory::record(const WeatherInfo& info, qint64 time)
+{
+    return append(info.city, observe(info, time));
+}
+
+Observation CityHistory::observe(const WeatherInfo& info, qint64 time)
+{
+    Observation observation;
+    observation.time = time;
+    observation.temp = info.temp;
+    observation.humidity = info.humidity;
+    observation.pm25 = info.pm25;
+    observation.aqi = info.qualityList.isEmpty() ? 0 : info.qualityList[qMin(1, info.qualityList.size() - 1)];  // today
+    return observation;
+}
+
+bool CityHistory::append(const QString& city, const Observation& observation)
+{
+    auto it = mIds.constFind(city);
+    if ( it == mIds.constEnd() ) {
+        it = mIds.insert(city, mSeries.size());
+        mSeries.append(Series());
+        mSeries.last().city = city;
+    }
+    Series& series = mSeries[it.value()];
+
+    // in order, and not so far apart that the delta of delta overflows 32 bits
+    bool empty = series.open.count == 0 && series.blocks.isEmpty();
+    qint64 last = series.open.count > 0 ? series.open.last : empty ? 0 : series.blocks.last().last;
+    if ( !empty && (observation.time <= last || observation.time - last >= (qint64(1) << 31)) ) {
+        return false;
+    }
+
+    encode(&series, observation);
+    mObservations++;
+    if ( series.open.count == BLOCK_SIZE ) {
+        series.open.words.squeeze();
+        series.blocks.append(series.open);
+        series.open = Block();
+    }
+    return true;
+}
+
+void CityHistory::merge(const CityHistory& other)
+{
+    for ( const Series& series : other.mSeries ) {
+        other.scan(series.city, std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max(),
+                   [this, &series](const Observation& observation) { append(series.city, observation); });
+    }
+}
+
+void CityHistory::encode(Series* series, const Observation& observation)
+{
+    Block& block = series->open;
+    State& state = series->state;
+    quint16 values[VALUES];
+    valuesOf(observation, values);
+
+    // 1. First reading of a block, as it is
+    if ( block.count == 0 ) {
+        put(&block.words, &block.bitCount, quint64(observation.time), 64);
+        for ( int i = 0; i < VALUES; i++ ) {
+            put(&block.words, &block.bitCount, values[i], 16);
+        }
+        state = State();
+        std::copy(values, values + VALUES, state.value);
+        state.time = observation.time;
+        block.first = observation.time;
+        block.last = observation.time;
+        block.count = 1;
+        return;
+    }
+
+    // 2. Time, delta of delta
+    qint64 delta = observation.time - state.time;
+    qint64 dod = delta - state.delta;
+    if ( dod == 0 ) {
+        put(&block.words, &block.bitCount, 0, 1);
+    } else if ( dod >= -64 && dod < 64 ) {
+        put(&block.words, &block.bitCount, 0b10, 2);
+        put(&block.words, &block.bitCount, quint64(dod), 7);
+    } else if ( dod >= -256 && dod < 256 ) {
+        put(&block.words, &block.bitCount, 0b110, 3);
+        put(&block.words, &block.bitCount, quint64(dod), 9);
+    } else if ( dod >= -2048 && dod < 2048 ) {
+        put(&block.words, &block.bitCount, 0b1110, 4);
+        put(&block.words, &block.bitCount, quint64(dod), 12);
+    } else {
+        put(&block.words, &block.bitCount, 0b1111, 4);
+        put(&block.words, &block.bitCount, quint64(dod), 32);
+    }
+    state.time = observation.time;
+    state.delta = delta;
+
+    // 3. Values, XOR
+    for ( int i = 0; i < VALUES; i++ ) {
+        quint16 x = values[i] ^ state.value[i];
+        state.value[i] = values[i];
+        if ( x == 0 ) {
+            put(&block.words, &block.bitCount, 0, 1);
+            continue;
+        }
+
+        int leading = qCountLeadingZeroBits(x);
+        int trailing = qCountTrailingZeroBits(x);
+        int meaningful = state.meaningful[i];
+        int shift = 16 - state.leading[i] - meaningful;
+        if ( meaningful > 0 && leading >= state.leading[i] && trailing >= shift ) {
+            put(&block.words, &block.bitCount, 0b10, 2);
+            put(&block.words, &block.bitCount, x >> shift, meaningful);
+        } else {
+            meaningful = 16 - leading - trailing;
+            put(&block.words, &block.bitCount, 0b11, 2);
+            put(&block.words, &block.bitCount, quint64(leading), 4);
+            put(&block.words, &block.bitCount, quint64(meaningful - 1), 4);
+            put(&block.words, &block.bitCount, x >> trailing, meaningful);
+            state.leading[i] = quint8(leading);
+            state.meaningful[i] = quint8(meaningful);
+        }
+    }
+    block.last = observation.time;
+    block.count++;
+}
+
+void CityHistory::decode(const Block& block, qint64 from, qint64 to, const std::function<void(const Observation&)>& visit)
+{
+    BitReader in(block.words);
+    qint64 time = 0;
+    qint64 delta = 0;
+    quint16 values[VALUES] = {};
+    int leading[VALUES] = {};
+    int meaningful[VALUES] = {};
+
+    for ( int n = 0; n < block.count; n++ ) {
+        if ( n == 0 ) {
+            time = qint64(in.get(64));
+            for ( int i = 0; i < VALUES; i++ ) {
+                values[i] = quint16(in.get(16));
+            }
+        } else {
+            qint64 dod = !in.bit() ? 0
+                         : !in.bit() ? in.getSigned(7)
+                         : !in.bit() ? in.getSigned(9)
+                         : !in.bit() ? in.getSigned(12)
+                         : in.getSigned(32);
+            delta += dod;
+            time += delta;
+
+            for ( int i = 0; i < VALUES; i++ ) {
+                if ( !in.bit() ) {
+                    continue;
+                }
+                if ( in.bit() ) {
+                    leading[i] = int(in.get(4));
+                    meaningful[i] = int(in.get(4)) + 1;
+                }
+                if ( meaningful[i] == 0 || leading[i] + meaningful[i] > 16 ) {
+                    return;  // no window to reuse, not written by encode()
+                }
+                values[i] ^= quint16(in.get(meaningful[i]) << (16 - leading[i] - meaningful[i]));
+            }
+        }
+
+        if ( time > to ) {
+            return;
+        }
+        if ( time >= from ) {
+            Observation observation;
+            observation.time = time;
+            observation.temp = qint8(quint8(values[0]));
+            observation.humidity = quint8(values[1]);
+            observation.pm25 = values[2];
+            observation.aqi = values[3];
+            visit(observation);
+        }
+    }
+}
+
+int CityHistory::scan(const QString& city, qint64 from, qint64 to, const std::function<void(const Observation&)>& visit) const
+{
+    auto it = mIds.constFind(city);
+    if ( it == mIds.constEnd() || from > to ) {
+        return 0;
+    }
+    const Series& series = mSeries[it.value()];
+
+    // first block that ends at or after from, then on until one starts after to
+    int decoded = 0;
+    auto block = std::lower_bound(series.blocks.cbegin(), series.blocks.cend(), from,
+                                  [](const Block& b, qint64 time) { return b.last < time; });
+    for ( ; block != series.blocks.cend() && block->first <= to; ++block ) {
+        decode(*block, from, to, visit);
+        decoded++;
+    }
+    if ( series.open.count > 0 && series.open.first <= to && series.open.last >= from ) {
+        decode(series.open, from, to, visit);
+        decoded++;
+    }
+    return decoded;
+}
+
+QVector<Observation> CityHistory::range(const QString& city, qint64 from, qint64 to) const
+{
+    QVector<Observation> observations;
+    scan(city, from, to, [&observations](const Observation& observation) { observations.append(observation); });
+    return observations;
+}
+
+qint64 CityHistory::byteSize() const
+{
+    qint64 bits = 0;
+    for ( const Series& series : mSeries ) {
+        for ( const Block& block : series.blocks ) {
+            bits += block.bitCount;
+        }
+        bits += series.open.bitCount;
+    }
+    return (bits + 7) / 8;
+}
+
+QString CityHistory::defaultPath()
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(directory);
+    return directory + "/history.bin";
+}
+
+void CityHistory::writeBlock(QDataStream& stream, const Block& block)
+{
+    stream << block.first << block.last << qint32(block.count) << qint32(block.bitCount) << qint32(block.words.size());
+    for ( quint64 word : block.words ) {
+        stream << word;
+    }
+}
+
+bool CityHistory::readBlock(QDataStream& stream, Block* block)
+{
+    qint32 count = 0;
+    qint32 bits = 0;
+    qint32 size = 0;
+    stream >> block->first >> block->last >> count >> bits >> size;
+    if ( stream.status() != QDataStream::Ok || count < 0 || count > BLOCK_SIZE || bits < 0 || bits > MAX_BLOCK_BITS
+         || size != (bits + 63) / 64 || block->first > block->last ) {
+        return false;
+    }
+
+    block->count = count;
+    block->bitCount = bits;
+    block->words.resize(size);
+    for ( quint64& word : block->words ) {
+        stream >> word;
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+QString CityHistory::segmentPath(const QString& path)
+{
+    return path + ".blocks";
+}
+
+bool CityHistory::readHead(QDataStream& stream, qint64* segmentSize, QVector<Series>* seriesList, QVector<int>* sealed,
+                           QString* error)
+{
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 seriesCount = 0;
+    stream >> magic >> version >> *segmentSize >> seriesCount;
+    if ( magic != HISTORY_MAGIC || version != HISTORY_VERSION ) {
+        *error = QString("Not a version %1 city history").arg(HISTORY_VERSION);
+        return false;
+    }
+    if ( stream.status() != QDataStream::Ok || *segmentSize < 0 || seriesCount < 0 ) {
+        *error = QString("Corrupt city history");
+        return false;
+    }
+    // nothing is allocated for more series than the rest of the file can hold
+    if ( seriesCount > stream.device()->bytesAvailable() / MIN_SERIES_BYTES ) {
+        *error = QString("Truncated city history");
+        return false;
+    }
+
+    seriesList->resize(seriesCount);
+    sealed->resize(seriesCount);
+    for ( int s = 0; s < seriesCount; s++ ) {
+        Series& series = (*seriesList)[s];
+        qint32 blockCount = 0;
+        stream >> series.city >> blockCount;
+        // a full open block would have been sealed
+        if ( stream.status() != QDataStream::Ok || blockCount < 0 || !readBlock(stream, &series.open)
+             || series.open.count == BLOCK_SIZE ) {
+            *error = QString("Corrupt city history");
+            return false;
+        }
+        (*sealed)[s] = blockCount;
+
+        State& state = series.state;
+        stream >> state.time >> state.delta;
+        for ( int i = 0; i < VALUES; i++ ) {
+            stream >> state.value[i] >> state.leading[i] >> state.meaningful[i];
+        }
+    }
+    if ( stream.status() != QDataStream::Ok ) {
+        *error = QString("Truncated city history");
+        return false;
+    }
+    return true;
+}
+
+bool CityHistory::write(const QString& path, QString* error) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. What the segment holds, from the head of the last write. A history
+    //    that has fewer blocks than that (not the one on disk) starts it anew
+    qint64 segmentSize = 0;
+    QHash<QString, int> saved;  // sealed blocks of each city in the segment
+    QFile head(path);
+    if ( head.open(QIODevice::ReadOnly) ) {
+        QDataStream stream(&head);
+        QVector<Series> seriesList;
+        QVector<int> sealed;
+        QString ignored;
+        if ( readHead(stream, &segmentSize, &seriesList, &sealed, &ignored) ) {
+            for ( int s = 0; s < seriesList.size(); s++ ) {
+                int id = mIds.value(seriesList[s].city, -1);
+                if ( id < 0 || mSeries[id].blocks.size() < sealed[s] ) {
+                    saved.clear();
+                    break;
+                }
+                saved.insert(seriesList[s].city, sealed[s]);
+            }
+        }
+        if ( saved.isEmpty() ) {
+            segmentSize = 0;
+        }
+    }
+
+    // 2. Blocks sealed since then appended to the segment, after cutting off
+    //    what a write that never got to its head left behind
+    QFile segment(segmentPath(path));
+    if ( !segment.open(QIODevice::ReadWrite) ) {
+        *error = segment.errorString();
+        return false;
+    }
+    if ( segment.size() < segmentSize ) {
+        segmentSize = 0;
+        saved.clear();
+    }
+    if ( !segment.resize(segmentSize) || !segment.seek(segmentSize) ) {
+        *error = segment.errorString();
+        return false;
+    }
+    QDataStream blocks(&segment);
+    int appended = 0;
+    for ( const Series& series : mSeries ) {
+        for ( int b = saved.value(series.city, 0); b < series.blocks.size(); b++ ) {
+            blocks << series.city;
+            writeBlock(blocks, series.blocks[b]);
+            appended++;
+        }
+    }
+    if ( blocks.status() != QDataStream::Ok || !segment.flush() ) {
+        *error = segment.errorString();
+        return false;
+    }
+    segmentSize = segment.pos();
+    segment.close();
+
+    // 3. The head, with the open blocks and what the segment now holds. It is
+    //    written to a temporary file and renamed, so a crash leaves the old
+    //    head, which still matches the start of the segment
+    QSaveFile out(path);
+    if ( !out.open(QIODevice::WriteOnly) ) {
+        *error = out.errorString();
+        return false;
+    }
+
+    QDataStream stream(&out);
+    stream << HISTORY_MAGIC << HISTORY_VERSION << segmentSize << qint32(mSeries.size());
+    for ( const Series& series : mSeries ) {
+        stream << series.city << qint32(series.blocks.size());
+        writeBlock(stream, series.open);
+
+        // the open block goes on where it stopped after a read
+        const State& state = series.state;
+        stream << state.time << state.delta;
+        for ( int i = 0; i < VALUES; i++ ) {
+            stream << state.value[i] << state.leading[i] << state.meaningful[i];
+        }
+    }
+    if ( !out.commit() ) {
+        *error = out.errorString();
+        return false;
+    }
+
+    qCDebug(lcWeatherPerf) << "CityHistory:" << mObservations << "readings of" << mSeries.size() << "cities written in"
+                           << timer.elapsed() << "ms," << appended << "blocks appended";
+    return true;
+}
+
+bool CityHistory::read(const QString& path, QString* error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile in(path);
+    if ( !in.open(QIODevice::ReadOnly) ) {
+        *error = in.errorString();
+        return false;
+    }
+
+    // 1. Head, the open blocks
+    QDataStream stream(&in);
+    qint64 segmentSize = 0;
+    QVector<Series> seriesList;
+    QVector<int> sealed;
+    if ( !readHead(stream, &segmentSize, &seriesList, &sealed, error) ) {
+        return false;
+    }
+    QHash<QString, int> ids;
+    for ( const Series& series : seriesList ) {
+        if ( ids.contains(series.city) ) {
+            *error = QString("Corrupt city history");
+            return false;
+        }
+        ids.insert(series.city, ids.size());
+    }
+
+    // 2. Sealed blocks, only as far as the head says the segment goes.
+    //    Only the compressed blocks are read, nothing is decoded
+    QFile segment(segmentPath(path));
+    if ( segmentSize > 0 ) {
+        if ( !segment.open(QIODevice::ReadOnly) ) {
+            *error = segment.errorString();
+            return false;
+        }
+        if ( segment.size() < segmentSize ) {
+            *error = QString("Truncated city history");
+            return false;
+        }
+    }
+    QDataStream blocks(&segment);
+    while ( segment.pos() < segmentSize ) {
+        QString city;
+        Block block;
+        blocks >> city;
+        int id = ids.value(city, -1);
+        if ( blocks.status() != QDataStream::Ok || id < 0 || !readBlock(blocks, &block) || block.count != BLOCK_SIZE ) {
+            *error = QString("Corrupt city history");
+            return false;
+        }
+        Series& series = seriesList[id];
+        if ( series.blocks.size() == sealed[id] || (!series.blocks.isEmpty() && block.first <= series.blocks.last().last) ) {
+            *error = QString("Corrupt city history");
+            return false;
+        }
+        series.blocks.append(block);
+    }
+
+    qint64 observations = 0;
+    for ( int s = 0; s < seriesList.size(); s++ ) {
+        const Series& series = seriesList[s];
+        if ( series.blocks.size() != sealed[s]
+             || (series.open.count > 0 && !series.blocks.isEmpty() && series.open.first <= series.blocks.last().last) ) {
+            *error = QString("Corrupt city history");
+            return false;
+        }
+        observations += qint64(series.blocks.size()) * BLOCK_SIZE + series.open.count;
+    }
+
+    mSeries = seriesList;
+    mIds = ids;
+    mObservations = observations;
+    qCDebug(lcWeatherPerf) << "CityHistory:" << mObservations << "readings of" << mSeries.size() << "cities read in"
+                           << timer.elapsed() << "ms";
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef CITYHISTORY_H
+#define CITYHISTORY_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "CityStore.h"
+
+class QDataStream;
+
+// One reading of a city.
+struct Observation {
+    qint64 time;       // seconds since the epoch
+    qint8 temp;
+    quint8 humidity;
+    quint16 pm25;
+    quint16 aqi;       // today's
+};
+
+// Every reading of every city, kept for years for the trend charts.
+// Append-only, compressed the way Gorilla (Facebook's time series store)
+// does it:
+//
+//   time    delta of delta to the reading before, a single 0 bit while
+//           readings come at a steady pace, else a 2 - 4 bit prefix and
+//           7, 9, 12 or 32 bits
+//   values  XOR with the value before, a single 0 bit when unchanged, else
+//           only the bits between the leading and trailing zeros, in the
+//           window of the XOR before when they fit in it
+//
+// A city's readings are cut into blocks of BLOCK_SIZE. A full block is
+// sealed and never changes again; the first and last time of each block
+// make the block index, so a range scan decodes only the blocks it needs.
+//
+// On disk sealed blocks are appended to a segment file next to the history
+// and never written again. The history file itself is the head: the open
+// block of every city and how far the segment goes, rewritten on each save.
+class CityHistory
+{
+public:
+    static const int BLOCK_SIZE = 256;  // readings
+
+    // today's values of info, false when a newer reading of the city is already in
+    bool record(const WeatherInfo& info, qint64 time);
+    static Observation observe(const WeatherInfo& info, qint64 time);
+    bool append(const QString& city, const Observation& observation);
+    // readings of other appended after the ones here, as append() takes them
+    void merge(const CityHistory& other);
+
+    // readings from <= time <= to in time order, returns the number of blocks decoded
+    int scan(const QString& city, qint64 from, qint64 to, const std::function<void(const Observation&)>& visit) const;
+    QVector<Observation> range(const QString& city, qint64 from, qint64 to) const;
+
+    int cityCount() const { return mSeries.size(); }
+    qint64 observationCount() const { return mObservations; }
+    qint64 byteSize() const;  // compressed readings, without the index
+
+    // appends the blocks sealed since the last write to the segment and
+    // rewrites the head, the first write of a history writes both anew
+    bool write(const QString& path, QString* error) const;
+    bool read(const QString& path, QString* error);
+    // <app data location>/history.bin, the segment is history.bin.blocks
+    static QString defaultPath();
+    static QString segmentPath(const QString& path);
+
+private:
+    static const int VALUES = 4;  // temp, humidity, pm25, aqi
+
+    struct Block {
+        qint64 first = 0;
+        qint64 last = 0;
+        int count = 0;
+        int bitCount = 0;
+        QVector<quint64> words;  // bits from the top of each word down
+    };
+
+    // what the next reading is coded against
+    struct State {
+        qint64 time = 0;
+        qint64 delta = 0;
+        quint16 value[VALUES] = {};
+        quint8 leading[VALUES] = {};     // window of the last XOR that needed one,
+        quint8 meaningful[VALUES] = {};  // 0 meaningful bits while there is none
+    };
+
+    struct Series {
+        QString city;
+        QVector<Block> blocks;  // sealed, oldest first
+        Block open;
+        State state;
+    };
+
+    static void encode(Series* series, const Observation& observation);
+    static void decode(const Block& block, qint64 from, qint64 to, const std::function<void(const Observation&)>& visit);
+    static void writeBlock(QDataStream& stream, const Block& block);
+    static bool readBlock(QDataStream& stream, Block* block);
+    // series with their open blocks, the number of sealed ones in sealed
+    static bool readHead(QDataStream& stream, qint64* segmentSize, QVector<Series>* seriesList, QVector<int>* sealed,
+                         QString* error);
+
+    QVector<Series> mSeries;
+    QHash<QString, int> mIds;
+    qint64 mObservations = 0;
+};
+
+#endif // CITYHISTORY_H
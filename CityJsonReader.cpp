@@ -0,0 +1,260 @@
+#include "CityJsonReader.h"
+#include <QDate>
+
+// first integer in strings like "高温 25℃", "2级", "<3级" or "45%"
+static int leadingNumber(const QString& text)
+{
+    int i = 0;
+    int n = text.size();
+    while ( i < n && !text[i].isDigit() ) {
+        i++;
+    }
+
+    bool negative = i > 0 && text[i - 1] == QLatin1Char('-');
+    int value = 0;
+    while ( i < n && text[i].isDigit() ) {
+        value = value * 10 + text[i].digitValue();
+        i++;
+    }
+    return negative ? -value : value;
+}
+
+CityJsonReader::CityJsonReader(CityStore* store)
+    : CityJsonReader([store](const WeatherInfo& info) { store->upsert(info); })
+{
+}
+
+CityJsonReader::CityJsonReader(Sink sink)
+    : mSink(sink), mStatus(-1), mHasYesterday(false), mCityCount(0), mSkippedCount(0)
+{
+}
+
+bool CityJsonReader::read()
+{
+    forever {
+        switch ( mReader.readNext() ) {
+        case JsonStreamReader::StartObject:
+            startContainer(true);
+            break;
+        case JsonStreamReader::StartArray:
+            startContainer(false);
+            break;
+        case JsonStreamReader::EndObject:
+        case JsonStreamReader::EndArray:
+            endContainer();
+            break;
+        case JsonStreamReader::Name:
+            mKey = mReader.text();
+            break;
+        case JsonStreamReader::String:
+        case JsonStreamReader::Number:
+        case JsonStreamReader::Bool:
+        case JsonStreamReader::Null:
+            scalar();
+            break;
+        case JsonStreamReader::EndDocument:
+            return true;
+        case JsonStreamReader::Invalid:
+            if ( mReader.error() == JsonStreamReader::PrematureEndOfDocumentError ) {
+                return true;  // wait for more data
+            }
+            mErrorString = mReader.errorString();
+            return false;
+        case JsonStreamReader::NoToken:
+            break;
+        }
+    }
+}
+
+void CityJsonReader::startContainer(bool object)
+{
+    Context parent = mContext.isEmpty() ? Root : mContext.last();
+    Context child = Skip;
+
+    switch ( parent ) {
+    case Root:
+        child = object ? City : CityList;
+        break;
+    case CityList:
+        child = object ? City : Skip;
+        break;
+    case City:
+        if ( object && mKey == QLatin1String("cityInfo") ) {
+            child = CityInfo;
+        } else if ( object && mKey == QLatin1String("data") ) {
+            child = Data;
+        }
+        break;
+    case Data:
+        if ( object && mKey == QLatin1String("yesterday") ) {
+            child = Yesterday;
+            mHasYesterday = true;
+        } else if ( !object && mKey == QLatin1String("forecast") ) {
+            child = ForecastList;
+        }
+        break;
+    case ForecastList:
+        if ( object ) {
+            child = ForecastDay;
+            mForecast.append(Day());
+        }
+        break;
+    default:
+        break;
+    }
+
+    if ( child == City ) {
+        mCity = WeatherInfo();
+        mStatus = -1;
+        mMessage.clear();
+        mDate.clear();
+        mYesterday = Day();
+        mHasYesterday = false;
+        mForecast.clear();
+    }
+
+    mContext.append(child);
+    mKey.clear();
+}
+
+void CityJsonReader::endContainer()
+{
+    Context context = mContext.takeLast();
+    if ( context == City ) {
+        cityDone();
+    }
+}
+
+void CityJsonReader::scalar()
+{
+    if ( mContext.isEmpty() ) {
+        return;
+    }
+
+    JsonStreamReader::TokenType type = mReader.tokenType();
+    QString value = type == JsonStreamReader::String ? mReader.text()
+                    : type == JsonStreamReader::Number ? QString::fromLatin1(mReader.numberText())
+                    : QString();
+
+    switch ( mContext.last() ) {
+    case City:
+        if ( mKey == QLatin1String("status") ) {
+            mStatus = value.toInt();
+        } else if ( mKey == QLatin1String("message") ) {
+            mMessage = value;
+        } else if ( mKey == QLatin1String("date") ) {
+            mDate = value;
+        }
+        break;
+    case CityInfo:
+        if ( mKey == QLatin1String("city") ) {
+            mCity.city = value;
+        } else if ( mKey == QLatin1String("lat") || mKey == QLatin1String("latitude") ) {
+            mCity.latitude = value.toFloat();
+        } else if ( mKey == QLatin1String("lon") || mKey == QLatin1String("longitude") ) {
+            mCity.longitude = value.toFloat();
+        }
+        break;
+    case Data:
+        if ( mKey == QLatin1String("wendu") ) {
+            mCity.temp = qint8(leadingNumber(value));
+        } else if ( mKey == QLatin1String("ganmao") ) {
+            mCity.ganMao = value;
+        } else if ( mKey == QLatin1String("pm25") ) {
+            mCity.pm25 = quint16(qMax(0.0, value.toDouble()));
+        } else if ( mKey == QLatin1String("shidu") ) {
+            mCity.humidity = quint8(leadingNumber(value));
+        } else if ( mKey == QLatin1String("quality") ) {
+            mCity.quality = value;
+        }
+        break;
+    case Yesterday:
+        dayValue(&mYesterday, value);
+        break;
+    case ForecastDay:
+        dayValue(&mForecast.last(), value);
+        break;
+    default:
+        break;
+    }
+}
+
+void CityJsonReader::dayValue(Day* day, const QString& value)
+{
+    if ( mKey == QLatin1String("week") ) {
+        day->week = value;
+    } else if ( mKey == QLatin1String("ymd") ) {
+        day->date = QDate::fromString(value, "yyyy-MM-dd").toString("MM/dd");
+    } else if ( mKey == QLatin1String("type") ) {
+        day->type = value;
+    } else if ( mKey == QLatin1String("aqi") ) {
+        day->aqi = quint16(qMax(0, leadingNumber(value)));
+    } else if ( mKey == QLatin1String("high") ) {
+        day->high = qint8(leadingNumber(value));
+    } else if ( mKey == QLatin1String("low") ) {
+        day->low = qint8(leadingNumber(value));
+    } else if ( mKey == QLatin1String("fx") ) {
+        day->fx = value;
+    } else if ( mKey == QLatin1String("fl") ) {
+        day->fl = quint8(leadingNumber(value));
+    }
+}
+
+void CityJsonReader::cityDone()
+{
+    if ( mStatus >= 0 && mStatus != 200 ) {
+        mSkippedCount++;
+        mSkippedMessage = mMessage;
+        return;
+    }
+
+    // 1. Date
+    mCity.dateWeek = QDate::fromString(mDate, "yyyyMMdd").toString("yyyy/MM/dd");
+    if ( !mForecast.isEmpty() ) {
+        mCity.dateWeek += " " + mForecast.first().week;
+    }
+
+    // 2. Days: yesterday, today and the next days
+    QVector<const Day*> days;
+    if ( mHasYesterday ) {
+        days.append(&mYesterday);
+    }
+    for ( const Day& day : mForecast ) {
+        days.append(&day);
+    }
+    for ( const Day* day : days ) {
+        mCity.weekList.append(day->week);
+        mCity.dateList.append(day->date);
+        mCity.typeList.append(day->type);
+        mCity.qualityList.append(day->aqi);
+        mCity.highTemp.append(day->high);
+        mCity.lowTemp.append(day->low);
+        mCity.fx.append(day->fx);
+        mCity.fl.append(day->fl);
+    }
+
+    mCityCount++;
+    mSink(mCity);
+}
+
+bool CityJsonReader::parseCity(const QByteArray& json, WeatherInfo* info, QString* error)
+{
+    bool found = false;
+    CityJsonReader reader([&](const WeatherInfo& city) {
+        *info = city;
+        found = true;
+    });
+    reader.addData(json);
+
+    bool ok = reader.read();
+    if ( error && !found ) {
+        if ( !ok ) {
+            *error = reader.errorString();
+        } else if ( reader.skippedCount() > 0 && !reader.skippedMessage().isEmpty() ) {
+            *error = reader.skippedMessage();
+        } else {
+            *error = QString("No city in response");
+        }
+    }
+    return ok && found;
+}
@@ -0,0 +1,92 @@
+#ifndef CITYJSONREADER_H
+#define CITYJSONREADER_H
+
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "CityStore.h"
+#include "JsonStreamReader.h"
+
+// Reads provider JSON (one sojson city object, or an array of them) straight
+// into a CityStore while streaming. Only the city being parsed is held in
+// memory, so dumps of any size parse in bounded memory, and with addData()
+// the parse can run while the download is still in progress.
+class CityJsonReader
+{
+public:
+    using Sink = std::function<void(const WeatherInfo&)>;
+
+    explicit CityJsonReader(CityStore* store);  // cities are updated or appended
+    explicit CityJsonReader(Sink sink);
+
+    void setDevice(QIODevice* device) { mReader.setDevice(device); }
+    void addData(const QByteArray& data) { mReader.addData(data); }
+
+    // Parses as far as the input goes. false on malformed input, otherwise
+    // either atEnd() or waiting for more data.
+    bool read();
+
+    bool atEnd() const { return mReader.tokenType() == JsonStreamReader::EndDocument; }
+    bool hasError() const { return !mErrorString.isEmpty(); }  // malformed input only
+    QString errorString() const { return mErrorString; }
+
+    int cityCount() const { return mCityCount; }
+    int skippedCount() const { return mSkippedCount; }  // status != 200
+    QString skippedMessage() const { return mSkippedMessage; }  // of the last one skipped
+    qint64 bytesRead() const { return mReader.bytesConsumed(); }
+
+    static bool parseCity(const QByteArray& json, WeatherInfo* info, QString* error = nullptr);
+
+private:
+    enum Context {
+        Root,
+        CityList,
+        City,
+        CityInfo,
+        Data,
+        Yesterday,
+        ForecastList,
+        ForecastDay,
+        Skip
+    };
+
+    struct Day {
+        QString week;
+        QString date;
+        QString type;
+        quint16 aqi = 0;
+        qint8 high = 0;
+        qint8 low = 0;
+        QString fx;
+        quint8 fl = 0;
+    };
+
+    void startContainer(bool object);
+    void endContainer();
+    void scalar();
+    void dayValue(Day* day, const QString& value);
+    void cityDone();
+
+    JsonStreamReader mReader;
+    Sink mSink;
+
+    QVector<Context> mContext;
+    QString mKey;
+
+    // city being parsed
+    WeatherInfo mCity;
+    int mStatus;
+    QString mMessage;
+    QString mDate;
+    Day mYesterday;
+    bool mHasYesterday;
+    QVector<Day> mForecast;
+
+    int mCityCount;
+    int mSkippedCount;
+    QString mSkippedMessage;
+    QString mErrorString;
+};
+
+#endif // CITYJSONREADER_H
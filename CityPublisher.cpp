@@ -0,0 +1,103 @@
+#include "CityPublisher.h"
+#include <atomic>
+
+CityPublisher::CityPublisher() : mCurrent(std::make_shared<CityStore>())
+{
+    mPool.setMaxThreadCount(1);
+}
+
+CityPublisher::~CityPublisher()
+{
+    mPool.waitForDone();
+}
+
+CityStorePtr CityPublisher::current() const
+{
+    return std::atomic_load(&mCurrent);
+}
+
+void CityPublisher::publish(const WeatherInfo& info)
+{
+    QMutexLocker locker(&mWriteLock);
+
+    auto next = std::make_shared<CityStore>(*current());
+    next->upsert(info);
+    swap(next);
+}
+
+void CityPublisher::publish(const QVector<WeatherInfo>& infos)
+{
+    if ( infos.isEmpty() ) {
+        return;
+    }
+
+    QMutexLocker locker(&mWriteLock);
+
+    auto next = std::make_shared<CityStore>(*current());
+    for ( const WeatherInfo& info : infos ) {
+        next->upsert(info);
+    }
+    swap(next);
+}
+
+void CityPublisher::publishLater(const QVector<WeatherInfo>& infos)
+{
+    if ( infos.isEmpty() ) {
+        return;
+    }
+
+    // a worker already building takes these with its next snapshot
+    {
+        QMutexLocker locker(&mPendingLock);
+        mPending += infos;
+        if ( mBuilding ) {
+            return;
+        }
+        mBuilding = true;
+    }
+
+    mPool.start([this]() {
+        for ( ;; ) {
+            QVector<WeatherInfo> batch;
+            {
+                QMutexLocker locker(&mPendingLock);
+                if ( mPending.isEmpty() ) {
+                    mBuilding = false;
+                    return;
+                }
+                batch.swap(mPending);
+            }
+            publish(batch);
+            if ( mPublished ) {
+                mPublished();
+            }
+        }
+    });
+}
+
+void CityPublisher::merge(const CityStorePtr& store)
+{
+    if ( !store || store->isEmpty() ) {
+        return;
+    }
+
+    QMutexLocker locker(&mWriteLock);
+
+    CityStorePtr now = current();
+    if ( now->isEmpty() ) {
+        swap(store);
+        return;
+    }
+
+    auto next = std::make_shared<CityStore>(*now);
+    for ( int i = 0; i < store->size(); i++ ) {
+        next->upsert(store->view(i).info());
+    }
+    swap(next);
+}
+
+void CityPublisher::swap(const CityStorePtr& next)
+{
+    // readers holding the old snapshot keep it alive until they let go
+    std::atomic_store(&mCurrent, next);
+}
@@ -0,0 +1,55 @@
+#ifndef CITYPUBLISHER_H
+#define CITYPUBLISHER_H
+
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+#include <functional>
+
+#include "CityStore.h"
+
+// Publishes immutable CityStore snapshots (read-copy-update).
+// Readers take current() and keep the pointer for as long as they read,
+// the snapshot cannot change under them and nothing is copied. Writers
+// copy the current store, change the copy and swap the pointer. The first
+// write detaches every column, both string pools and the city index, so a
+// publish costs a copy of the whole store. The UI thread therefore uses
+// publishLater(): the copy is made on a worker, batches that arrive while
+// one is built go into the next one, and only the pointer swap is seen by
+// the paint path.
+// Writers serialize on a mutex that readers never touch, so a paint never
+// waits for a fetch or a load.
+class CityPublisher
+{
+public:
+    CityPublisher();
+    ~CityPublisher();
+
+    // safe from any thread
+    CityStorePtr current() const;
+    quint64 generation() const { return current()->generation(); }
+
+    // safe from any thread, each call publishes one new snapshot
+    void publish(const WeatherInfo& info);
+    void publish(const QVector<WeatherInfo>& infos);
+    // safe from any thread, published on a worker, which calls the
+    // setPublished() callback after each new snapshot
+    void publishLater(const QVector<WeatherInfo>& infos);
+    void setPublished(const std::function<void()>& published) { mPublished = published; }
+    // cities of another store, adopted as is when nothing is published yet
+    void merge(const CityStorePtr& store);
+
+private:
+    void swap(const CityStorePtr& next);
+
+    CityStorePtr mCurrent;  // only accessed through std::atomic_load/store
+    QMutex mWriteLock;
+
+    QThreadPool mPool;     // one worker, builds the publishLater() snapshots
+    QMutex mPendingLock;
+    QVector<WeatherInfo> mPending;  // arrived while a snapshot is built
+    bool mBuilding = false;
+    std::function<void()> mPublished;
+};
+
+#endif // CITYPUBLISHER_H
@@ -0,0 +1,220 @@
+#include "CityQuadtree.h"
+#include <QtMath>
+#include <cmath>
+
+static const int BUCKET_SIZE = 32;              // cities per leaf before it splits
+static const float MIN_SIDE = 1.0f / (1 << 20); // about 4 cm at the equator, stops splitting cities on one spot
+
+void MapAggregate::add(const MapAggregate& other)
+{
+    count += other.count;
+    sumX += other.sumX;
+    sumY += other.sumY;
+    sumTemp += other.sumTemp;
+    minTemp = qMin(minTemp, other.minTemp);
+    maxTemp = qMax(maxTemp, other.maxTemp);
+    worstAqi = qMax(worstAqi, other.worstAqi);
+}
+
+CityQuadtree::CityQuadtree()
+{
+    clear();
+}
+
+void CityQuadtree::clear()
+{
+    mNodes.clear();
+    mNodes.append(Node());
+    mX.clear();
+    mY.clear();
+    mTemp.clear();
+    mAqi.clear();
+    mVersion.clear();
+    mLeaf.clear();
+}
+
+QPointF CityQuadtree::project(double latitude, double longitude)
+{
+    // Web Mercator, cut off where the map becomes square
+    double s = std::sin(qDegreesToRadians(qBound(-85.0511, latitude, 85.0511)));
+    double x = (longitude + 180.0) / 360.0;
+    double y = 0.5 - std::log((1 + s) / (1 - s)) / (4 * M_PI);
+    return QPointF(qBound(0.0, x, 1.0), qBound(0.0, y, 1.0));
+}
+
+void CityQuadtree::sync(const CityStore& store)
+{
+    // stores only grow, a smaller one is another store
+    if ( store.size() < mVersion.size() ) {
+        clear();
+    }
+
+    int known = mVersion.size();
+    mX.resize(store.size());
+    mY.resize(store.size());
+    mTemp.resize(store.size());
+    mAqi.resize(store.size());
+    mVersion.resize(store.size());
+    mLeaf.resize(store.size());
+    for ( int i = known; i < store.size(); i++ ) {
+        mLeaf[i] = -1;
+    }
+
+    for ( int i = 0; i < store.size(); i++ ) {
+        CityView city = store.view(i);
+        if ( i < known && mVersion[i] == city.version() ) {
+            continue;
+        }
+        mVersion[i] = city.version();
+
+        // moved or changed, taken out and put back in
+        remove(quint32(i));
+        if ( !city.hasLocation() ) {
+            continue;
+        }
+        QPointF position = project(city.latitude(), city.longitude());
+        mX[i] = float(position.x());
+        mY[i] = float(position.y());
+        mTemp[i] = city.temp();
+        mAqi[i] = city.dayCount() > 0 ? city.aqi(qMin(1, city.dayCount() - 1)) : 0;  // today
+        place(quint32(i));
+    }
+}
+
+QVector<MapCluster> CityQuadtree::clusters(const QRectF& viewport, double cell) const
+{
+    QVector<MapCluster> clusters;
+    collect(0, viewport, cell, &clusters);
+    return clusters;
+}
+
+void CityQuadtree::place(quint32 city)
+{
+    int leaf = leafAt(mX[city], mY[city]);
+    mNodes[leaf].cities.append(city);
+    mLeaf[city] = leaf;
+
+    if ( mNodes[leaf].cities.size() > BUCKET_SIZE && mNodes[leaf].side > MIN_SIDE ) {
+        split(leaf);
+    }
+    refresh(leaf);
+}
+
+void CityQuadtree::remove(quint32 city)
+{
+    int leaf = mLeaf[city];
+    if ( leaf < 0 ) {
+        return;
+    }
+
+    mNodes[leaf].cities.removeOne(city);
+    mLeaf[city] = -1;
+    refresh(leaf);
+}
+
+int CityQuadtree::leafAt(float x, float y) const
+{
+    int node = 0;
+    while ( mNodes[node].child >= 0 ) {
+        const Node& n = mNodes[node];
+        float half = n.side / 2;
+        node = n.child + (x >= n.x + half ? 1 : 0) + (y >= n.y + half ? 2 : 0);
+    }
+    return node;
+}
+
+void CityQuadtree::split(int node)
+{
+    // 1. Four quarters, appended (mNodes may move, no references kept)
+    int first = mNodes.size();
+    float half = mNodes[node].side / 2;
+    for ( int q = 0; q < 4; q++ ) {
+        Node child;
+        child.x = mNodes[node].x + (q & 1 ? half : 0);
+        child.y = mNodes[node].y + (q & 2 ? half : 0);
+        child.side = half;
+        child.parent = node;
+        mNodes.append(child);
+    }
+    mNodes[node].child = first;
+
+    // 2. Cities moved down, quarters that are still too full split again
+    QVector<quint32> cities;
+    cities.swap(mNodes[node].cities);
+    for ( quint32 city : cities ) {
+        int child = first + (mX[city] >= mNodes[node].x + half ? 1 : 0) + (mY[city] >= mNodes[node].y + half ? 2 : 0);
+        mNodes[child].cities.append(city);
+        mLeaf[city] = child;
+    }
+    for ( int child = first; child < first + 4; child++ ) {
+        if ( mNodes[child].cities.size() > BUCKET_SIZE && half > MIN_SIDE ) {
+            split(child);
+        }
+        refresh(child);
+    }
+}
+
+void CityQuadtree::refresh(int node)
+{
+    // the node from its cities or quarters, then every node above it
+    for ( ; node >= 0; node = mNodes[node].parent ) {
+        Node& n = mNodes[node];
+        MapAggregate total;
+        if ( n.child < 0 ) {
+            for ( quint32 city : n.cities ) {
+                total.add(aggregate(city));
+            }
+        } else {
+            for ( int q = 0; q < 4; q++ ) {
+                total.add(mNodes[n.child + q].total);
+            }
+        }
+        n.total = total;
+    }
+}
+
+void CityQuadtree::collect(int node, const QRectF& viewport, double cell, QVector<MapCluster>* clusters) const
+{
+    const Node& n = mNodes[node];
+    if ( n.total.count == 0 || !viewport.intersects(QRectF(n.x, n.y, n.side, n.side)) ) {
+        return;
+    }
+
+    // 1. Cell about one marker in size, drawn as one
+    if ( n.side <= cell ) {
+        MapCluster cluster;
+        cluster.total = n.total;
+        if ( n.child < 0 && n.cities.size() == 1 ) {
+            cluster.city = int(n.cities.first());
+        }
+        clusters->append(cluster);
+        return;
+    }
+
+    // 2. Larger leaf, its few cities one by one
+    if ( n.child < 0 ) {
+        for ( quint32 city : n.cities ) {
+            if ( viewport.contains(mX[city], mY[city]) ) {
+                clusters->append(MapCluster{aggregate(city), int(city)});
+            }
+        }
+        return;
+    }
+
+    for ( int q = 0; q < 4; q++ ) {
+        collect(n.child + q, viewport, cell, clusters);
+    }
+}
+
+MapAggregate CityQuadtree::aggregate(quint32 city) const
+{
+    MapAggregate single;
+    single.count = 1;
+    single.sumX = mX[city];
+    single.sumY = mY[city];
+    single.sumTemp = mTemp[city];
+    single.minTemp = mTemp[city];
+    single.maxTemp = mTemp[city];
+    single.worstAqi = mAqi[city];
+    return single;
+}
@@ -0,0 +1,86 @@
+#ifndef CITYQUADTREE_H
+#define CITYQUADTREE_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+#include "CityStore.h"
+
+// What a map marker stands for: one city or every city of a quadtree cell.
+struct MapAggregate {
+    int count = 0;
+    double sumX = 0;     // for the mean position
+    double sumY = 0;
+    qint64 sumTemp = 0;
+    qint8 minTemp = 127;
+    qint8 maxTemp = -128;
+    quint16 worstAqi = 0;
+
+    void add(const MapAggregate& other);
+    QPointF position() const { return count ? QPointF(sumX / count, sumY / count) : QPointF(); }
+    double meanTemp() const { return count ? double(sumTemp) / count : 0; }
+};
+
+struct MapCluster {
+    MapAggregate total;
+    int city = -1;  // store index when the cluster is a single known city
+};
+
+// Quadtree over the cities' map positions (Web Mercator, both axes 0 - 1),
+// with the count, temperature range and mean and worst AQI of every cell
+// kept up to date as cities change. Leaves hold up to a bucket of cities
+// and split when they overflow. A changed city only rewrites its leaf and
+// the aggregates on the way up to the root, so a refresh of a few cities
+// costs a few dozen node updates however many cities there are.
+// clusters() answers with the cells that are about one marker in size at
+// the current zoom, so a frame draws a few hundred markers, not every city.
+class CityQuadtree
+{
+public:
+    CityQuadtree();
+
+    // cities whose version moved since the last sync, new cities are added
+    void sync(const CityStore& store);
+    void clear();
+
+    // cities with a position
+    int size() const { return mNodes.first().total.count; }
+    const MapAggregate& total() const { return mNodes.first().total; }
+
+    // aggregates inside viewport (map units), cells smaller than cell merged into one
+    QVector<MapCluster> clusters(const QRectF& viewport, double cell) const;
+
+    static QPointF project(double latitude, double longitude);
+
+private:
+    struct Node {
+        float x = 0;      // left, top and side, map units
+        float y = 0;
+        float side = 1;
+        int parent = -1;
+        int child = -1;   // first of four, -1 for a leaf
+        QVector<quint32> cities;  // leaves only
+        MapAggregate total;
+    };
+
+    void place(quint32 city);
+    void remove(quint32 city);
+    int leafAt(float x, float y) const;
+    void split(int node);
+    void refresh(int node);
+    void collect(int node, const QRectF& viewport, double cell, QVector<MapCluster>* clusters) const;
+    MapAggregate aggregate(quint32 city) const;
+
+    QVector<Node> mNodes;  // mNodes[0] is the root
+
+    // per city, indexed like the store
+    QVector<float> mX;
+    QVector<float> mY;
+    QVector<qint8> mTemp;
+    QVector<quint16> mAqi;
+    QVector<quint32> mVersion;
+    QVector<int> mLeaf;  // -1 while the city has no position
+};
+
+#endif // CITYQUADTREE_H
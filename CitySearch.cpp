@@ -0,0 +1,197 @@
+#include "CitySearch.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <algorithm>
+
+#include "WeatherLog.h"
+
+static const int LATENCY_SAMPLES = 256;
+
+static qint64 percentile(QVector<qint64> samples, double p)
+{
+    if ( samples.isEmpty() ) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[qMin(samples.size() - 1, int(samples.size() * p))];
+}
+
+CitySearch::CitySearch(QObject* parent) : QObject(parent), mLimit(12)
+{
+    mPool.setMaxThreadCount(1);
+    mClock.start();
+
+    mTimer.setSingleShot(true);
+    mTimer.setInterval(30);
+    connect(&mTimer, &QTimer::timeout, this, [this]() {
+        // text typed during the quiet period, searched now
+        if ( mPending ) {
+            run();
+            mTimer.start();
+        }
+    });
+}
+
+CitySearch::~CitySearch()
+{
+    mPool.waitForDone();
+}
+
+void CitySearch::load(const QString& path)
+{
+    mPool.start([this, path]() {
+        QString error;
+        QString index = path;
+
+        // 1. Text lists are indexed once into the cache, again when they or the format change.
+        //    Every list has its own index, named after its canonical path
+        if ( !Gazetteer::isIndex(path) ) {
+            QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+            QDir().mkpath(directory);
+            QByteArray source = QFileInfo(path).canonicalFilePath().toUtf8();
+            QByteArray key = QCryptographicHash::hash(source, QCryptographicHash::Sha1).toHex().left(16);
+            index = directory + "/gazetteer-" + QString::fromLatin1(key) + ".idx";
+
+            QFileInfo built(index);
+            quint32 version = 0;
+            if ( !Gazetteer::isIndex(index, &version) || version != Gazetteer::VERSION
+                 || built.lastModified() < QFileInfo(path).lastModified() ) {
+                if ( !Gazetteer::build(path, index, &error) ) {
+                    index.clear();
+                }
+            }
+        }
+
+        // 2. Map
+        QElapsedTimer timer;
+        timer.start();
+        auto gazetteer = std::make_shared<Gazetteer>();
+        if ( !index.isEmpty() && !gazetteer->open(index, &error) ) {
+            gazetteer.reset();
+        }
+        if ( gazetteer ) {
+            qCDebug(lcWeatherPerf) << "CitySearch:" << gazetteer->entryCount() << "cities mapped in" << timer.nsecsElapsed() / 1000 << "us";
+        }
+
+        QMetaObject::invokeMethod(this, [this, gazetteer, error]() {
+            if ( !gazetteer ) {
+                emit failed(error);
+                return;
+            }
+            mGazetteer = gazetteer;
+            emit ready(gazetteer->entryCount());
+            if ( mPending ) {
+                run();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void CitySearch::setQuery(const QString& text)
+{
+    mQuery = text;
+    mQueryNs = mClock.nsecsElapsed();
+    mPending = true;
+
+    // first keystroke after a quiet period, answered right away
+    if ( !mTimer.isActive() ) {
+        run();
+        mTimer.start();
+    }
+}
+
+GazetteerMatch CitySearch::find(const QString& text) const
+{
+    int entry = mGazetteer ? mGazetteer->find(text) : -1;
+    if ( entry < 0 ) {
+        return GazetteerMatch();
+    }
+    return GazetteerMatch{entry, mGazetteer->name(entry), mGazetteer->code(entry)};
+}
+
+void CitySearch::run()
+{
+    // still mapping, searched once the index is ready
+    if ( !mGazetteer ) {
+        return;
+    }
+    mPending = false;
+    if ( mQuery == mShown ) {
+        return;
+    }
+    mShown = mQuery;
+
+    emit resultsReady(mQuery, mGazetteer->search(mQuery, mLimit));
+
+    // keystroke -> results, including the time spent waiting for the quiet period
+    qint64 latency = mClock.nsecsElapsed() - mQueryNs;
+    if ( mLatencyNs.size() < LATENCY_SAMPLES ) {
+        mLatencyNs.append(latency);
+    } else {
+        mLatencyNs[mQueries % LATENCY_SAMPLES] = latency;
+    }
+    if ( ++mQueries % 32 == 0 ) {
+        qCDebug(lcWeatherPerf) << "CitySearch: keystroke to results p50" << percentile(mLatencyNs, 0.5) / 1000 << "us, p99"
+                               << percentile(mLatencyNs, 0.99) / 1000 << "us over the last" << mLatencyNs.size() << "queries";
+    }
+}
+
+void CitySearch::benchmark(int count) const
+{
+    if ( !mGazetteer || mGazetteer->entryCount() == 0 ) {
+        return;
+    }
+
+    // prefixes of real names, seeded so runs compare. Every second one
+    // gets a typo (two neighbours swapped or a letter replaced). Entries
+    // without a name are skipped, so there may be fewer than count
+    QRandomGenerator random(165);
+    QVector<QString> prefixes;
+    QVector<QString> typos;
+    prefixes.reserve(count);
+    typos.reserve(count);
+    for ( int i = 0; i < count; i++ ) {
+        QString name = mGazetteer->name(int(random.bounded(mGazetteer->entryCount())));
+        if ( name.isEmpty() ) {
+            continue;
+        }
+        prefixes.append(name.left(1 + int(random.bounded(4))));
+
+        QString typo = name.left(4 + int(random.bounded(6)));
+        int at = int(random.bounded(qMax(typo.size() - 1, 1)));
+        if ( i % 2 == 0 && typo.size() > 1 ) {
+            QChar c = typo[at];
+            typo[at] = typo[at + 1];
+            typo[at + 1] = c;
+        } else {
+            typo[at] = QLatin1Char(char('a' + random.bounded(26)));
+        }
+        typos.append(typo);
+    }
+
+    auto time = [this](const QVector<QString>& texts, const char* kind) {
+        int count = texts.size();
+        QVector<qint64> samples;
+        samples.reserve(count);
+        qint64 results = 0;
+        QElapsedTimer total;
+        total.start();
+        for ( const QString& text : texts ) {
+            QElapsedTimer timer;
+            timer.start();
+            results += mGazetteer->search(text, mLimit).size();
+            samples.append(timer.nsecsElapsed());
+        }
+        qint64 ms = qMax(total.elapsed(), qint64(1));
+
+        qCDebug(lcWeatherPerf) << "CitySearch benchmark:" << count << kind << "lookups over" << mGazetteer->entryCount() << "cities,"
+                               << results / qMax(count, 1) << "results each, p50" << percentile(samples, 0.5) / 1000.0
+                               << "us, p99" << percentile(samples, 0.99) / 1000.0 << "us, max" << percentile(samples, 1.0) / 1000.0
+                               << "us," << count * 1000.0 / ms << "lookups/s";
+    };
+    time(prefixes, "prefix");
+    time(typos, "misspelled");
+}
@@ -0,0 +1,71 @@
+#ifndef CITYSEARCH_H
+#define CITYSEARCH_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include <memory>
+
+#include "Gazetteer.h"
+
+// Search-as-you-type over the gazetteer, behind the city search box.
+// Prefix matches come first, misspelled text still finds the closest cities.
+// The index is built (only when the text list changed) and mapped on a
+// worker, queries run on the calling thread since they take microseconds.
+// Keystrokes are coalesced: the first one after a quiet period is answered
+// at once, keystrokes that follow within debounce() ms only leave their
+// text behind and the newest text is searched when the period ends, so the
+// queries in between never run.
+class CitySearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CitySearch(QObject* parent = nullptr);
+    ~CitySearch();
+
+    // text list ("code<TAB>name<TAB>aliases") or an index built from one
+    void load(const QString& path);
+    bool isReady() const { return mGazetteer != nullptr; }
+    std::shared_ptr<const Gazetteer> gazetteer() const { return mGazetteer; }
+
+    void setDebounce(int ms) { mTimer.setInterval(ms); }
+    int debounce() const { return mTimer.interval(); }
+    void setLimit(int count) { mLimit = count; }
+    int limit() const { return mLimit; }
+
+    // the search box text changed
+    void setQuery(const QString& text);
+    // city with this name or alias, entry -1 if there is none
+    GazetteerMatch find(const QString& text) const;
+
+    // times count prefix lookups (1 - 4 characters) and count misspelled
+    // ones (4 - 9 characters, one typo), logs the percentiles
+    void benchmark(int count) const;
+
+signals:
+    void ready(int cities);
+    void failed(const QString& error);
+    void resultsReady(const QString& query, const QVector<GazetteerMatch>& matches);
+
+private:
+    void run();
+
+    QThreadPool mPool;
+    std::shared_ptr<const Gazetteer> mGazetteer;
+
+    QTimer mTimer;         // quiet period after a query
+    QElapsedTimer mClock;
+    QString mQuery;        // newest text
+    qint64 mQueryNs = 0;   // when it was typed, mClock time
+    bool mPending = false; // mQuery has not been searched yet
+    QString mShown;        // text of the last results
+    int mLimit;
+
+    QVector<qint64> mLatencyNs;  // keystroke -> results, last LATENCY_SAMPLES queries
+    int mQueries = 0;
+};
+
+#endif // CITYSEARCH_H
@@ -0,0 +1,276 @@
+#include "CitySnapshot.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "WeatherLog.h"
+
+static const char SNAPSHOT_MAGIC[4] = {'W', 'C', 'S', '1'};
+static const quint32 SNAPSHOT_VERSION = 3;
+static const int HEADER_SIZE = 40;
+static const int SECTION_SIZE = 16;  // offset, bytes
+
+enum Section {
+    // city columns
+    Code, CityName, DateWeek, Temp, GanMao, Pm25, Humidity, Quality, Latitude, Longitude, DayOffset, DayCount, DayCapacity, Version,
+    // day columns
+    Week, Date, Type, Aqi, High, Low, Fx, Fl,
+    // string pools
+    TextOffsets, TextUnits, DayTextOffsets, DayTextUnits,
+    SectionCount
+};
+
+// little-endian bytes of a column, whatever its element type
+template <typename T>
+static QByteArray encode(const QVector<T>& column)
+{
+    using Raw = typename QIntegerForSize<sizeof(T)>::Unsigned;
+    QByteArray bytes(column.size() * int(sizeof(T)), Qt::Uninitialized);
+    qToLittleEndian<Raw>(column.constData(), column.size(), bytes.data());
+    return bytes;
+}
+
+template <typename T>
+static void decode(const uchar* data, qint64 count, QVector<T>* column)
+{
+    using Raw = typename QIntegerForSize<sizeof(T)>::Unsigned;
+    column->resize(int(count));
+    qFromLittleEndian<Raw>(data, count, column->data());
+}
+
+template <typename T>
+static bool below(const QVector<T>& ids, int size)
+{
+    return std::all_of(ids.cbegin(), ids.cend(), [size](T id) { return qint64(id) < size; });
+}
+
+static void encodePool(const StringPool& pool, QByteArray* offsets, QByteArray* units)
+{
+    QVector<quint32> starts;
+    QVector<quint16> text;
+    starts.reserve(pool.size() + 1);
+    for ( int i = 0; i < pool.size(); i++ ) {
+        const QString& str = pool.at(i);
+        int at = text.size();
+        starts.append(quint32(at));
+        text.resize(at + str.size());
+        std::memcpy(text.data() + at, str.utf16(), size_t(str.size()) * 2);
+    }
+    starts.append(quint32(text.size()));
+
+    *offsets = encode(starts);
+    *units = encode(text);
+}
+
+static bool decodePool(const uchar* offsets, const uchar* units, int count, qint64 unitCount, StringPool* pool)
+{
+    QVector<quint32> starts;
+    QVector<quint16> text;
+    decode(offsets, count + 1, &starts);
+    decode(units, unitCount, &text);
+    if ( starts.first() != 0 || starts.last() != unitCount ) {
+        return false;
+    }
+
+    pool->reserve(count);
+    for ( int i = 0; i < count; i++ ) {
+        if ( starts[i + 1] < starts[i] ) {
+            return false;
+        }
+        // ids are positions, a repeated string would shift every id after it
+        QString str(reinterpret_cast<const QChar*>(text.constData() + starts[i]), int(starts[i + 1] - starts[i]));
+        if ( pool->intern(str) != quint32(i) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString CitySnapshot::defaultPath()
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(directory);
+    return directory + "/cities.snapshot";
+}
+
+bool CitySnapshot::write(const CityStore& store, const QString& path, QString* error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Sections
+    QVector<QByteArray> sections(SectionCount);
+    sections[Code] = encode(store.mCode);
+    sections[CityName] = encode(store.mCityName);
+    sections[DateWeek] = encode(store.mDateWeek);
+    sections[Temp] = encode(store.mTemp);
+    sections[GanMao] = encode(store.mGanMao);
+    sections[Pm25] = encode(store.mPm25);
+    sections[Humidity] = encode(store.mHumidity);
+    sections[Quality] = encode(store.mQuality);
+    sections[Latitude] = encode(store.mLatitude);
+    sections[Longitude] = encode(store.mLongitude);
+    sections[DayOffset] = encode(store.mDayOffset);
+    sections[DayCount] = encode(store.mDayCount);
+    sections[DayCapacity] = encode(store.mDayCapacity);
+    sections[Version] = encode(store.mVersion);
+    sections[Week] = encode(store.mWeek);
+    sections[Date] = encode(store.mDate);
+    sections[Type] = encode(store.mType);
+    sections[Aqi] = encode(store.mAqi);
+    sections[High] = encode(store.mHigh);
+    sections[Low] = encode(store.mLow);
+    sections[Fx] = encode(store.mFx);
+    sections[Fl] = encode(store.mFl);
+    encodePool(store.mTextPool, &sections[TextOffsets], &sections[TextUnits]);
+    encodePool(store.mDayPool, &sections[DayTextOffsets], &sections[DayTextUnits]);
+
+    // 2. Header and section table
+    uchar header[HEADER_SIZE + SectionCount * SECTION_SIZE] = {};
+    std::memcpy(header, SNAPSHOT_MAGIC, 4);
+    qToLittleEndian<quint32>(SNAPSHOT_VERSION, header + 4);
+    qToLittleEndian<quint64>(store.mGeneration, header + 8);
+    qToLittleEndian<quint32>(quint32(store.size()), header + 16);
+    qToLittleEndian<quint32>(quint32(store.mHigh.size()), header + 20);
+    qToLittleEndian<quint32>(quint32(store.mTextPool.size()), header + 24);
+    qToLittleEndian<quint32>(quint32(store.mDayPool.size()), header + 28);
+    qToLittleEndian<quint32>(quint32(SectionCount), header + 32);
+
+    quint64 offset = sizeof(header);
+    for ( int s = 0; s < SectionCount; s++ ) {
+        qToLittleEndian<quint64>(offset, header + HEADER_SIZE + s * SECTION_SIZE);
+        qToLittleEndian<quint64>(quint64(sections[s].size()), header + HEADER_SIZE + s * SECTION_SIZE + 8);
+        offset += (sections[s].size() + 7) & ~7;  // every section starts 8 byte aligned
+    }
+
+    // 3. File, written next to the old one and renamed over it
+    QSaveFile out(path);
+    if ( !out.open(QIODevice::WriteOnly) ) {
+        *error = out.errorString();
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for ( const QByteArray& section : sections ) {
+        out.write(section);
+        out.write(QByteArray((8 - section.size() % 8) % 8, '\0'));
+    }
+    if ( !out.commit() ) {
+        *error = out.errorString();
+        return false;
+    }
+
+    qCDebug(lcWeatherPerf) << "CitySnapshot:" << store.size() << "cities," << offset << "bytes written in" << timer.elapsed() << "ms";
+    return true;
+}
+
+CityStorePtr CitySnapshot::read(const QString& path, QString* error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(path);
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        *error = file.errorString();
+        return nullptr;
+    }
+
+    qint64 size = file.size();
+    const uchar* data = size >= HEADER_SIZE + SectionCount * SECTION_SIZE ? file.map(0, size) : nullptr;
+    if ( !data || std::memcmp(data, SNAPSHOT_MAGIC, 4) != 0 || qFromLittleEndian<quint32>(data + 4) != SNAPSHOT_VERSION
+         || qFromLittleEndian<quint32>(data + 32) != quint32(SectionCount) ) {
+        *error = QString("Not a version %1 city snapshot").arg(SNAPSHOT_VERSION);
+        return nullptr;
+    }
+
+    // 1. Every section inside the file and exactly as large as the counts say
+    quint64 generation = qFromLittleEndian<quint64>(data + 8);
+    qint64 cities = qFromLittleEndian<quint32>(data + 16);
+    qint64 days = qFromLittleEndian<quint32>(data + 20);
+    quint32 textCount = qFromLittleEndian<quint32>(data + 24);
+    quint32 dayTextCount = qFromLittleEndian<quint32>(data + 28);
+    if ( textCount > quint32(INT_MAX - 1) || dayTextCount > quint32(INT_MAX - 1) ) {
+        *error = QString("Corrupt city snapshot");
+        return nullptr;
+    }
+    int texts = int(textCount);
+    int dayTexts = int(dayTextCount);
+
+    const qint64 expected[SectionCount] = {
+        cities * 4, cities * 4, cities * 4, cities, cities * 4, cities * 2, cities, cities * 4, cities * 4, cities * 4, cities * 4, cities, cities,
+        cities * 4,
+        days * 4, days * 4, days, days * 2, days, days, days * 4, days,
+        (texts + 1) * qint64(4), -1, (dayTexts + 1) * qint64(4), -1
+    };
+    const uchar* section[SectionCount];
+    qint64 bytes[SectionCount];
+    for ( int s = 0; s < SectionCount; s++ ) {
+        quint64 offset = qFromLittleEndian<quint64>(data + HEADER_SIZE + s * SECTION_SIZE);
+        bytes[s] = qint64(qFromLittleEndian<quint64>(data + HEADER_SIZE + s * SECTION_SIZE + 8));
+        bool sized = expected[s] >= 0 ? bytes[s] == expected[s] : bytes[s] >= 0 && bytes[s] % 2 == 0;
+        if ( !sized || offset > quint64(size) || quint64(bytes[s]) > quint64(size) - offset ) {
+            *error = QString("Truncated city snapshot");
+            return nullptr;
+        }
+        section[s] = data + offset;
+    }
+
+    // 2. Columns, copied out of the mapping as they are. The pools are read
+    //    into empty ones, the text pool written holds the empty code as id 0
+    auto store = std::make_shared<CityStore>();
+    store->mTextPool = StringPool();
+    decode(section[Code], cities, &store->mCode);
+    decode(section[CityName], cities, &store->mCityName);
+    decode(section[DateWeek], cities, &store->mDateWeek);
+    decode(section[Temp], cities, &store->mTemp);
+    decode(section[GanMao], cities, &store->mGanMao);
+    decode(section[Pm25], cities, &store->mPm25);
+    decode(section[Humidity], cities, &store->mHumidity);
+    decode(section[Quality], cities, &store->mQuality);
+    decode(section[Latitude], cities, &store->mLatitude);
+    decode(section[Longitude], cities, &store->mLongitude);
+    decode(section[DayOffset], cities, &store->mDayOffset);
+    decode(section[DayCount], cities, &store->mDayCount);
+    decode(section[DayCapacity], cities, &store->mDayCapacity);
+    decode(section[Version], cities, &store->mVersion);
+    decode(section[Week], days, &store->mWeek);
+    decode(section[Date], days, &store->mDate);
+    decode(section[Type], days, &store->mType);
+    decode(section[Aqi], days, &store->mAqi);
+    decode(section[High], days, &store->mHigh);
+    decode(section[Low], days, &store->mLow);
+    decode(section[Fx], days, &store->mFx);
+    decode(section[Fl], days, &store->mFl);
+
+    // 3. String pools, then every id and day range must point inside its table
+    bool valid = decodePool(section[TextOffsets], section[TextUnits], texts, bytes[TextUnits] / 2, &store->mTextPool)
+                 && decodePool(section[DayTextOffsets], section[DayTextUnits], dayTexts, bytes[DayTextUnits] / 2, &store->mDayPool)
+                 && texts > 0 && store->mTextPool.at(0).isEmpty()
+                 && below(store->mCode, texts) && below(store->mCityName, texts) && below(store->mDateWeek, texts)
+                 && below(store->mGanMao, texts) && below(store->mQuality, texts)
+                 && below(store->mWeek, dayTexts) && below(store->mDate, dayTexts) && below(store->mFx, dayTexts)
+                 && std::all_of(store->mType.cbegin(), store->mType.cend(), [](WeatherType t) { return t < WeatherType::Count; });
+    for ( int i = 0; i < cities && valid; i++ ) {
+        valid = store->mDayCount[i] <= store->mDayCapacity[i] && qint64(store->mDayOffset[i]) + store->mDayCapacity[i] <= days;
+    }
+    file.unmap(const_cast<uchar*>(data));
+    if ( !valid ) {
+        *error = QString("Corrupt city snapshot");
+        return nullptr;
+    }
+
+    store->mCityIndex.reserve(int(cities));
+    for ( int i = 0; i < cities; i++ ) {
+        store->addToIndex(quint32(i));
+    }
+    store->mGeneration = generation;
+
+    qCDebug(lcWeatherPerf) << "CitySnapshot:" << cities << "cities," << size << "bytes mapped and restored in"
+                           << timer.nsecsElapsed() / 1000 << "us";
+    return store;
+}
@@ -0,0 +1,32 @@
+#ifndef CITYSNAPSHOT_H
+#define CITYSNAPSHOT_H
+
+#include <QString>
+
+#include "CityStore.h"
+
+// The whole CityStore as one binary file, the last known good data a
+// launch can show before the first fetch or load is done:
+//
+//   header    "WCS1", version, generation, city / day slot / string counts
+//   sections  offset, byte size for every section   (u64 each)
+//   columns   every CityStore column as a plain array, 8 byte aligned
+//   strings   both string pools, u32 offsets + UTF-16 code units
+//
+// Everything is little-endian. read() maps the file, checks that every
+// section has exactly the size the counts call for and that every id and
+// day offset points inside its table, then copies the columns out of the
+// mapping as they are (one memcpy each on little-endian hosts). Nothing is
+// parsed, only the string pools are rebuilt. write() goes through a
+// QSaveFile, so a crash never leaves half a snapshot behind.
+class CitySnapshot
+{
+public:
+    static bool write(const CityStore& store, const QString& path, QString* error);
+    static CityStorePtr read(const QString& path, QString* error);
+
+    // <app data location>/cities.snapshot
+    static QString defaultPath();
+};
+
+#endif // CITYSNAPSHOT_H
@@ -0,0 +1,301 @@
+#include "CityStore.h"
+#include <algorithm>
+
+quint32 StringPool::intern(const QString& str)
+{
+    auto it = mIds.constFind(str);
+    if ( it != mIds.constEnd() ) {
+        return it.value();
+    }
+
+    quint32 id = mStrings.size();
+    mStrings.append(str);
+    mIds.insert(str, id);
+    return id;
+}
+
+void StringPool::reserve(int count)
+{
+    mStrings.reserve(count);
+    mIds.reserve(count);
+}
+
+bool StringPool::find(const QString& str, quint32* id) const
+{
+    auto it = mIds.constFind(str);
+    if ( it == mIds.constEnd() ) {
+        return false;
+    }
+
+    *id = it.value();
+    return true;
+}
+
+CityView::CityView(const CityStore* store, CityHandle handle) : mStore(store), mHandle(handle)
+{
+    Q_ASSERT(store && handle.isValid() && handle.index < quint32(store->size()));
+}
+
+const QString& CityView::code() const { return mStore->mTextPool.at(mStore->mCode[mHandle.index]); }
+const QString& CityView::city() const { return mStore->mTextPool.at(mStore->mCityName[mHandle.index]); }
+const QString& CityView::dateWeek() const { return mStore->mTextPool.at(mStore->mDateWeek[mHandle.index]); }
+qint8 CityView::temp() const { return mStore->mTemp[mHandle.index]; }
+const QString& CityView::ganMao() const { return mStore->mTextPool.at(mStore->mGanMao[mHandle.index]); }
+quint16 CityView::pm25() const { return mStore->mPm25[mHandle.index]; }
+quint32 CityView::version() const { return mStore->mVersion[mHandle.index]; }
+quint8 CityView::humidity() const { return mStore->mHumidity[mHandle.index]; }
+const QString& CityView::quality() const { return mStore->mTextPool.at(mStore->mQuality[mHandle.index]); }
+bool CityView::hasLocation() const { return !qIsNaN(latitude()) && !qIsNaN(longitude()); }
+float CityView::latitude() const { return mStore->mLatitude[mHandle.index]; }
+float CityView::longitude() const { return mStore->mLongitude[mHandle.index]; }
+
+int CityView::dayCount() const { return mStore->mDayCount[mHandle.index]; }
+const QString& CityView::week(int day) const { return mStore->mDayPool.at(mStore->mWeek[dayIndex(day)]); }
+const QString& CityView::date(int day) const { return mStore->mDayPool.at(mStore->mDate[dayIndex(day)]); }
+WeatherType CityView::type(int day) const { return mStore->mType[dayIndex(day)]; }
+QLatin1String CityView::typeLabel(int day) const { return weatherTypeLabel(type(day)); }
+quint16 CityView::aqi(int day) const { return mStore->mAqi[dayIndex(day)]; }
+qint8 CityView::highTemp(int day) const { return mStore->mHigh[dayIndex(day)]; }
+qint8 CityView::lowTemp(int day) const { return mStore->mLow[dayIndex(day)]; }
+const QString& CityView::fx(int day) const { return mStore->mDayPool.at(mStore->mFx[dayIndex(day)]); }
+quint8 CityView::fl(int day) const { return mStore->mFl[dayIndex(day)]; }
+
+const qint8* CityView::highTemps() const { return mStore->mHigh.constData() + mStore->mDayOffset[mHandle.index]; }
+const qint8* CityView::lowTemps() const { return mStore->mLow.constData() + mStore->mDayOffset[mHandle.index]; }
+
+WeatherInfo CityView::info() const
+{
+    WeatherInfo info;
+    info.code = code();
+    info.city = city();
+    info.dateWeek = dateWeek();
+    info.temp = temp();
+    info.ganMao = ganMao();
+    info.pm25 = pm25();
+    info.humidity = humidity();
+    info.quality = quality();
+    info.latitude = latitude();
+    info.longitude = longitude();
+
+    for ( int i = 0; i < dayCount(); i++ ) {
+        info.weekList.append(week(i));
+        info.dateList.append(date(i));
+        info.typeList.append(typeLabel(i));
+        info.qualityList.append(aqi(i));
+        info.highTemp.append(highTemp(i));
+        info.lowTemp.append(lowTemp(i));
+        info.fx.append(fx(i));
+        info.fl.append(fl(i));
+    }
+    return info;
+}
+
+int CityView::dayIndex(int day) const
+{
+    Q_ASSERT(day >= 0 && day < dayCount());
+    return mStore->mDayOffset[mHandle.index] + day;
+}
+
+CityStore::CityStore() : mGeneration(0)
+{
+    mTextPool.intern(QString());  // id 0, the code of cities without one
+}
+
+CityHandle CityStore::append(const WeatherInfo& info)
+{
+    quint32 index = mCityName.size();
+
+    mCode.append(0);
+    mCityName.append(0);
+    mDateWeek.append(0);
+    mTemp.append(0);
+    mGanMao.append(0);
+    mPm25.append(0);
+    mHumidity.append(0);
+    mQuality.append(0);
+    mLatitude.append(qQNaN());
+    mLongitude.append(qQNaN());
+    mDayOffset.append(mHigh.size());
+    mDayCount.append(0);
+    mDayCapacity.append(0);
+    mVersion.append(1);
+
+    writeCity(index, info);
+    addToIndex(index);
+
+    CityHandle handle;
+    handle.index = index;
+    return handle;
+}
+
+void CityStore::update(CityHandle handle, const WeatherInfo& info)
+{
+    Q_ASSERT(handle.isValid() && handle.index < quint32(size()));
+
+    removeFromIndex(handle.index);
+    mVersion[handle.index]++;
+    writeCity(handle.index, info);
+    addToIndex(handle.index);
+}
+
+CityHandle CityStore::upsert(const WeatherInfo& info)
+{
+    CityHandle handle = info.code.isEmpty() ? find(info.city) : findCode(info.code);
+    if ( !handle.isValid() && !info.code.isEmpty() ) {
+        CityHandle named = find(info.city);
+        if ( named.isValid() && mCode[named.index] == 0 ) {
+            handle = named;
+        }
+    }
+    if ( handle.isValid() ) {
+        update(handle, info);
+        return handle;
+    }
+    return append(info);
+}
+
+CityHandle CityStore::find(const QString& city) const
+{
+    CityHandle handle;
+
+    // names are interned, so look the id up first and the index second
+    quint32 nameId;
+    if ( mTextPool.find(city, &nameId) ) {
+        handle.index = mCityIndex.value(nameId, handle.index);
+    }
+    return handle;
+}
+
+CityHandle CityStore::findCode(const QString& code) const
+{
+    CityHandle handle;
+    quint32 codeId;
+    if ( !code.isEmpty() && mTextPool.find(code, &codeId) ) {
+        handle.index = mCodeIndex.value(codeId, handle.index);
+    }
+    return handle;
+}
+
+CityHandle CityStore::handleAt(int index) const
+{
+    Q_ASSERT(index >= 0 && index < size());
+
+    CityHandle handle;
+    handle.index = index;
+    return handle;
+}
+
+void CityStore::reserve(int cities, int daysPerCity)
+{
+    mCode.reserve(cities);
+    mCityName.reserve(cities);
+    mDateWeek.reserve(cities);
+    mTemp.reserve(cities);
+    mGanMao.reserve(cities);
+    mPm25.reserve(cities);
+    mHumidity.reserve(cities);
+    mQuality.reserve(cities);
+    mLatitude.reserve(cities);
+    mLongitude.reserve(cities);
+    mDayOffset.reserve(cities);
+    mDayCount.reserve(cities);
+    mDayCapacity.reserve(cities);
+    mVersion.reserve(cities);
+    mCityIndex.reserve(cities);
+    mCodeIndex.reserve(cities);
+
+    int days = cities * daysPerCity;
+    mWeek.reserve(days);
+    mDate.reserve(days);
+    mType.reserve(days);
+    mAqi.reserve(days);
+    mHigh.reserve(days);
+    mLow.reserve(days);
+    mFx.reserve(days);
+    mFl.reserve(days);
+}
+
+void CityStore::clear()
+{
+    *this = CityStore();
+}
+
+void CityStore::writeCity(quint32 index, const WeatherInfo& info)
+{
+    mGeneration++;
+
+    // 1. City Values, updates without a code keep the known one
+    if ( !info.code.isEmpty() ) {
+        mCode[index] = mTextPool.intern(info.code);
+    }
+    mCityName[index] = mTextPool.intern(info.city);
+    mDateWeek[index] = mTextPool.intern(info.dateWeek);
+    mTemp[index] = info.temp;
+    mGanMao[index] = mTextPool.intern(info.ganMao);
+    mPm25[index] = info.pm25;
+    mHumidity[index] = info.humidity;
+    mQuality[index] = mTextPool.intern(info.quality);
+    // updates without a position keep the known one
+    if ( !qIsNaN(info.latitude) && !qIsNaN(info.longitude) ) {
+        mLatitude[index] = info.latitude;
+        mLongitude[index] = info.longitude;
+    }
+
+    // 2. Forecast Days
+    int count = std::min({info.weekList.size(), info.dateList.size(), info.typeList.size(),
+                          info.qualityList.size(), info.highTemp.size(), info.lowTemp.size(),
+                          info.fx.size(), info.fl.size()});
+    count = std::min(count, 255);
+
+    // days that fit the city's slots are rewritten in place, more move to the
+    // end of the columns and the city keeps the larger slots from then on
+    if ( count > mDayCapacity[index] ) {
+        quint32 offset = mHigh.size();
+        int grown = offset + count;
+        mWeek.resize(grown);
+        mDate.resize(grown);
+        mType.resize(grown);
+        mAqi.resize(grown);
+        mHigh.resize(grown);
+        mLow.resize(grown);
+        mFx.resize(grown);
+        mFl.resize(grown);
+        mDayOffset[index] = offset;
+        mDayCapacity[index] = quint8(count);
+    }
+    mDayCount[index] = count;
+    writeDays(mDayOffset[index], info, count);
+}
+
+void CityStore::addToIndex(quint32 index)
+{
+    mCityIndex.insert(mCityName[index], index);
+    if ( mCode[index] != 0 ) {
+        mCodeIndex.insert(mCode[index], index);
+    }
+}
+
+void CityStore::removeFromIndex(quint32 index)
+{
+    // another city of the same name may own the name entry by now
+    auto it = mCityIndex.find(mCityName[index]);
+    if ( it != mCityIndex.end() && it.value() == index ) {
+        mCityIndex.erase(it);
+    }
+    mCodeIndex.remove(mCode[index]);
+}
+
+void CityStore::writeDays(quint32 offset, const WeatherInfo& info, int count)
+{
+    for ( int i = 0; i < count; i++ ) {
+        quint32 day = offset + i;
+        mWeek[day] = mDayPool.intern(info.weekList[i]);
+        mDate[day] = mDayPool.intern(info.dateList[i]);
+        mType[day] = weatherTypeFromString(info.typeList[i]);
+        mAqi[day] = info.qualityList[i];
+        mHigh[day] = info.highTemp[i];
+        mLow[day] = info.lowTemp[i];
+        mFx[day] = mDayPool.intern(info.fx[i]);
+        mFl[day] = info.fl[i];
+    }
+}
@@ -0,0 +1,192 @@
+#ifndef CITYSTORE_H
+#define CITYSTORE_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QMetaType>
+#include <QtNumeric>
+#include <memory>
+
+#include "WeatherType.h"
+
+// One city as delivered by a provider / built by hand.
+// Only used to feed the CityStore, the UI reads through CityView.
+struct WeatherInfo {
+    QString code;      // provider city code, empty when unknown (files, samples)
+    QString city;
+    QString dateWeek;
+    qint8 temp;
+
+    QString ganMao;
+    quint16 pm25;      // can go well above 127
+    quint8 humidity;   // 0 - 100 %
+    QString quality;
+    float latitude = qQNaN();   // degrees, NaN when the provider has no position
+    float longitude = qQNaN();
+
+    QList<QString> weekList;
+    QList<QString> dateList;
+    QList<QString> typeList;
+    QList<quint16> qualityList;  // AQI 0 - 500+
+    QList<qint8> highTemp;
+    QList<qint8> lowTemp;
+    QList<QString> fx;
+    QList<quint8> fl;
+};
+
+// Interns repeated strings (weekdays, dates, wind directions ...)
+// so every column only stores a small integer id.
+class StringPool
+{
+public:
+    quint32 intern(const QString& str);
+    bool find(const QString& str, quint32* id) const;
+    const QString& at(quint32 id) const { return mStrings[id]; }
+    int size() const { return mStrings.size(); }
+    void reserve(int count);
+
+private:
+    QVector<QString> mStrings;
+    QHash<QString, quint32> mIds;
+};
+
+// Stable reference to a city in a CityStore.
+// Handles stay valid for the lifetime of the store, updates happen in place.
+struct CityHandle {
+    quint32 index = 0xFFFFFFFF;
+
+    bool isValid() const { return index != 0xFFFFFFFF; }
+    bool operator==(CityHandle other) const { return index == other.index; }
+    bool operator!=(CityHandle other) const { return index != other.index; }
+};
+
+class CityStore;
+
+// Read-only, non-owning view of one city. Cheap to copy, never copies the data.
+class CityView
+{
+public:
+    CityView(const CityStore* store, CityHandle handle);
+
+    CityHandle handle() const { return mHandle; }
+    // starts at 1, bumped by every update of this city
+    quint32 version() const;
+
+    // copy of the city as a WeatherInfo, e.g. to move it to another store
+    WeatherInfo info() const;
+
+    const QString& code() const;  // empty when unknown
+    const QString& city() const;
+    const QString& dateWeek() const;
+    qint8 temp() const;
+    const QString& ganMao() const;
+    quint16 pm25() const;
+    quint8 humidity() const;
+    const QString& quality() const;
+    bool hasLocation() const;
+    float latitude() const;
+    float longitude() const;
+
+    int dayCount() const;
+    const QString& week(int day) const;
+    const QString& date(int day) const;
+    WeatherType type(int day) const;
+    QLatin1String typeLabel(int day) const;
+    quint16 aqi(int day) const;
+    qint8 highTemp(int day) const;
+    qint8 lowTemp(int day) const;
+    const QString& fx(int day) const;
+    quint8 fl(int day) const;
+
+    // contiguous day columns, dayCount() entries each
+    const qint8* highTemps() const;
+    const qint8* lowTemps() const;
+
+private:
+    int dayIndex(int day) const;
+
+    const CityStore* mStore;
+    CityHandle mHandle;
+};
+
+// Struct-of-arrays storage for many cities.
+// City level values live in one column per field, the forecast days of all
+// cities are packed back to back in the day columns (mDayOffset/mDayCount).
+class CityStore
+{
+public:
+    CityStore();
+
+    CityHandle append(const WeatherInfo& info);
+    void update(CityHandle handle, const WeatherInfo& info);
+    // known cities are updated in place, so their handles stay valid. Cities
+    // with a code are matched by it, a city known only by its name (e.g. read
+    // from a file) takes the first code it is updated with
+    CityHandle upsert(const WeatherInfo& info);
+    // by name, one of them when several cities share it
+    CityHandle find(const QString& city) const;
+    CityHandle findCode(const QString& code) const;
+
+    CityView view(CityHandle handle) const { return CityView(this, handle); }
+    CityView view(int index) const { return view(handleAt(index)); }
+    CityHandle handleAt(int index) const;
+
+    // bumped by every append/update, tells two states of a store apart
+    quint64 generation() const { return mGeneration; }
+
+    int size() const { return mCityName.size(); }
+    bool isEmpty() const { return mCityName.isEmpty(); }
+    void reserve(int cities, int daysPerCity = 6);
+    void clear();
+
+private:
+    friend class CityView;
+    friend class CitySnapshot;
+
+    void writeCity(quint32 index, const WeatherInfo& info);
+    void addToIndex(quint32 index);
+    void removeFromIndex(quint32 index);
+    void writeDays(quint32 offset, const WeatherInfo& info, int count);
+
+    StringPool mTextPool;  // city names, ganmao, quality ...
+    StringPool mDayPool;   // weekdays, dates, wind directions
+
+    QHash<quint32, quint32> mCityIndex;  // city name id -> index, the last written of a name
+    QHash<quint32, quint32> mCodeIndex;  // city code id -> index, cities with a code
+    quint64 mGeneration;
+
+    // city columns
+    QVector<quint32> mCode;
+    QVector<quint32> mCityName;
+    QVector<quint32> mDateWeek;
+    QVector<qint8> mTemp;
+    QVector<quint32> mGanMao;
+    QVector<quint16> mPm25;
+    QVector<quint8> mHumidity;
+    QVector<quint32> mQuality;
+    QVector<float> mLatitude;
+    QVector<float> mLongitude;
+    QVector<quint32> mDayOffset;
+    QVector<quint8> mDayCount;
+    QVector<quint8> mDayCapacity;  // day slots at mDayOffset, reused while the days fit
+    QVector<quint32> mVersion;
+
+    // day columns
+    QVector<quint32> mWeek;
+    QVector<quint32> mDate;
+    QVector<WeatherType> mType;
+    QVector<quint16> mAqi;
+    QVector<qint8> mHigh;
+    QVector<qint8> mLow;
+    QVector<quint32> mFx;
+    QVector<quint8> mFl;
+};
+
+// Published store, shared between threads. Never written after it is
+// published, so any thread may read it without locking.
+using CityStorePtr = std::shared_ptr<const CityStore>;
+Q_DECLARE_METATYPE(CityStorePtr)
+
+#endif // CITYSTORE_H
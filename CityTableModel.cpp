@@ -0,0 +1,131 @@
+#include "CityTableModel.h"
+
+#include "Theme.h"
+
+CityTableModel::CityTableModel(QObject* parent)
+    : QAbstractTableModel(parent), mCities(std::make_shared<CityStore>()), mRowCount(0)
+{
+}
+
+void CityTableModel::setCities(const CityStorePtr& cities)
+{
+    if ( !cities || cities == mCities ) {
+        return;
+    }
+
+    // stores only grow, anything else starts over
+    if ( cities->size() < mRowCount ) {
+        beginResetModel();
+        mCities = cities;
+        mRowCount = cities->size();
+        endResetModel();
+        return;
+    }
+
+    CityStorePtr old = mCities;
+    mCities = cities;
+
+    // 1. Changed Cells, only in rows whose city version moved
+    for ( int row = 0; row < mRowCount; row++ ) {
+        CityView before = old->view(row);
+        CityView after = mCities->view(row);
+        if ( before.version() == after.version() ) {
+            continue;
+        }
+
+        // one signal per run of neighbouring changed cells
+        int first = -1;
+        for ( int column = 0; column <= ColumnCount; column++ ) {
+            bool changed = column < ColumnCount && display(before, column) != display(after, column);
+            if ( changed && first < 0 ) {
+                first = column;
+            } else if ( !changed && first >= 0 ) {
+                emit dataChanged(index(row, first), index(row, column - 1));
+                first = -1;
+            }
+        }
+    }
+
+    // 2. New Rows
+    if ( mCities->size() > mRowCount ) {
+        beginInsertRows(QModelIndex(), mRowCount, mCities->size() - 1);
+        mRowCount = mCities->size();
+        endInsertRows();
+    }
+}
+
+int CityTableModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : mRowCount;
+}
+
+int CityTableModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant CityTableModel::data(const QModelIndex& index, int role) const
+{
+    if ( !index.isValid() || index.row() >= mRowCount ) {
+        return QVariant();
+    }
+
+    CityView city = mCities->view(index.row());
+    switch ( role ) {
+    case Qt::DisplayRole:
+        return display(city, index.column());
+    case Qt::TextAlignmentRole:
+        return index.column() == CityColumn ? int(Qt::AlignLeft | Qt::AlignVCenter) : int(Qt::AlignCenter);
+    case WeatherTypeRole:
+        return int(city.dayCount() > 0 ? city.type(today(city)) : WeatherType::Unknown);
+    case AqiBandRole:
+        return city.dayCount() > 0 ? Theme::aqiBand(city.aqi(today(city))) : -1;
+    case VersionRole:
+        return city.version();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant CityTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if ( orientation != Qt::Horizontal || role != Qt::DisplayRole ) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    static const char* const titles[] = {"City", "Temp", "Weather", "Low~High", "Air Quality", "PM2.5", "Moisture", "Wind"};
+    return QString(titles[section]);
+}
+
+QVariant CityTableModel::display(const CityView& city, int column)
+{
+    int day = today(city);
+    bool hasDay = city.dayCount() > 0;
+
+    switch ( column ) {
+    case CityColumn:
+        return city.city();
+    case TempColumn:
+        return QString::number(city.temp()) + "°";
+    case TypeColumn:
+        return hasDay ? QString(city.typeLabel(day)) : QString();
+    case LowHighColumn:
+        return hasDay ? QString::number(city.lowTemp(day)) + "~" + QString::number(city.highTemp(day)) + "°" : QString();
+    case AqiColumn:
+        return hasDay ? QString::number(city.aqi(day)) : QString();
+    case Pm25Column:
+        return QString::number(city.pm25());
+    case HumidityColumn:
+        return QString::number(city.humidity()) + "%";
+    case WindColumn:
+        return hasDay ? city.fx(day) + " Level" + QString::number(city.fl(day)) : QString();
+    default:
+        return QVariant();
+    }
+}
+
+int CityTableModel::today(const CityView& city)
+{
+    // day 0 is yesterday, same as the main widget
+    return qMin(1, city.dayCount() - 1);
+}
@@ -0,0 +1,55 @@
+#ifndef CITYTABLEMODEL_H
+#define CITYTABLEMODEL_H
+
+#include <QAbstractTableModel>
+
+#include "CityStore.h"
+
+// One row per city of a published CityStore snapshot, read through
+// CityView, so the model holds no copy of the data.
+// setCities() compares the new snapshot with the old one: rows that were
+// added are inserted, and for rows whose city version changed only the
+// cells that really differ get dataChanged(), so views repaint those cells
+// and nothing else.
+class CityTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        CityColumn,
+        TempColumn,
+        TypeColumn,
+        LowHighColumn,
+        AqiColumn,
+        Pm25Column,
+        HumidityColumn,
+        WindColumn,
+        ColumnCount
+    };
+
+    enum Role {
+        WeatherTypeRole = Qt::UserRole + 1,  // WeatherType as int, TypeColumn
+        AqiBandRole,                         // Theme::aqiBand, AqiColumn
+        VersionRole                          // CityView::version, every column
+    };
+
+    explicit CityTableModel(QObject* parent = nullptr);
+
+    void setCities(const CityStorePtr& cities);
+    CityStorePtr cities() const { return mCities; }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+private:
+    static QVariant display(const CityView& city, int column);
+    static int today(const CityView& city);
+
+    CityStorePtr mCities;
+    int mRowCount;  // trails mCities->size() while rows are being inserted
+};
+
+#endif // CITYTABLEMODEL_H
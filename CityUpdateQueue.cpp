@@ -0,0 +1,123 @@
+#include "CityUpdateQueue.h"
+#include <QDateTime>
+#include <QHash>
+#include <QThread>
+
+CityUpdateQueue::CityUpdateQueue(int capacity, QObject* parent)
+    : QObject(parent), mQueue(capacity), mClosed(false), mScheduled(false), mInterval(16), mLastDrainMs(-1), mPushed(0), mRejected(0)
+{
+    mClock.start();
+    mTimer.setSingleShot(true);
+    connect(&mTimer, &QTimer::timeout, this, &CityUpdateQueue::drain);
+}
+
+bool CityUpdateQueue::tryPush(CityUpdate update)
+{
+    if ( isClosed() ) {
+        return false;
+    }
+    update.pushedNs = mClock.nsecsElapsed();
+    update.time = QDateTime::currentSecsSinceEpoch();
+    if ( !mQueue.tryPush(std::move(update)) ) {
+        mRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    mPushed.fetch_add(1, std::memory_order_relaxed);
+
+    // only the first push after a drain posts to the event loop
+    if ( !mScheduled.exchange(true, std::memory_order_acq_rel) ) {
+        QMetaObject::invokeMethod(this, [this]() { schedule(); }, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+bool CityUpdateQueue::push(CityUpdate update, const std::function<bool()>& cancelled)
+{
+    Q_ASSERT(QThread::currentThread() != thread());
+
+    // the UI drains once per interval, give it that long before trying again
+    while ( !tryPush(update) ) {
+        if ( isClosed() || (cancelled && cancelled()) ) {
+            return false;
+        }
+        QThread::msleep(qMax(1, mInterval / 4));
+    }
+    return true;
+}
+
+void CityUpdateQueue::close()
+{
+    mClosed.store(true, std::memory_order_release);
+}
+
+CityUpdateQueueStats CityUpdateQueue::stats() const
+{
+    CityUpdateQueueStats stats = mStats;
+    stats.pushed = mPushed.load(std::memory_order_relaxed);
+    stats.rejected = mRejected.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void CityUpdateQueue::schedule()
+{
+    qint64 now = mClock.elapsed();
+    qint64 wait = mLastDrainMs < 0 ? 0 : mLastDrainMs + mInterval - now;
+    if ( wait <= 0 ) {
+        drain();
+    } else if ( !mTimer.isActive() ) {
+        mTimer.start(int(wait));
+    }
+}
+
+void CityUpdateQueue::drain()
+{
+    mTimer.stop();
+    mLastDrainMs = mClock.elapsed();
+
+    // pushes from now on schedule the next drain
+    mScheduled.store(false, std::memory_order_release);
+
+    int depth = mQueue.sizeApprox();
+
+    // 1. Pop at most one ring worth, so steady producers cannot keep the UI here
+    QVector<CityUpdate> batch;
+    QHash<QString, int> slot;  // city -> position in batch
+    int popped = 0;
+    CityUpdate update;
+    while ( popped < mQueue.capacity() && mQueue.tryPop(&update) ) {
+        popped++;
+        mStats.maxLagUs = qMax(mStats.maxLagUs, (mClock.nsecsElapsed() - update.pushedNs) / 1000);
+
+        // 2. Coalesce, the newest update of a city wins and keeps the first one's place
+        //    and the readings of those it replaces
+        auto it = slot.constFind(update.info.city);
+        if ( it != slot.constEnd() ) {
+            CityUpdate& older = batch[it.value()];
+            update.earlier = std::move(older.earlier);
+            update.earlier.append(CityHistory::observe(older.info, older.time));
+            older = std::move(update);
+            mStats.coalesced++;
+        } else {
+            slot.insert(update.info.city, batch.size());
+            batch.append(std::move(update));
+        }
+    }
+
+    if ( popped == mQueue.capacity() ) {
+        // more waiting, come back next interval
+        if ( !mScheduled.exchange(true, std::memory_order_acq_rel) ) {
+            mTimer.start(mInterval);
+        }
+    }
+
+    if ( batch.isEmpty() ) {
+        return;
+    }
+
+    mStats.drained += popped;
+    mStats.batches++;
+    mStats.maxBatch = qMax(mStats.maxBatch, batch.size());
+    mStats.maxDepth = qMax(mStats.maxDepth, depth);
+
+    emit updatesReady(batch);
+}
@@ -0,0 +1,86 @@
+#ifndef CITYUPDATEQUEUE_H
+#define CITYUPDATEQUEUE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+#include "BoundedQueue.h"
+#include "CityHistory.h"
+#include "CityStore.h"
+
+struct CityUpdate {
+    QString code;
+    WeatherInfo info;
+    qint64 pushedNs = 0;  // CityUpdateQueue clock, for the lag statistics
+    qint64 time = 0;      // seconds since the epoch, when it was pushed
+    QVector<Observation> earlier;  // readings of the updates it replaced, oldest first
+};
+
+struct CityUpdateQueueStats {
+    quint64 pushed = 0;
+    quint64 rejected = 0;    // pushes that found the queue full (backpressure)
+    quint64 drained = 0;
+    quint64 coalesced = 0;   // updates replaced by a newer one of the same city
+    quint64 batches = 0;
+    int maxBatch = 0;
+    int maxDepth = 0;        // deepest the queue was seen at a drain
+    qint64 maxLagUs = 0;     // longest push -> delivery time
+};
+
+// Carries city updates from worker threads to the thread the queue lives in
+// (the UI thread). Workers push into a bounded lock-free ring, the UI drains
+// it at most once per interval() and gets one updatesReady() per batch, with
+// several updates of the same city coalesced into the newest one (which
+// keeps the readings of the others for the history). However
+// many cities arrive, the event loop sees at most one posted call and one
+// timer per interval.
+class CityUpdateQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CityUpdateQueue(int capacity = 4096, QObject* parent = nullptr);
+
+    // any thread. false when full, the caller backs off and retries
+    bool tryPush(CityUpdate update);
+    // worker threads only, waits for room instead of dropping the update.
+    // Gives up (false) once the queue is closed or cancelled() returns true,
+    // the UI thread may be waiting for the worker instead of draining
+    bool push(CityUpdate update, const std::function<bool()>& cancelled = std::function<bool()>());
+    // pushes fail from now on, before the owner waits for its workers
+    void close();
+    bool isClosed() const { return mClosed.load(std::memory_order_acquire); }
+
+    void setInterval(int ms) { mInterval = ms; }
+    int interval() const { return mInterval; }
+    int capacity() const { return mQueue.capacity(); }
+
+    // the UI thread
+    CityUpdateQueueStats stats() const;
+    void drain();
+
+signals:
+    void updatesReady(const QVector<CityUpdate>& updates);
+
+private:
+    void schedule();
+
+    BoundedQueue<CityUpdate> mQueue;
+    std::atomic<bool> mClosed;
+    std::atomic<bool> mScheduled;  // a drain is posted or pending, set by the first push after a drain
+    QElapsedTimer mClock;
+
+    int mInterval;  // ms between drains, one frame by default
+    qint64 mLastDrainMs;
+    QTimer mTimer;
+
+    std::atomic<quint64> mPushed;
+    std::atomic<quint64> mRejected;
+    CityUpdateQueueStats mStats;  // consumer side counters
+};
+
+#endif // CITYUPDATEQUEUE_H
@@ -0,0 +1,46 @@
+#ifndef CURVECACHE_H
+#define CURVECACHE_H
+
+#include <QByteArray>
+#include <QPainter>
+#include <QPixmap>
+#include <QSize>
+
+// Offscreen layer for a painted curve.
+// The layer is only rendered again when the label size, the device pixel
+// ratio or the data key (point positions + values) changes, every other
+// paint just blits the cached pixmap.
+class CurveCache
+{
+public:
+    template <typename Render>
+    const QPixmap& layer(const QSize& size, qreal dpr, const QByteArray& key, Render render)
+    {
+        if ( mPixmap.isNull() || size != mSize || !qFuzzyCompare(dpr, mDpr) || key != mKey ) {
+            mPixmap = QPixmap(size * dpr);
+            mPixmap.setDevicePixelRatio(dpr);
+            mPixmap.fill(Qt::transparent);
+
+            QPainter painter(&mPixmap);
+            render(painter);
+
+            mSize = size;
+            mDpr = dpr;
+            mKey = key;
+            mRenderCount++;
+        }
+        return mPixmap;
+    }
+
+    void invalidate() { mPixmap = QPixmap(); }
+    quint64 renderCount() const { return mRenderCount; }
+
+private:
+    QPixmap mPixmap;
+    QSize mSize;
+    qreal mDpr = 1.0;
+    QByteArray mKey;
+    quint64 mRenderCount = 0;
+};
+
+#endif // CURVECACHE_H
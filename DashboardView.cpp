@@ -0,0 +1,68 @@
+#include "DashboardView.h"
+#include <QElapsedTimer>
+#include <QHeaderView>
+#include <QPaintEvent>
+#include <QTableView>
+#include <QVBoxLayout>
+
+#include "CityDelegate.h"
+#include "CityTableModel.h"
+#include "WeatherLog.h"
+
+// Times every viewport paint, to check scrolling stays within a frame.
+class DashboardTable : public QTableView
+{
+public:
+    explicit DashboardTable(QWidget* parent) : QTableView(parent) {}
+
+protected:
+    void paintEvent(QPaintEvent* event)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        QTableView::paintEvent(event);
+
+        int first = rowAt(event->rect().top());
+        int last = rowAt(event->rect().bottom());
+        qCDebug(lcWeatherPerf) << "DashboardView: rows" << first << "-" << last << "painted in" << timer.nsecsElapsed() / 1000 << "us";
+    }
+};
+
+DashboardView::DashboardView(QWidget* parent) : QWidget(parent)
+{
+    setWindowTitle("Weather Dashboard");
+    resize(900, 700);
+
+    mModel = new CityTableModel(this);
+
+    mTable = new DashboardTable(this);
+    mTable->setModel(mModel);
+    mTable->setItemDelegate(new CityDelegate(mTable));
+
+    // 1. Fixed sizes, so nothing is measured per row
+    mTable->verticalHeader()->hide();
+    mTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    mTable->verticalHeader()->setDefaultSectionSize(CityDelegate::ROW_HEIGHT);
+    mTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    mTable->horizontalHeader()->setDefaultSectionSize(100);
+    mTable->horizontalHeader()->resizeSection(CityTableModel::CityColumn, 160);
+    mTable->horizontalHeader()->resizeSection(CityTableModel::TypeColumn, 160);
+    mTable->horizontalHeader()->setStretchLastSection(true);
+
+    // 2. Look
+    mTable->setShowGrid(false);
+    mTable->setWordWrap(false);
+    mTable->setAlternatingRowColors(true);
+    mTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    mTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    mTable->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(mTable);
+}
+
+void DashboardView::setCities(const CityStorePtr& cities)
+{
+    mModel->setCities(cities);
+}
@@ -0,0 +1,30 @@
+#ifndef DASHBOARDVIEW_H
+#define DASHBOARDVIEW_H
+
+#include <QWidget>
+
+#include "CityStore.h"
+
+class CityTableModel;
+class QTableView;
+
+// Every city at once, one compact row each, for wall displays.
+// A QTableView over a CityTableModel: rows have one fixed height and the
+// headers do not measure contents, so the view only ever touches the rows
+// that are on screen, however many cities the store holds.
+class DashboardView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DashboardView(QWidget* parent = nullptr);
+
+    void setCities(const CityStorePtr& cities);
+    CityTableModel* model() const { return mModel; }
+
+private:
+    CityTableModel* mModel;
+    QTableView* mTable;
+};
+
+#endif // DASHBOARDVIEW_H
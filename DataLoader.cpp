@@ -0,0 +1,315 @@
+#include "DataLoader.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QtMath>
+#include <cmath>
+
+#include "CityCbor.h"
+#include "CityExporter.h"
+#include "CityJsonReader.h"
+#include "CitySnapshot.h"
+#include "WeatherLog.h"
+
+DataLoader::DataLoader(QObject* parent) : QObject(parent), mPending(0)
+{
+    qRegisterMetaType<CityStorePtr>("CityStorePtr");
+}
+
+DataLoader::~DataLoader()
+{
+    // results posted by the last tasks are dropped together with this object
+    mPool.waitForDone();
+}
+
+void DataLoader::load(const QString& path)
+{
+    mPending++;
+    mPool.start([this, path]() {
+        QString error;
+        CityStorePtr store = readFile(path, &error);
+
+        QMetaObject::invokeMethod(this, [this, store, path, error]() {
+            mPending--;
+            if ( store ) {
+                emit loaded(store, path);
+            } else {
+                emit failed(path, error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::loadSample()
+{
+    mPending++;
+    mPool.start([this]() {
+        CityStorePtr store = buildSample();
+
+        QMetaObject::invokeMethod(this, [this, store]() {
+            mPending--;
+            emit loaded(store, QString("sample"));
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::loadSynthetic(int count)
+{
+    mPending++;
+    mPool.start([this, count]() {
+        CityStorePtr store = buildSynthetic(count);
+
+        QMetaObject::invokeMethod(this, [this, store]() {
+            mPending--;
+            emit loaded(store, QString("synthetic"));
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::loadSnapshot(const QString& path)
+{
+    mPending++;
+    mPool.start([this, path]() {
+        QString error;
+        CityStorePtr store = CitySnapshot::read(path, &error);
+
+        QMetaObject::invokeMethod(this, [this, store, path, error]() {
+            mPending--;
+            if ( store ) {
+                emit loaded(store, path);
+            } else {
+                emit failed(path, error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::loadHistory(const QString& path)
+{
+    mPending++;
+    mPool.start([this, path]() {
+        QString error;
+        CityHistory history;
+        bool ok = history.read(path, &error);
+
+        QMetaObject::invokeMethod(this, [this, ok, history, path, error]() {
+            mPending--;
+            if ( ok ) {
+                emit historyLoaded(history, path);
+            } else {
+                emit failed(path, error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::save(const CityStorePtr& store, const QString& path)
+{
+    startSave(path, [this, store, path]() {
+        QString error;
+        bool ok = CitySnapshot::write(*store, path, &error);
+
+        quint64 generation = store->generation();
+        QMetaObject::invokeMethod(this, [this, ok, path, error, generation]() {
+            saveDone(path);
+            if ( ok ) {
+                emit saved(path, generation);
+            } else {
+                emit failed(path, error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::exportCities(const CityStorePtr& store, const QString& path)
+{
+    mPending++;
+    mPool.start([this, store, path]() {
+        QString error;
+        bool ok = CityExporter::write(*store, path, CityExporter::formatFor(path), &error);
+
+        int cities = store->size();
+        QMetaObject::invokeMethod(this, [this, ok, path, error, cities]() {
+            mPending--;
+            if ( ok ) {
+                emit exported(path, cities);
+            } else {
+                emit failed(path, error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::buildGeoIndex(const CityStorePtr& store)
+{
+    mPending++;
+    mPool.start([this, store]() {
+        GeoIndex index;
+        index.build(*store);
+
+        int cities = store->size();
+        QMetaObject::invokeMethod(this, [this, index, cities]() {
+            mPending--;
+            emit geoIndexReady(index, cities);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::saveHistory(const CityHistory& history, const QString& path)
+{
+    startSave(path, [this, history, path]() {
+        QString error;
+        bool ok = history.write(path, &error);
+
+        QMetaObject::invokeMethod(this, [this, ok, path, error]() {
+            saveDone(path);
+            if ( !ok ) {
+                emit failed(path, error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DataLoader::startSave(const QString& path, const std::function<void()>& task)
+{
+    // an older save still waiting is dropped, the newer one has everything it had
+    if ( mSaving.contains(path) ) {
+        if ( !mWaitingSaves.contains(path) ) {
+            mPending++;
+        }
+        mWaitingSaves.insert(path, task);
+        return;
+    }
+    mPending++;
+    mSaving.insert(path);
+    mPool.start(task);
+}
+
+void DataLoader::saveDone(const QString& path)
+{
+    mPending--;
+    mSaving.remove(path);
+    std::function<void()> next = mWaitingSaves.take(path);
+    if ( next ) {
+        mPending--;
+        startSave(path, next);
+    }
+}
+
+CityStorePtr DataLoader::readFile(const QString& path, QString* error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(path);
+    if ( !file.open(QFile::ReadOnly) ) {
+        *error = file.errorString();
+        return nullptr;
+    }
+
+    // binary batches from the relay start with the CBOR tag, everything else is JSON
+    auto store = std::make_shared<CityStore>();
+    int cities = 0;
+    qint64 bytes = 0;
+    if ( CityCborReader::isCbor(file.peek(3)) ) {
+        CityCborReader reader(store.get());
+        if ( !reader.read(&file) ) {
+            *error = reader.errorString();
+            return nullptr;
+        }
+        cities = reader.cityCount();
+        bytes = reader.bytesRead();
+    } else {
+        CityJsonReader reader(store.get());
+        reader.setDevice(&file);
+        if ( !reader.read() || !reader.atEnd() ) {
+            *error = reader.hasError() ? reader.errorString() : QString("Truncated weather dump");
+            return nullptr;
+        }
+        cities = reader.cityCount();
+        bytes = reader.bytesRead();
+    }
+
+    double seconds = qMax(timer.nsecsElapsed(), qint64(1)) / 1e9;
+    qCDebug(lcWeatherPerf) << "DataLoader:" << path << cities << "cities," << bytes << "bytes,"
+                           << bytes / 1e6 / seconds << "MB/s";
+    return store;
+}
+
+CityStorePtr DataLoader::buildSample()
+{
+    // 1. City Weather Example
+    WeatherInfo Merced;
+    Merced.city = "Merced";
+    Merced.dateWeek = "2024/04/26 Friday";
+    Merced.temp = 16;
+    Merced.ganMao = "Great for Outdoor Activities";
+    Merced.pm25 = 92;
+    Merced.humidity = 55;
+    Merced.quality = "Good";
+    Merced.latitude = 37.3022f;
+    Merced.longitude = -120.4830f;
+    Merced.weekList = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
+    Merced.dateList = {"04/25", "04/26", "04/27", "04/28", "04/29", "04/30"};
+    Merced.typeList = {"Sunny", "Sunny", "Cloudy", "Sunny", "Cloudy", "Drizzling"};
+    Merced.qualityList = {12, 45, 156, 88, 23, 9};
+    Merced.highTemp = {20, 26, 22, 28, 25, 30};
+    Merced.lowTemp = {5, 9, 6, 12, 11, 14};
+    Merced.fx = {"N Wind", "N Wind", "NW Wind", "S Wind", "NW Wind", "NE Wind"};
+    Merced.fl = {5, 10, 8, 12, 15, 18};
+
+    auto store = std::make_shared<CityStore>();
+    store->append(Merced);
+    return store;
+}
+
+CityStorePtr DataLoader::buildSynthetic(int count)
+{
+    static const char* const types[] = {"Sunny", "Cloudy", "Overcast", "Drizzling", "Thunderstorm", "Snow"};
+    static const char* const winds[] = {"N Wind", "NE Wind", "E Wind", "S Wind", "W Wind", "NW Wind"};
+    static const char* const weeks[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
+
+    auto store = std::make_shared<CityStore>();
+    store->reserve(count);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // repeatable values, spread over every type, band and wind
+    WeatherInfo info;
+    for ( int i = 0; i < 6; i++ ) {
+        info.weekList.append(weeks[i]);
+        info.dateList.append(QString("04/%1").arg(25 + i));
+        info.typeList.append(QString());
+        info.qualityList.append(0);
+        info.highTemp.append(0);
+        info.lowTemp.append(0);
+        info.fx.append(QString());
+        info.fl.append(0);
+    }
+    info.dateWeek = "2024/04/26 Friday";
+    info.ganMao = "Great for Outdoor Activities";
+    info.quality = "Good";
+
+    for ( int c = 0; c < count; c++ ) {
+        info.city = QString("City %1").arg(c);
+        info.temp = qint8(c % 45 - 10);
+        info.pm25 = quint16(c * 7 % 300);
+        info.humidity = quint8(c * 13 % 101);
+        // golden angle spiral, evenly spread over the globe
+        info.latitude = float(qRadiansToDegrees(std::asin(1.0 - 2.0 * (c + 0.5) / count)));
+        info.longitude = float(std::fmod(c * 137.50776, 360.0) - 180.0);
+        for ( int i = 0; i < 6; i++ ) {
+            int seed = c * 31 + i * 17;
+            info.typeList[i] = types[seed % 6];
+            info.qualityList[i] = quint16(seed % 400);
+            info.highTemp[i] = qint8(15 + seed % 20);
+            info.lowTemp[i] = qint8(info.highTemp[i] - 5 - seed % 10);
+            info.fx[i] = winds[(seed / 6) % 6];
+            info.fl[i] = quint8(seed % 12);
+        }
+        store->append(info);
+    }
+
+    qCDebug(lcWeatherPerf) << "DataLoader:" << count << "synthetic cities in" << timer.elapsed() << "ms";
+    return store;
+}
@@ -0,0 +1,77 @@
+#ifndef DATALOADER_H
+#define DATALOADER_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <functional>
+
+#include "CityHistory.h"
+#include "CityStore.h"
+#include "GeoIndex.h"
+
+// Reads, decodes and parses city data on worker threads.
+// Every load builds its own CityStore on a pool thread and hands it over
+// with loaded(), which is delivered on the thread the loader lives in
+// (normally the UI thread), so the UI never waits on I/O or parsing.
+class DataLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DataLoader(QObject* parent = nullptr);
+    ~DataLoader();
+
+    // provider dump, one sojson city object or an array of them, or a CityCbor batch
+    void load(const QString& path);
+    // the built-in example cities
+    void loadSample();
+    // count made up cities, to try views and updates at scale
+    void loadSynthetic(int count);
+    // last known good cities, see CitySnapshot
+    void loadSnapshot(const QString& path);
+    // readings of earlier runs, see CityHistory
+    void loadHistory(const QString& path);
+    // store written as a snapshot, replacing the one at path. Saves to a
+    // path run one at a time, a newer one waits and replaces any older one
+    // still waiting, so the newest always commits last
+    void save(const CityStorePtr& store, const QString& path);
+    // store written as JSON, CSV or CBOR, picked by the suffix of path
+    void exportCities(const CityStorePtr& store, const QString& path);
+    // positions of the cities in store, for nearest city lookups
+    void buildGeoIndex(const CityStorePtr& store);
+    // history written as it is now, the sealed blocks are shared with the copy.
+    // Queued like save()
+    void saveHistory(const CityHistory& history, const QString& path);
+
+    int pendingCount() const { return mPending; }
+    // for other file work the UI should not wait on, e.g. ResponseCache
+    QThreadPool* pool() { return &mPool; }
+
+    // count made up cities, built right away on the calling thread
+    static CityStorePtr buildSynthetic(int count);
+
+signals:
+    void loaded(const CityStorePtr& store, const QString& source);
+    void historyLoaded(const CityHistory& history, const QString& path);
+    void geoIndexReady(const GeoIndex& index, int cities);
+    void failed(const QString& source, const QString& error);
+    void saved(const QString& path, quint64 generation);
+    void exported(const QString& path, int cities);
+
+private:
+    void startSave(const QString& path, const std::function<void()>& task);
+    void saveDone(const QString& path);
+
+    static CityStorePtr readFile(const QString& path, QString* error);
+    static CityStorePtr buildSample();
+
+    QThreadPool mPool;
+    int mPending;
+    QSet<QString> mSaving;                               // paths with a save running
+    QHash<QString, std::function<void()>> mWaitingSaves; // newest save of each, run next
+};
+
+#endif // DATALOADER_H
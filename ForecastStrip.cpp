@@ -0,0 +1,313 @@
+#include "ForecastStrip.h"
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QPainterPath>
+
+#include "IconCache.h"
+#include "SeriesRenderer.h"
+#include "Theme.h"
+#include "WeatherLog.h"
+
+static const int COLUMN_SPACING = 6;   // between days
+static const int GROUP_SPACING = 16;   // between the row groups
+static const int PADDING = 12;         // outer side of a cell
+static const int INNER_PADDING = 2;    // between the two rows of a group
+static const int AQI_PADDING = 8;
+static const int ICON_SIZE = 48;
+static const int CURVE_HEIGHT = 80;
+static const int MIN_COLUMN_WIDTH = 80;
+static const int RADIUS = 4;
+
+ForecastStrip::ForecastStrip(QWidget* parent)
+    : QWidget(parent), mColumnWidth(0), mWeekColor(10, 180, 190), mCellColor(54, 93, 122), mTextColor(Qt::white),
+      mHighColor(255, 170, 0), mLowColor(0, 255, 255)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    layoutCells();
+}
+
+int ForecastStrip::setDays(const QVector<DayDisplay>& days)
+{
+    // 1. Different day count, everything moves
+    if ( days.size() != mDays.size() ) {
+        mDays.resize(days.size());
+        for ( int i = 0; i < days.size(); i++ ) {
+            Column& column = mDays[i];
+            column.day = days[i];
+            setText(&column.week, days[i].week);
+            setText(&column.date, days[i].date);
+            setText(&column.type, weatherTypeLabel(days[i].type));
+            setText(&column.aqi, days[i].aqiBand < 0 ? QString("--") : Theme::aqiText(days[i].aqiBand));
+            setText(&column.fx, days[i].fx);
+            setText(&column.fl, days[i].fl);
+        }
+        layoutCells();
+        updateGeometry();
+        update();
+        return days.size() * (RowCount - 2);
+    }
+
+    // 2. Same columns, damage only the cells that change
+    int damaged = 0;
+    for ( int i = 0; i < days.size(); i++ ) {
+        Column& column = mDays[i];
+        const DayDisplay& day = days[i];
+
+        if ( column.day.week != day.week ) {
+            setText(&column.week, day.week);
+            update(cellRect(WeekRow, i));
+            damaged++;
+        }
+        if ( column.day.date != day.date ) {
+            setText(&column.date, day.date);
+            update(cellRect(DateRow, i));
+            damaged++;
+        }
+        if ( column.day.type != day.type ) {
+            setText(&column.type, weatherTypeLabel(day.type));
+            update(cellRect(IconRow, i));
+            update(cellRect(TypeRow, i));
+            damaged += 2;
+        }
+        if ( column.day.aqiBand != day.aqiBand ) {
+            setText(&column.aqi, day.aqiBand < 0 ? QString("--") : Theme::aqiText(day.aqiBand));
+            update(cellRect(AqiRow, i));
+            damaged++;
+        }
+        if ( column.day.fx != day.fx ) {
+            setText(&column.fx, day.fx);
+            update(cellRect(FxRow, i));
+            damaged++;
+        }
+        if ( column.day.fl != day.fl ) {
+            setText(&column.fl, day.fl);
+            update(cellRect(FlRow, i));
+            damaged++;
+        }
+        column.day = day;
+    }
+    return damaged;
+}
+
+int ForecastStrip::setTemperatures(const QVector<qint8>& high, const QVector<qint8>& low)
+{
+    int damaged = 0;
+    if ( high != mHigh ) {
+        mHigh = high;
+        update(rowsRect(HighRow, HighRow));
+        damaged++;
+    }
+    if ( low != mLow ) {
+        mLow = low;
+        update(rowsRect(LowRow, LowRow));
+        damaged++;
+    }
+    return damaged;
+}
+
+QSize ForecastStrip::sizeHint() const
+{
+    int days = qMax(1, mDays.size());
+    int width = days * MIN_COLUMN_WIDTH + (days - 1) * COLUMN_SPACING;
+    return QSize(width, mRowTop[RowCount - 1] + mRowHeight[RowCount - 1]);
+}
+
+QSize ForecastStrip::minimumSizeHint() const
+{
+    return sizeHint();
+}
+
+void ForecastStrip::paintEvent(QPaintEvent* event)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QRegion& damaged = event->region();
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setFont(font());
+    qreal dpr = devicePixelRatioF();
+    int cells = 0;
+
+    // 1. Day Columns
+    static const Row groups[][2] = {{WeekRow, DateRow}, {IconRow, TypeRow}, {AqiRow, AqiRow}, {FxRow, FlRow}};
+    for ( int i = 0; i < mDays.size(); i++ ) {
+        const Column& column = mDays[i];
+
+        for ( const auto& group : groups ) {
+            QRect groupRect = cellRect(group[0], i).united(cellRect(group[1], i));
+            if ( !damaged.intersects(groupRect) ) {
+                continue;
+            }
+
+            // 1.1 Group Background
+            QColor background = mCellColor;
+            if ( group[0] == WeekRow ) {
+                background = mWeekColor;
+            } else if ( group[0] == AqiRow && column.day.aqiBand >= 0 ) {
+                background = Theme::aqiColor(column.day.aqiBand);
+            }
+            QPainterPath path;
+            path.addRoundedRect(groupRect, RADIUS, RADIUS);
+            painter.fillPath(path, background);
+
+            // 1.2 Cells
+            painter.setPen(mTextColor);
+            switch ( group[0] ) {
+            case WeekRow:
+                drawText(painter, column.week, cellRect(WeekRow, i));
+                drawText(painter, column.date, cellRect(DateRow, i));
+                break;
+            case IconRow: {
+                QPixmap icon = IconCache::instance().pixmap(column.day.type, QSize(ICON_SIZE, ICON_SIZE), dpr);
+                QRect iconRect = cellRect(IconRow, i).adjusted(0, PADDING, 0, -INNER_PADDING);
+                QSizeF size = QSizeF(icon.size()) / icon.devicePixelRatio();
+                painter.drawPixmap(QRectF(iconRect).center() - QPointF(size.width() / 2, size.height() / 2), icon);
+                drawText(painter, column.type, cellRect(TypeRow, i));
+                break;
+            }
+            case AqiRow:
+                drawText(painter, column.aqi, cellRect(AqiRow, i));
+                break;
+            default:
+                drawText(painter, column.fx, cellRect(FxRow, i));
+                drawText(painter, column.fl, cellRect(FlRow, i));
+                break;
+            }
+            cells += group[0] == group[1] ? 1 : 2;
+        }
+    }
+
+    // 2. Temperature Curves, one background for both
+    QRect curves = rowsRect(HighRow, LowRow);
+    if ( damaged.intersects(curves) ) {
+        QPainterPath path;
+        path.addRoundedRect(curves, RADIUS, RADIUS);
+        painter.fillPath(path, mCellColor);
+        drawCurve(painter, HighRow, mHighCurve, mHigh, mHighColor);
+        drawCurve(painter, LowRow, mLowCurve, mLow, mLowColor);
+        cells += 2;
+    }
+
+    qCDebug(lcWeatherPerf) << "ForecastStrip:" << cells << "cells painted in" << timer.nsecsElapsed() / 1000 << "us";
+}
+
+void ForecastStrip::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+    layoutCells();
+}
+
+void ForecastStrip::changeEvent(QEvent* event)
+{
+    QWidget::changeEvent(event);
+
+    // the style sheet sets the font after construction, lay the texts out again
+    if ( event->type() == QEvent::FontChange ) {
+        for ( Column& column : mDays ) {
+            for ( QStaticText* text : {&column.week, &column.date, &column.type, &column.aqi, &column.fx, &column.fl} ) {
+                text->prepare(QTransform(), font());
+            }
+        }
+        mHighCurve.invalidate();
+        mLowCurve.invalidate();
+        layoutCells();
+        updateGeometry();
+        update();
+    }
+}
+
+void ForecastStrip::layoutCells()
+{
+    // 1. Rows
+    int text = fontMetrics().height();
+    int heights[RowCount];
+    heights[WeekRow] = PADDING + text + INNER_PADDING;
+    heights[DateRow] = INNER_PADDING + text + PADDING;
+    heights[IconRow] = PADDING + ICON_SIZE + INNER_PADDING;
+    heights[TypeRow] = INNER_PADDING + text + PADDING;
+    heights[AqiRow] = AQI_PADDING + text + AQI_PADDING;
+    heights[HighRow] = CURVE_HEIGHT;
+    heights[LowRow] = CURVE_HEIGHT;
+    heights[FxRow] = PADDING + text + INNER_PADDING;
+    heights[FlRow] = INNER_PADDING + text + PADDING;
+
+    int y = 0;
+    for ( int row = 0; row < RowCount; row++ ) {
+        // a new group starts after the bottom row of a pair, the AQI row and the curves
+        bool groupStart = row == IconRow || row == AqiRow || row == HighRow || row == FxRow;
+        if ( groupStart ) {
+            y += GROUP_SPACING;
+        }
+        mRowTop[row] = y;
+        mRowHeight[row] = heights[row];
+        y += heights[row];
+    }
+
+    // 2. Columns
+    int days = mDays.size();
+    mColumnX.resize(days);
+    mColumnWidth = days > 0 ? (width() - (days - 1) * COLUMN_SPACING) / days : 0;
+    for ( int i = 0; i < days; i++ ) {
+        mColumnX[i] = i * (mColumnWidth + COLUMN_SPACING);
+    }
+}
+
+QRect ForecastStrip::cellRect(int row, int day) const
+{
+    return QRect(mColumnX[day], mRowTop[row], mColumnWidth, mRowHeight[row]);
+}
+
+QRect ForecastStrip::rowsRect(int firstRow, int lastRow) const
+{
+    return QRect(0, mRowTop[firstRow], width(), mRowTop[lastRow] + mRowHeight[lastRow] - mRowTop[firstRow]);
+}
+
+QVector<int> ForecastStrip::pointX() const
+{
+    QVector<int> x(mDays.size());
+    for ( int i = 0; i < mDays.size(); i++ ) {
+        x[i] = mColumnX[i] + mColumnWidth / 2;
+    }
+    return x;
+}
+
+void ForecastStrip::setText(QStaticText* text, const QString& str)
+{
+    text->setTextFormat(Qt::PlainText);
+    text->setText(str);
+    text->prepare(QTransform(), font());
+}
+
+void ForecastStrip::drawText(QPainter& painter, const QStaticText& text, const QRect& rect) const
+{
+    QSizeF size = text.size();
+    painter.drawStaticText(QRectF(rect).center() - QPointF(size.width() / 2, size.height() / 2), text);
+}
+
+void ForecastStrip::drawCurve(QPainter& painter, int row, CurveCache& cache, const QVector<qint8>& temps, const QColor& color)
+{
+    QRect rect = rowsRect(row, row);
+    QByteArray key(reinterpret_cast<const char*>(temps.constData()), temps.size());
+
+    // x positions only depend on the width and the day count, both part of the key via size and temps
+    QVector<int> x = temps.size() == mDays.size() ? pointX() : QVector<int>();
+    key.append(char(x.size()));
+
+    const QPixmap& layer = cache.layer(rect.size(), devicePixelRatioF(), key, [&](QPainter& layerPainter) {
+        layerPainter.setFont(font());
+
+        Series<qint8> series;
+        series.values = temps.constData();
+        series.count = temps.size();
+        series.color = color;
+
+        SeriesRenderer<qint8> renderer;
+        renderer.setPointX(x);
+        renderer.addSeries(series);
+        renderer.render(layerPainter, QRect(QPoint(0, 0), rect.size()).adjusted(0, INNER_PADDING, 0, -PADDING));
+    });
+    painter.drawPixmap(rect.topLeft(), layer);
+}
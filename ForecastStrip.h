@@ -0,0 +1,120 @@
+#ifndef FORECASTSTRIP_H
+#define FORECASTSTRIP_H
+
+#include <QWidget>
+#include <QColor>
+#include <QStaticText>
+#include <QVector>
+
+#include "CurveCache.h"
+#include "WeatherType.h"
+
+// What one forecast column shows, so updates only touch cells that change.
+struct DayDisplay {
+    QString week;
+    QString date;
+    WeatherType type = WeatherType::Unknown;
+    int aqiBand = -1;  // -1 while there is no data yet
+    QString fx;
+    QString fl;
+};
+
+// The whole forecast panel (week, date, weather icon and text, AQI band,
+// high/low curves, wind direction and level) for any number of days,
+// painted by one widget instead of a grid of labels.
+// Texts are laid out once into QStaticText when they change, icons come
+// pre-scaled from the IconCache and the curves from CurveCaches, so a
+// paint only blits. Changed cells are updated one by one, Qt merges them
+// into one damaged region and paintEvent skips everything outside it.
+// Colors come from the style sheet (qproperty-weekColor etc.), fonts too.
+class ForecastStrip : public QWidget
+{
+    Q_OBJECT
+    Q_PROPERTY(QColor weekColor READ weekColor WRITE setWeekColor)
+    Q_PROPERTY(QColor cellColor READ cellColor WRITE setCellColor)
+    Q_PROPERTY(QColor textColor READ textColor WRITE setTextColor)
+    Q_PROPERTY(QColor highColor READ highColor WRITE setHighColor)
+    Q_PROPERTY(QColor lowColor READ lowColor WRITE setLowColor)
+
+public:
+    explicit ForecastStrip(QWidget* parent = nullptr);
+
+    // both return how many cells were damaged
+    int setDays(const QVector<DayDisplay>& days);
+    int setTemperatures(const QVector<qint8>& high, const QVector<qint8>& low);
+
+    int dayCount() const { return mDays.size(); }
+
+    QColor weekColor() const { return mWeekColor; }
+    void setWeekColor(const QColor& color) { mWeekColor = color; update(); }
+    QColor cellColor() const { return mCellColor; }
+    void setCellColor(const QColor& color) { mCellColor = color; update(); }
+    QColor textColor() const { return mTextColor; }
+    void setTextColor(const QColor& color) { mTextColor = color; update(); }
+    QColor highColor() const { return mHighColor; }
+    void setHighColor(const QColor& color) { mHighColor = color; mHighCurve.invalidate(); update(); }
+    QColor lowColor() const { return mLowColor; }
+    void setLowColor(const QColor& color) { mLowColor = color; mLowCurve.invalidate(); update(); }
+
+    QSize sizeHint() const;
+    QSize minimumSizeHint() const;
+
+protected:
+    void paintEvent(QPaintEvent* event);
+    void resizeEvent(QResizeEvent* event);
+    void changeEvent(QEvent* event);
+
+private:
+    enum Row {
+        WeekRow,
+        DateRow,
+        IconRow,
+        TypeRow,
+        AqiRow,
+        HighRow,
+        LowRow,
+        FxRow,
+        FlRow,
+        RowCount
+    };
+
+    struct Column {
+        DayDisplay day;
+        QStaticText week;
+        QStaticText date;
+        QStaticText type;
+        QStaticText aqi;
+        QStaticText fx;
+        QStaticText fl;
+    };
+
+    void layoutCells();
+    QRect cellRect(int row, int day) const;
+    QRect rowsRect(int firstRow, int lastRow) const;
+    QVector<int> pointX() const;
+
+    void setText(QStaticText* text, const QString& str);
+    void drawText(QPainter& painter, const QStaticText& text, const QRect& rect) const;
+    void drawCurve(QPainter& painter, int row, CurveCache& cache, const QVector<qint8>& temps, const QColor& color);
+
+    QVector<Column> mDays;
+    QVector<qint8> mHigh;
+    QVector<qint8> mLow;
+
+    // geometry, rebuilt on resize, font or day count changes
+    int mRowTop[RowCount];
+    int mRowHeight[RowCount];
+    QVector<int> mColumnX;
+    int mColumnWidth;
+
+    CurveCache mHighCurve;
+    CurveCache mLowCurve;
+
+    QColor mWeekColor;
+    QColor mCellColor;
+    QColor mTextColor;
+    QColor mHighColor;
+    QColor mLowColor;
+};
+
+#endif // FORECASTSTRIP_H
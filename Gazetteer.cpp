@@ -0,0 +1,531 @@
+#include "Gazetteer.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#include "WeatherLog.h"
+
+static const char GAZETTEER_MAGIC[4] = {'W', 'G', 'Z', '1'};
+static const int HEADER_SIZE = 28;
+static const int RECORD_SIZE = 8;    // two u32 per entry / key
+static const int TRIGRAM_SIZE = 12;  // three u32 per trigram
+static const uint BOUNDARY = 0;      // pads keys, so the first and last characters have trigrams too
+static const int MAX_POSTINGS = 16384;   // longer lists barely narrow anything down, skipped
+static const int MAX_CANDIDATES = 512;   // keys compared by edit distance per fuzzy lookup
+
+static void appendU32(QByteArray* out, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian(value, bytes);
+    out->append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+static quint32 readU32(const uchar* at)
+{
+    return qFromLittleEndian<quint32>(at);
+}
+
+// FNV-1a over the three code points
+static quint32 trigramHash(uint a, uint b, uint c)
+{
+    quint32 hash = 2166136261u;
+    for ( uint value : {a, b, c} ) {
+        hash = (hash ^ value) * 16777619u;
+    }
+    return hash;
+}
+
+// distinct trigrams, sorted. Text that is still being typed has no known end
+static QVector<quint32> trigrams(const QVector<uint>& chars, bool padEnd)
+{
+    QVector<uint> padded;
+    padded.reserve(chars.size() + 2);
+    padded.append(BOUNDARY);
+    padded.append(chars);
+    if ( padEnd ) {
+        padded.append(BOUNDARY);
+    }
+
+    QVector<quint32> hashes;
+    for ( int i = 0; i + 2 < padded.size(); i++ ) {
+        hashes.append(trigramHash(padded[i], padded[i + 1], padded[i + 2]));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
+
+// Edits (insert, delete, substitute, swap neighbours) to turn text into the
+// closest prefix of key, maxEdits + 1 once it cannot stay within maxEdits.
+static int prefixDistance(const QVector<uint>& text, const QVector<uint>& key, int maxEdits)
+{
+    // key prefixes longer than this cost more than maxEdits anyway
+    int m = text.size();
+    int n = qMin(key.size(), m + maxEdits);
+
+    QVector<int> before(n + 1), previous(n + 1), row(n + 1);
+    for ( int j = 0; j <= n; j++ ) {
+        previous[j] = j;
+    }
+
+    for ( int i = 1; i <= m; i++ ) {
+        row[0] = i;
+        int best = row[0];
+        for ( int j = 1; j <= n; j++ ) {
+            int cost = text[i - 1] == key[j - 1] ? 0 : 1;
+            row[j] = qMin(qMin(previous[j] + 1, row[j - 1] + 1), previous[j - 1] + cost);
+            if ( i > 1 && j > 1 && text[i - 1] == key[j - 2] && text[i - 2] == key[j - 1] ) {
+                row[j] = qMin(row[j], before[j - 2] + 1);
+            }
+            best = qMin(best, row[j]);
+        }
+        if ( best > maxEdits ) {
+            return maxEdits + 1;
+        }
+        std::swap(before, previous);
+        std::swap(previous, row);
+    }
+
+    // any prefix of the key will do
+    return *std::min_element(previous.cbegin(), previous.cend());
+}
+
+Gazetteer::Gazetteer()
+    : mData(nullptr), mEntries(nullptr), mKeys(nullptr), mTrigrams(nullptr), mPostings(nullptr), mStrings(nullptr),
+      mEntryCount(0), mKeyCount(0), mTrigramCount(0)
+{
+}
+
+Gazetteer::~Gazetteer()
+{
+    close();
+}
+
+void Gazetteer::close()
+{
+    if ( mData ) {
+        mFile.unmap(const_cast<uchar*>(mData));
+    }
+    mFile.close();
+    mData = mEntries = mKeys = mTrigrams = mPostings = nullptr;
+    mStrings = nullptr;
+    mEntryCount = mKeyCount = mTrigramCount = 0;
+}
+
+QByteArray Gazetteer::fold(const QString& text)
+{
+    // tone marks and accents come apart from their letter and are dropped
+    QString decomposed = text.simplified().normalized(QString::NormalizationForm_KD);
+    QString folded;
+    folded.reserve(decomposed.size());
+    for ( QChar c : decomposed ) {
+        if ( !c.isMark() && c != QLatin1Char('\'') ) {
+            folded.append(c);
+        }
+    }
+    return folded.toCaseFolded().toUtf8();
+}
+
+bool Gazetteer::build(const QString& source, const QString& index, QString* error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile in(source);
+    if ( !in.open(QIODevice::ReadOnly | QIODevice::Text) ) {
+        *error = in.errorString();
+        return false;
+    }
+
+    struct Key {
+        QByteArray key;
+        quint32 entry;
+
+        bool operator<(const Key& other) const
+        {
+            int c = std::strcmp(key.constData(), other.key.constData());
+            return c < 0 || (c == 0 && entry < other.entry);
+        }
+        bool operator==(const Key& other) const { return entry == other.entry && key == other.key; }
+    };
+
+    QByteArray strings;
+    QVector<quint32> entries;  // name, code offset pairs
+    QVector<Key> keys;
+
+    auto addString = [&strings](const QByteArray& str) {
+        quint32 offset = quint32(strings.size());
+        strings.append(str);
+        strings.append('\0');
+        return offset;
+    };
+
+    // 1. Entries, one per line
+    while ( !in.atEnd() ) {
+        const QList<QByteArray> fields = in.readLine().trimmed().split('\t');
+        if ( fields.size() < 2 || fields[0].isEmpty() || fields[0].startsWith('#') ) {
+            continue;
+        }
+
+        quint32 entry = quint32(entries.size() / 2);
+        entries.append(addString(QString::fromUtf8(fields[1]).simplified().toUtf8()));
+        entries.append(addString(fields[0]));
+        for ( int i = 1; i < fields.size(); i++ ) {
+            QByteArray key = fold(QString::fromUtf8(fields[i]));
+            if ( key.isEmpty() ) {
+                continue;
+            }
+            keys.append(Key{key, entry});
+
+            // syllables ("bei jing"), also typed run together or as initials
+            const QList<QByteArray> words = key.split(' ');
+            if ( words.size() > 1 ) {
+                QByteArray initials;
+                for ( const QByteArray& word : words ) {
+                    initials += QString::fromUtf8(word).left(1).toUtf8();
+                }
+                keys.append(Key{QByteArray(key).replace(' ', ""), entry});
+                keys.append(Key{initials, entry});
+            }
+        }
+    }
+
+    // 2. Keys, sorted and without repeats
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // 3. Trigrams, as (hash, key) pairs sorted by hash, then key
+    QVector<quint32> keyOffsets;
+    QVector<quint64> pairs;
+    keyOffsets.reserve(keys.size());
+    for ( int i = 0; i < keys.size(); i++ ) {
+        keyOffsets.append(addString(keys[i].key));
+        for ( quint32 hash : trigrams(QString::fromUtf8(keys[i].key).toUcs4(), true) ) {
+            pairs.append(quint64(hash) << 32 | quint32(i));
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    QByteArray trigramTable;
+    QByteArray postings;
+    postings.reserve(pairs.size() * 4);
+    int trigramCount = 0;
+    for ( int i = 0; i < pairs.size(); ) {
+        quint32 hash = quint32(pairs[i] >> 32);
+        int first = i;
+        for ( ; i < pairs.size() && quint32(pairs[i] >> 32) == hash; i++ ) {
+            appendU32(&postings, quint32(pairs[i]));
+        }
+        appendU32(&trigramTable, hash);
+        appendU32(&trigramTable, quint32(first));
+        appendU32(&trigramTable, quint32(i - first));
+        trigramCount++;
+    }
+
+    // 4. File, written next to the old one and renamed over it
+    QByteArray header(GAZETTEER_MAGIC, 4);
+    appendU32(&header, VERSION);
+    appendU32(&header, quint32(entries.size() / 2));
+    appendU32(&header, quint32(keys.size()));
+    appendU32(&header, quint32(trigramCount));
+    appendU32(&header, quint32(pairs.size()));
+    appendU32(&header, quint32(strings.size()));
+
+    QByteArray records;
+    records.reserve((entries.size() + keys.size() * 2) * 4);
+    for ( quint32 offset : entries ) {
+        appendU32(&records, offset);
+    }
+    for ( int i = 0; i < keys.size(); i++ ) {
+        appendU32(&records, keyOffsets[i]);
+        appendU32(&records, keys[i].entry);
+    }
+
+    QSaveFile out(index);
+    if ( !out.open(QIODevice::WriteOnly) ) {
+        *error = out.errorString();
+        return false;
+    }
+    out.write(header);
+    out.write(records);
+    out.write(trigramTable);
+    out.write(postings);
+    out.write(strings);
+    if ( !out.commit() ) {
+        *error = out.errorString();
+        return false;
+    }
+
+    qCDebug(lcWeatherPerf) << "Gazetteer:" << entries.size() / 2 << "cities," << keys.size() << "keys," << trigramCount << "trigrams indexed in"
+                           << timer.elapsed() << "ms," << header.size() + records.size() + trigramTable.size() + postings.size() + strings.size() << "bytes";
+    return true;
+}
+
+bool Gazetteer::isIndex(const QString& path, quint32* version)
+{
+    QFile file(path);
+    QByteArray header = file.open(QIODevice::ReadOnly) ? file.read(8) : QByteArray();
+    if ( header.size() < 8 || !header.startsWith(QByteArray(GAZETTEER_MAGIC, 4)) ) {
+        return false;
+    }
+    if ( version ) {
+        *version = readU32(reinterpret_cast<const uchar*>(header.constData()) + 4);
+    }
+    return true;
+}
+
+bool Gazetteer::open(const QString& index, QString* error)
+{
+    // a failed open leaves the gazetteer closed, never half open
+    close();
+    mFile.setFileName(index);
+    if ( !mFile.open(QIODevice::ReadOnly) ) {
+        *error = mFile.errorString();
+        return false;
+    }
+
+    qint64 size = mFile.size();
+    const uchar* data = size >= HEADER_SIZE ? mFile.map(0, size) : nullptr;
+    mData = data;
+    if ( !data || std::memcmp(data, GAZETTEER_MAGIC, 4) != 0 || readU32(data + 4) != VERSION ) {
+        close();
+        *error = QString("Not a version %1 gazetteer index: %2").arg(VERSION).arg(index);
+        return false;
+    }
+
+    // 1. Sections must add up to the file size
+    qint64 entryCount = readU32(data + 8);
+    qint64 keyCount = readU32(data + 12);
+    qint64 trigramCount = readU32(data + 16);
+    qint64 postingCount = readU32(data + 20);
+    qint64 stringBytes = readU32(data + 24);
+    if ( HEADER_SIZE + (entryCount + keyCount) * RECORD_SIZE + trigramCount * TRIGRAM_SIZE + postingCount * 4 + stringBytes != size
+         || (stringBytes > 0 && data[size - 1] != '\0') ) {
+        close();
+        *error = QString("Truncated gazetteer index: %1").arg(index);
+        return false;
+    }
+
+    mEntries = data + HEADER_SIZE;
+    mKeys = mEntries + entryCount * RECORD_SIZE;
+    mTrigrams = mKeys + keyCount * RECORD_SIZE;
+    mPostings = mTrigrams + trigramCount * TRIGRAM_SIZE;
+    mStrings = reinterpret_cast<const char*>(mPostings + postingCount * 4);
+    mEntryCount = int(entryCount);
+    mKeyCount = int(keyCount);
+    mTrigramCount = int(trigramCount);
+
+    // 2. Offsets must stay inside the file, the strings end with a NUL.
+    //    Postings are many, fuzzy() checks the keys it reads instead
+    bool valid = true;
+    for ( int i = 0; i < mEntryCount * 2 && valid; i++ ) {
+        valid = readU32(mEntries + i * 4) < stringBytes;
+    }
+    for ( int i = 0; i < mKeyCount && valid; i++ ) {
+        valid = keyOffset(i) < stringBytes && keyEntry(i) < quint32(mEntryCount);
+    }
+    for ( int i = 0; i < mTrigramCount && valid; i++ ) {
+        const uchar* trigram = mTrigrams + i * TRIGRAM_SIZE;
+        valid = qint64(readU32(trigram + 4)) + readU32(trigram + 8) <= postingCount;
+    }
+    if ( !valid ) {
+        close();
+        *error = QString("Corrupt gazetteer index: %1").arg(index);
+        return false;
+    }
+    return true;
+}
+
+QString Gazetteer::name(int entry) const
+{
+    return QString::fromUtf8(string(readU32(mEntries + entry * RECORD_SIZE)));
+}
+
+QString Gazetteer::code(int entry) const
+{
+    return QString::fromUtf8(string(readU32(mEntries + entry * RECORD_SIZE + 4)));
+}
+
+quint32 Gazetteer::keyOffset(int key) const
+{
+    return readU32(mKeys + key * RECORD_SIZE);
+}
+
+quint32 Gazetteer::keyEntry(int key) const
+{
+    return readU32(mKeys + key * RECORD_SIZE + 4);
+}
+
+int Gazetteer::lowerBound(const QByteArray& key) const
+{
+    int first = 0;
+    int count = mKeyCount;
+    while ( count > 0 ) {
+        int step = count / 2;
+        if ( std::strcmp(string(keyOffset(first + step)), key.constData()) < 0 ) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+QVector<GazetteerMatch> Gazetteer::complete(const QString& prefix, int limit) const
+{
+    QVector<GazetteerMatch> matches;
+    QByteArray key = fold(prefix);
+    if ( !mData || key.isEmpty() ) {
+        return matches;
+    }
+
+    // keys with the prefix are neighbours, starting at its lower bound
+    for ( int i = lowerBound(key); i < mKeyCount && matches.size() < limit; i++ ) {
+        if ( std::strncmp(string(keyOffset(i)), key.constData(), size_t(key.size())) != 0 ) {
+            break;
+        }
+
+        // a name and its aliases can all match, list the city once
+        int entry = int(keyEntry(i));
+        bool listed = std::any_of(matches.cbegin(), matches.cend(), [entry](const GazetteerMatch& m) { return m.entry == entry; });
+        if ( !listed ) {
+            matches.append(GazetteerMatch{entry, name(entry), code(entry)});
+        }
+    }
+    return matches;
+}
+
+bool Gazetteer::postings(quint32 trigram, const uchar** first, int* count) const
+{
+    int low = 0;
+    int high = mTrigramCount;
+    while ( low < high ) {
+        int mid = (low + high) / 2;
+        quint32 hash = readU32(mTrigrams + mid * TRIGRAM_SIZE);
+        if ( hash < trigram ) {
+            low = mid + 1;
+        } else if ( hash > trigram ) {
+            high = mid;
+        } else {
+            *first = mPostings + readU32(mTrigrams + mid * TRIGRAM_SIZE + 4) * 4;
+            *count = int(readU32(mTrigrams + mid * TRIGRAM_SIZE + 8));
+            return true;
+        }
+    }
+    return false;
+}
+
+QVector<GazetteerMatch> Gazetteer::fuzzy(const QString& text, int limit) const
+{
+    QVector<GazetteerMatch> matches;
+    QVector<uint> chars = QString::fromUtf8(fold(text)).toUcs4();
+    if ( !mData || chars.size() < 3 ) {
+        return matches;
+    }
+    int maxEdits = chars.size() <= 4 ? 1 : chars.size() <= 8 ? 2 : 3;
+
+    // 1. Posting lists of the text's trigrams, shortest first
+    struct List {
+        const uchar* first;
+        int count;
+    };
+    const QVector<quint32> grams = trigrams(chars, false);
+    QVector<List> lists;
+    for ( quint32 gram : grams ) {
+        List list;
+        if ( postings(gram, &list.first, &list.count) ) {
+            lists.append(list);
+        }
+    }
+    if ( lists.isEmpty() ) {
+        return matches;
+    }
+    std::sort(lists.begin(), lists.end(), [](const List& a, const List& b) { return a.count < b.count; });
+
+    // 2. Keys sharing enough trigrams. Every edit breaks at most three of them,
+    //    skipped lists are counted as shared
+    int used = 1;
+    while ( used < lists.size() && lists[used].count <= MAX_POSTINGS ) {
+        used++;
+    }
+    int needed = qMax(1, grams.size() - 3 * maxEdits - (lists.size() - used));
+
+    QHash<quint32, int> shared;
+    for ( int l = 0; l < used; l++ ) {
+        for ( int i = 0; i < lists[l].count; i++ ) {
+            shared[readU32(lists[l].first + i * 4)]++;
+        }
+    }
+
+    QVector<QPair<int, quint32>> candidates;  // -shared, key
+    for ( auto it = shared.constBegin(); it != shared.constEnd(); ++it ) {
+        if ( it.value() >= needed && it.key() < quint32(mKeyCount) ) {
+            candidates.append(qMakePair(-it.value(), it.key()));
+        }
+    }
+    int compared = qMin(candidates.size(), MAX_CANDIDATES);
+    std::partial_sort(candidates.begin(), candidates.begin() + compared, candidates.end());
+
+    // 3. Edit distance, closest and then shortest key first
+    struct Scored {
+        int distance;
+        int length;
+        quint32 key;
+        bool operator<(const Scored& other) const
+        {
+            return distance != other.distance ? distance < other.distance : length < other.length;
+        }
+    };
+    QVector<Scored> scored;
+    for ( int c = 0; c < compared; c++ ) {
+        QVector<uint> key = QString::fromUtf8(string(keyOffset(int(candidates[c].second)))).toUcs4();
+        int distance = prefixDistance(chars, key, maxEdits);
+        if ( distance <= maxEdits ) {
+            scored.append(Scored{distance, key.size(), candidates[c].second});
+        }
+    }
+    std::sort(scored.begin(), scored.end());
+
+    for ( int i = 0; i < scored.size() && matches.size() < limit; i++ ) {
+        int entry = int(keyEntry(int(scored[i].key)));
+        bool listed = std::any_of(matches.cbegin(), matches.cend(), [entry](const GazetteerMatch& m) { return m.entry == entry; });
+        if ( !listed ) {
+            matches.append(GazetteerMatch{entry, name(entry), code(entry), scored[i].distance});
+        }
+    }
+    return matches;
+}
+
+QVector<GazetteerMatch> Gazetteer::search(const QString& text, int limit) const
+{
+    QVector<GazetteerMatch> matches = complete(text, limit);
+    if ( matches.size() >= limit ) {
+        return matches;
+    }
+
+    for ( const GazetteerMatch& match : fuzzy(text, limit) ) {
+        bool listed = std::any_of(matches.cbegin(), matches.cend(), [&match](const GazetteerMatch& m) { return m.entry == match.entry; });
+        if ( !listed && matches.size() < limit ) {
+            matches.append(match);
+        }
+    }
+    return matches;
+}
+
+int Gazetteer::find(const QString& text) const
+{
+    QByteArray key = fold(text);
+    if ( !mData || key.isEmpty() ) {
+        return -1;
+    }
+
+    int i = lowerBound(key);
+    if ( i < mKeyCount && std::strcmp(string(keyOffset(i)), key.constData()) == 0 ) {
+        return int(keyEntry(i));
+    }
+    return -1;
+}
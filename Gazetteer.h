@@ -0,0 +1,89 @@
+#ifndef GAZETTEER_H
+#define GAZETTEER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+struct GazetteerMatch {
+    int entry = -1;
+    QString name;
+    QString code;
+    int distance = 0;  // edits between the text and the closest key prefix
+};
+
+// Read-only list of every city we can search for, with its city code.
+// The index is a file built once from a text list (build()) and mapped
+// into memory by open(), so a launch does not read or parse anything:
+//
+//   header    "WGZ1", version, entry, key, trigram, posting count, string bytes
+//   entries   name offset, code offset               (u32 each)
+//   keys      key offset, entry                      (u32 each, sorted by key)
+//   trigrams  trigram hash, first posting, count     (u32 each, sorted by hash)
+//   postings  key                                    (u32, ascending per trigram)
+//   strings   NUL terminated UTF-8
+//
+// Everything is little-endian. A key is a folded name or alias of an entry
+// (case folded, accents dropped), pinyin aliases written in syllables
+// ("bei jing") also get a key without spaces and one of their initials, so
+// "Běijīng", "beijing" and "bj" all find 北京. A prefix lookup is a binary
+// search plus a walk over the keys that start with the prefix. Misspelled
+// text goes through the trigrams: only keys sharing enough trigrams with
+// the text are compared by edit distance, the rest of the file is never
+// touched.
+class Gazetteer
+{
+public:
+    static constexpr quint32 VERSION = 2;
+
+    Gazetteer();
+    ~Gazetteer();
+
+    // source: one city per line, "code<TAB>name[<TAB>alias ...]"
+    static bool build(const QString& source, const QString& index, QString* error);
+    static bool isIndex(const QString& path, quint32* version = nullptr);
+    // the form keys are compared in
+    static QByteArray fold(const QString& text);
+
+    // maps index, unmapping the one open before
+    bool open(const QString& index, QString* error);
+    bool isOpen() const { return mData != nullptr; }
+    void close();
+
+    int entryCount() const { return mEntryCount; }
+    int keyCount() const { return mKeyCount; }
+    QString name(int entry) const;
+    QString code(int entry) const;
+
+    // at most limit entries with a key starting with prefix, in key order
+    QVector<GazetteerMatch> complete(const QString& prefix, int limit) const;
+    // at most limit entries with a key prefix a few edits away from text, closest first
+    QVector<GazetteerMatch> fuzzy(const QString& text, int limit) const;
+    // prefix matches first, filled up with fuzzy ones
+    QVector<GazetteerMatch> search(const QString& text, int limit) const;
+    // entry with a key equal to text, -1 if there is none
+    int find(const QString& text) const;
+
+private:
+    Q_DISABLE_COPY(Gazetteer)
+
+    const char* string(quint32 offset) const { return mStrings + offset; }
+    quint32 keyOffset(int key) const;
+    quint32 keyEntry(int key) const;
+    int lowerBound(const QByteArray& key) const;
+    bool postings(quint32 trigram, const uchar** first, int* count) const;
+
+    QFile mFile;
+    const uchar* mData;
+    const uchar* mEntries;
+    const uchar* mKeys;
+    const uchar* mTrigrams;
+    const uchar* mPostings;
+    const char* mStrings;
+    int mEntryCount;
+    int mKeyCount;
+    int mTrigramCount;
+};
+
+#endif // GAZETTEER_H
@@ -0,0 +1,229 @@
+#include "GeoIndex.h"
+#include <QElapsedTimer>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "WeatherLog.h"
+
+static const double EARTH_RADIUS_KM = 6371.0;
+static const int LEAF_SIZE = 8;  // ranges this small are scanned, not split
+
+struct GeoIndex::Query {
+    float point[3];
+    int k;        // nearest(), 0 for within()
+    float bound;  // squared chord, points further away are out
+    QVector<QPair<float, quint32>> found;  // squared chord, id. A max heap while k > 0
+};
+
+static void toUnitVector(double latitude, double longitude, float* xyz)
+{
+    double lat = qDegreesToRadians(latitude);
+    double lon = qDegreesToRadians(longitude);
+    xyz[0] = float(std::cos(lat) * std::cos(lon));
+    xyz[1] = float(std::cos(lat) * std::sin(lon));
+    xyz[2] = float(std::sin(lat));
+}
+
+static double chordToKm(float chord2)
+{
+    return 2.0 * EARTH_RADIUS_KM * std::asin(qMin(1.0, std::sqrt(double(chord2)) / 2.0));
+}
+
+static float kmToChord2(double km)
+{
+    double chord = 2.0 * std::sin(qMin(km / EARTH_RADIUS_KM, M_PI) / 2.0);
+    return float(chord * chord) * 1.0001f;  // float rounding must not drop points on the edge
+}
+
+static QVector<GeoMatch> toMatches(QVector<QPair<float, quint32>> found)
+{
+    std::sort(found.begin(), found.end());
+
+    QVector<GeoMatch> matches;
+    matches.reserve(found.size());
+    for ( const auto& point : found ) {
+        matches.append(GeoMatch{point.second, chordToKm(point.first)});
+    }
+    return matches;
+}
+
+GeoIndex::GeoIndex()
+{
+}
+
+void GeoIndex::build(QVector<GeoPoint> points)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int count = points.size();
+    mX.resize(count);
+    mY.resize(count);
+    mZ.resize(count);
+    mId.resize(count);
+    mAxis.fill(0, count);
+
+    // 1. Unit vectors, in input order
+    for ( int i = 0; i < count; i++ ) {
+        float xyz[3];
+        toUnitVector(points[i].latitude, points[i].longitude, xyz);
+        mX[i] = xyz[0];
+        mY[i] = xyz[1];
+        mZ[i] = xyz[2];
+        mId[i] = points[i].id;
+    }
+
+    // 2. Tree order, as a permutation of the input
+    QVector<int> order(count);
+    for ( int i = 0; i < count; i++ ) {
+        order[i] = i;
+    }
+    split(&order, 0, count);
+
+    // 3. Arrays rearranged into tree order
+    QVector<float> x(count), y(count), z(count);
+    QVector<quint32> id(count);
+    for ( int i = 0; i < count; i++ ) {
+        x[i] = mX[order[i]];
+        y[i] = mY[order[i]];
+        z[i] = mZ[order[i]];
+        id[i] = mId[order[i]];
+    }
+    mX.swap(x);
+    mY.swap(y);
+    mZ.swap(z);
+    mId.swap(id);
+
+    qCDebug(lcWeatherPerf) << "GeoIndex:" << count << "points indexed in" << timer.elapsed() << "ms";
+}
+
+void GeoIndex::build(const CityStore& store)
+{
+    QVector<GeoPoint> points;
+    points.reserve(store.size());
+    for ( int i = 0; i < store.size(); i++ ) {
+        CityView city = store.view(i);
+        if ( city.hasLocation() ) {
+            points.append(GeoPoint{city.latitude(), city.longitude(), quint32(i)});
+        }
+    }
+    build(points);
+}
+
+void GeoIndex::split(QVector<int>* order, int first, int last)
+{
+    if ( last - first <= LEAF_SIZE ) {
+        return;
+    }
+
+    // 1. Widest axis of the range
+    const float* axes[3] = {mX.constData(), mY.constData(), mZ.constData()};
+    int axis = 0;
+    float widest = -1;
+    for ( int a = 0; a < 3; a++ ) {
+        auto bounds = std::minmax_element(order->begin() + first, order->begin() + last,
+                                          [&](int i, int j) { return axes[a][i] < axes[a][j]; });
+        float width = axes[a][*bounds.second] - axes[a][*bounds.first];
+        if ( width > widest ) {
+            widest = width;
+            axis = a;
+        }
+    }
+
+    // 2. Middle element in place, smaller ones before it, larger ones after
+    int mid = (first + last) / 2;
+    const float* values = axes[axis];
+    std::nth_element(order->begin() + first, order->begin() + mid, order->begin() + last,
+                     [values](int i, int j) { return values[i] < values[j]; });
+    mAxis[mid] = quint8(axis);
+
+    split(order, first, mid);
+    split(order, mid + 1, last);
+}
+
+QVector<GeoMatch> GeoIndex::nearest(double latitude, double longitude, int k) const
+{
+    if ( k <= 0 || isEmpty() ) {
+        return QVector<GeoMatch>();
+    }
+
+    Query query;
+    toUnitVector(latitude, longitude, query.point);
+    query.k = k;
+    query.bound = std::numeric_limits<float>::infinity();
+    query.found.reserve(k);
+    search(&query, 0, size());
+    return toMatches(query.found);
+}
+
+QVector<GeoMatch> GeoIndex::within(double latitude, double longitude, double km) const
+{
+    if ( km < 0 || isEmpty() ) {
+        return QVector<GeoMatch>();
+    }
+
+    Query query;
+    toUnitVector(latitude, longitude, query.point);
+    query.k = 0;
+    query.bound = kmToChord2(km);
+    search(&query, 0, size());
+    return toMatches(query.found);
+}
+
+void GeoIndex::search(Query* query, int first, int last) const
+{
+    if ( last - first <= LEAF_SIZE ) {
+        for ( int i = first; i < last; i++ ) {
+            visit(query, i);
+        }
+        return;
+    }
+
+    int mid = (first + last) / 2;
+    int axis = mAxis[mid];
+    const float* values = axis == 0 ? mX.constData() : axis == 1 ? mY.constData() : mZ.constData();
+    float diff = query->point[axis] - values[mid];
+    visit(query, mid);
+
+    // the side of the query first, the other one only if the bound reaches across
+    if ( diff < 0 ) {
+        search(query, first, mid);
+        if ( diff * diff <= query->bound ) {
+            search(query, mid + 1, last);
+        }
+    } else {
+        search(query, mid + 1, last);
+        if ( diff * diff <= query->bound ) {
+            search(query, first, mid);
+        }
+    }
+}
+
+void GeoIndex::visit(Query* query, int point) const
+{
+    float dx = mX[point] - query->point[0];
+    float dy = mY[point] - query->point[1];
+    float dz = mZ[point] - query->point[2];
+    float chord2 = dx * dx + dy * dy + dz * dz;
+    if ( chord2 > query->bound ) {
+        return;
+    }
+
+    if ( query->k == 0 ) {
+        query->found.append(qMakePair(chord2, mId[point]));
+        return;
+    }
+
+    // k closest so far, the furthest of them on top
+    if ( query->found.size() == query->k ) {
+        std::pop_heap(query->found.begin(), query->found.end());
+        query->found.removeLast();
+    }
+    query->found.append(qMakePair(chord2, mId[point]));
+    std::push_heap(query->found.begin(), query->found.end());
+    if ( query->found.size() == query->k ) {
+        query->bound = query->found.first().first;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef GEOINDEX_H
+#define GEOINDEX_H
+
+#include <QVector>
+
+#include "CityStore.h"
+
+struct GeoPoint {
+    float latitude;   // degrees
+    float longitude;
+    quint32 id;       // e.g. index into a CityStore
+};
+
+struct GeoMatch {
+    quint32 id;
+    double km;  // great circle distance
+};
+
+// Static k-d tree over points on the globe, for "closest city to here".
+// Points are stored as unit vectors, so distances have no trouble at the
+// poles or across the date line: the straight line (chord) between two
+// unit vectors grows with the great circle distance, the tree compares
+// chords and only the answers are converted to km.
+// The tree is implicit: every range of the arrays is split at its middle
+// element along its widest axis, the halves are the subtrees. Built once
+// with build(), after that it is read only and may be queried from any
+// thread.
+class GeoIndex
+{
+public:
+    GeoIndex();
+
+    void build(QVector<GeoPoint> points);
+    // every city with a location, ids are store indexes
+    void build(const CityStore& store);
+
+    int size() const { return mId.size(); }
+    bool isEmpty() const { return mId.isEmpty(); }
+
+    // the k closest points, closest first
+    QVector<GeoMatch> nearest(double latitude, double longitude, int k = 1) const;
+    // every point within km, closest first
+    QVector<GeoMatch> within(double latitude, double longitude, double km) const;
+
+private:
+    struct Query;
+
+    void split(QVector<int>* order, int first, int last);
+    void search(Query* query, int first, int last) const;
+    void visit(Query* query, int point) const;
+
+    // point arrays in tree order
+    QVector<float> mX;
+    QVector<float> mY;
+    QVector<float> mZ;
+    QVector<quint32> mId;
+    QVector<quint8> mAxis;  // split axis of the range whose middle is this point
+};
+
+#endif // GEOINDEX_H
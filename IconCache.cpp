@@ -0,0 +1,108 @@
+#include "IconCache.h"
+
+IconCache& IconCache::instance()
+{
+    static IconCache cache;
+    return cache;
+}
+
+IconCache::IconCache()
+{
+    // weather icons come first so their id is the WeatherType value
+    // (Unknown shares its path with DuoYun, so ids are assigned by hand here)
+    for ( int i = 0; i < int(WeatherType::Count); i++ ) {
+        QString path = weatherTypeIcon(WeatherType(i));
+        mPaths.append(path);
+        mSources.append(QPixmap());
+        if ( !mIds.contains(path) ) {
+            mIds.insert(path, i);
+        }
+    }
+}
+
+void IconCache::preload()
+{
+    for ( int i = 0; i < mPaths.size(); i++ ) {
+        source(i);
+    }
+}
+
+QPixmap IconCache::pixmap(WeatherType type, const QSize& size, qreal dpr)
+{
+    return variant(int(type), size, dpr);
+}
+
+QPixmap IconCache::pixmap(const QString& path, const QSize& size, qreal dpr)
+{
+    return variant(iconId(path), size, dpr);
+}
+
+void IconCache::clear()
+{
+    mSources.fill(QPixmap());
+    mVariants.clear();
+    mStats = IconCacheStats();
+}
+
+int IconCache::iconId(const QString& path)
+{
+    auto it = mIds.constFind(path);
+    if ( it != mIds.constEnd() ) {
+        return it.value();
+    }
+
+    int id = mPaths.size();
+    mPaths.append(path);
+    mSources.append(QPixmap());
+    mIds.insert(path, id);
+    return id;
+}
+
+const QPixmap& IconCache::source(int id)
+{
+    QPixmap& pixmap = mSources[id];
+    if ( pixmap.isNull() ) {
+        // a path that is shared with an earlier id is decoded only once
+        int first = mIds.value(mPaths[id], id);
+        if ( first != id ) {
+            pixmap = source(first);
+        } else {
+            pixmap = QPixmap(mPaths[id]);
+            mStats.bytes += bytesOf(pixmap);
+        }
+    }
+    return pixmap;
+}
+
+QPixmap IconCache::variant(int id, const QSize& size, qreal dpr)
+{
+    // 1. Build Key: icon id | width | height | dpr in 1/100 steps
+    quint64 dprKey = quint64(qRound(dpr * 100)) & 0xFFFF;
+    quint64 w = size.isValid() ? quint64(size.width()) & 0xFFFF : 0;
+    quint64 h = size.isValid() ? quint64(size.height()) & 0xFFFF : 0;
+    quint64 key = (quint64(id) << 48) | (w << 32) | (h << 16) | dprKey;
+
+    auto it = mVariants.constFind(key);
+    if ( it != mVariants.constEnd() ) {
+        mStats.hits++;
+        return it.value();
+    }
+
+    // 2. Scale Once
+    mStats.misses++;
+    const QPixmap& src = source(id);
+    QPixmap scaled = src;
+    if ( !src.isNull() && size.isValid() ) {
+        scaled = src.scaled(size * dpr, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        scaled.setDevicePixelRatio(dpr);
+        mStats.bytes += bytesOf(scaled);
+    }
+
+    mVariants.insert(key, scaled);
+    return scaled;
+}
+
+qint64 IconCache::bytesOf(const QPixmap& pixmap)
+{
+    return qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+}
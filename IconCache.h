@@ -0,0 +1,54 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QHash>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "WeatherType.h"
+
+struct IconCacheStats {
+    quint64 hits = 0;
+    quint64 misses = 0;  // variants that had to be scaled
+    qint64 bytes = 0;    // decoded sources + scaled variants
+};
+
+// Decodes every icon once and hands out shared, pre-scaled QPixmaps.
+// Variants are keyed by icon id, target size and device pixel ratio, so a
+// label can show its icon without decoding the PNG or scaling on paint.
+// Weather icons use the WeatherType value as icon id, other resources get
+// an id the first time their path is seen. GUI thread only (QPixmap).
+class IconCache
+{
+public:
+    static IconCache& instance();
+
+    void preload();
+
+    // size in device independent pixels, an invalid size keeps the icon's own size
+    QPixmap pixmap(WeatherType type, const QSize& size, qreal dpr);
+    QPixmap pixmap(const QString& path, const QSize& size, qreal dpr);
+
+    IconCacheStats stats() const { return mStats; }
+    void clear();
+
+private:
+    IconCache();
+
+    int iconId(const QString& path);
+    const QPixmap& source(int id);
+    QPixmap variant(int id, const QSize& size, qreal dpr);
+
+    static qint64 bytesOf(const QPixmap& pixmap);
+
+    QVector<QString> mPaths;               // icon id -> resource path
+    QHash<QString, int> mIds;              // resource path -> icon id
+    QVector<QPixmap> mSources;             // icon id -> decoded icon
+    QHash<quint64, QPixmap> mVariants;     // (id, size, dpr) -> scaled icon
+
+    IconCacheStats mStats;
+};
+
+#endif // ICONCACHE_H
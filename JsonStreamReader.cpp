@@ -0,0 +1,387 @@
+#include "JsonStreamReader.h"
+#include <QIODevice>
+
+static const int CHUNK_SIZE = 64 * 1024;
+
+JsonStreamReader::JsonStreamReader()
+    : mDevice(nullptr), mPos(0), mConsumed(0), mExpect(ExpectValue), mTokenType(NoToken),
+      mNumber(0), mBool(false), mError(NoError)
+{
+}
+
+JsonStreamReader::JsonStreamReader(QIODevice* device) : JsonStreamReader()
+{
+    mDevice = device;
+}
+
+void JsonStreamReader::setDevice(QIODevice* device)
+{
+    clear();
+    mDevice = device;
+}
+
+void JsonStreamReader::addData(const QByteArray& data)
+{
+    mBuffer.append(data);
+}
+
+void JsonStreamReader::clear()
+{
+    mDevice = nullptr;
+    mBuffer.clear();
+    mPos = 0;
+    mConsumed = 0;
+    mStack.clear();
+    mExpect = ExpectValue;
+    mTokenType = NoToken;
+    mError = NoError;
+    mErrorString.clear();
+}
+
+JsonStreamReader::TokenType JsonStreamReader::readNext()
+{
+    if ( mError == NotWellFormedError ) {
+        return Invalid;
+    }
+    if ( mTokenType == EndDocument ) {
+        return EndDocument;
+    }
+    mError = NoError;
+
+    // drop what is consumed, the buffer only holds the unread part
+    if ( mPos > CHUNK_SIZE ) {
+        mBuffer.remove(0, mPos);
+        mConsumed += mPos;
+        mPos = 0;
+    }
+
+    // on premature end everything goes back to here
+    int start = mPos;
+    Expect expect = mExpect;
+
+    if ( !skipWhitespace() ) {
+        if ( mExpect == ExpectDone ) {
+            mTokenType = EndDocument;
+            return mTokenType;
+        }
+        return premature();
+    }
+
+    char c = mBuffer[mPos];
+    TokenType token = Invalid;
+
+    switch ( mExpect ) {
+    case ExpectDone:
+        return notWellFormed("Unexpected data after the document");
+
+    case ExpectValue:
+        token = parseValue();
+        break;
+
+    case ExpectNameOrEnd:
+        if ( c == '}' ) {
+            mPos++;
+            mStack.removeLast();
+            valueDone();
+            token = EndObject;
+        } else {
+            token = parseName();
+        }
+        break;
+
+    case ExpectValueOrEnd:
+        if ( c == ']' ) {
+            mPos++;
+            mStack.removeLast();
+            valueDone();
+            token = EndArray;
+        } else {
+            token = parseValue();
+        }
+        break;
+
+    case ExpectCommaOrEnd:
+        if ( c == ',' ) {
+            mPos++;
+            if ( !skipWhitespace() ) {
+                token = Invalid;
+                mError = PrematureEndOfDocumentError;
+                break;
+            }
+            token = mStack.last() == '{' ? parseName() : parseValue();
+        } else if ( c == '}' && mStack.last() == '{' ) {
+            mPos++;
+            mStack.removeLast();
+            valueDone();
+            token = EndObject;
+        } else if ( c == ']' && mStack.last() == '[' ) {
+            mPos++;
+            mStack.removeLast();
+            valueDone();
+            token = EndArray;
+        } else {
+            return notWellFormed(QString("Expected ',' or end of container at offset %1").arg(bytesConsumed()));
+        }
+        break;
+    }
+
+    if ( token == Invalid && mError == PrematureEndOfDocumentError ) {
+        mPos = start;
+        mExpect = expect;
+        return premature();
+    }
+
+    mTokenType = token;
+    return token;
+}
+
+bool JsonStreamReader::fill()
+{
+    if ( !mDevice ) {
+        return false;
+    }
+
+    QByteArray chunk = mDevice->read(CHUNK_SIZE);
+    if ( chunk.isEmpty() ) {
+        return false;
+    }
+    mBuffer.append(chunk);
+    return true;
+}
+
+bool JsonStreamReader::ensure(int count)
+{
+    while ( mBuffer.size() - mPos < count ) {
+        if ( !fill() ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonStreamReader::skipWhitespace()
+{
+    forever {
+        while ( mPos < mBuffer.size() ) {
+            char c = mBuffer[mPos];
+            if ( c != ' ' && c != '\n' && c != '\r' && c != '\t' ) {
+                return true;
+            }
+            mPos++;
+        }
+        if ( !fill() ) {
+            return false;
+        }
+    }
+}
+
+JsonStreamReader::TokenType JsonStreamReader::parseValue()
+{
+    char c = mBuffer[mPos];
+    switch ( c ) {
+    case '{':
+        mPos++;
+        mStack.append('{');
+        mExpect = ExpectNameOrEnd;
+        return StartObject;
+    case '[':
+        mPos++;
+        mStack.append('[');
+        mExpect = ExpectValueOrEnd;
+        return StartArray;
+    case '"':
+        if ( !parseString(&mText) ) {
+            return Invalid;
+        }
+        valueDone();
+        return String;
+    case 't':
+        return parseLiteral("true", Bool, true);
+    case 'f':
+        return parseLiteral("false", Bool, false);
+    case 'n':
+        return parseLiteral("null", Null, false);
+    default:
+        if ( c == '-' || (c >= '0' && c <= '9') ) {
+            return parseNumber();
+        }
+        notWellFormed(QString("Unexpected character at offset %1").arg(bytesConsumed()));
+        return Invalid;
+    }
+}
+
+JsonStreamReader::TokenType JsonStreamReader::parseName()
+{
+    if ( mBuffer[mPos] != '"' ) {
+        notWellFormed(QString("Expected a name at offset %1").arg(bytesConsumed()));
+        return Invalid;
+    }
+    if ( !parseString(&mText) ) {
+        return Invalid;
+    }
+
+    // the ':' belongs to the name
+    if ( !skipWhitespace() ) {
+        mError = PrematureEndOfDocumentError;
+        return Invalid;
+    }
+    if ( mBuffer[mPos] != ':' ) {
+        notWellFormed(QString("Expected ':' at offset %1").arg(bytesConsumed()));
+        return Invalid;
+    }
+    mPos++;
+    mExpect = ExpectValue;
+    return Name;
+}
+
+bool JsonStreamReader::parseString(QString* out)
+{
+    // 1. Find the closing quote, so the whole string is in the buffer
+    int end = mPos + 1;
+    bool escaped = false;
+    forever {
+        if ( end >= mBuffer.size() ) {
+            if ( !fill() ) {
+                mError = PrematureEndOfDocumentError;
+                return false;
+            }
+            continue;
+        }
+        char c = mBuffer[end];
+        if ( c == '\\' ) {
+            escaped = true;
+            end += 2;
+            continue;
+        }
+        if ( c == '"' ) {
+            break;
+        }
+        end++;
+    }
+
+    // 2. Decode
+    const char* data = mBuffer.constData();
+    if ( !escaped ) {
+        *out = QString::fromUtf8(data + mPos + 1, end - mPos - 1);
+        mPos = end + 1;
+        return true;
+    }
+
+    out->clear();
+    int run = mPos + 1;
+    int i = run;
+    while ( i < end ) {
+        if ( data[i] != '\\' ) {
+            i++;
+            continue;
+        }
+
+        out->append(QString::fromUtf8(data + run, i - run));
+        char e = data[i + 1];
+        i += 2;
+        switch ( e ) {
+        case '"': out->append(QChar('"')); break;
+        case '\\': out->append(QChar('\\')); break;
+        case '/': out->append(QChar('/')); break;
+        case 'b': out->append(QChar('\b')); break;
+        case 'f': out->append(QChar('\f')); break;
+        case 'n': out->append(QChar('\n')); break;
+        case 'r': out->append(QChar('\r')); break;
+        case 't': out->append(QChar('\t')); break;
+        case 'u': {
+            // surrogate pairs come as two escapes, each one is a UTF-16 unit
+            bool ok = false;
+            ushort unit = i + 4 <= end ? QByteArray(data + i, 4).toUShort(&ok, 16) : 0;
+            if ( !ok ) {
+                notWellFormed(QString("Bad \\u escape at offset %1").arg(mConsumed + i));
+                return false;
+            }
+            out->append(QChar(unit));
+            i += 4;
+            break;
+        }
+        default:
+            notWellFormed(QString("Bad escape at offset %1").arg(mConsumed + i));
+            return false;
+        }
+        run = i;
+    }
+    out->append(QString::fromUtf8(data + run, end - run));
+
+    mPos = end + 1;
+    return true;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::parseNumber()
+{
+    int end = mPos;
+    forever {
+        if ( end >= mBuffer.size() ) {
+            if ( fill() ) {
+                continue;
+            }
+            // a number can only end the input when it is the whole document
+            if ( !(mStack.isEmpty() && mDevice && mDevice->atEnd()) ) {
+                mError = PrematureEndOfDocumentError;
+                return Invalid;
+            }
+            break;
+        }
+        char c = mBuffer[end];
+        if ( !((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') ) {
+            break;
+        }
+        end++;
+    }
+
+    bool ok = false;
+    mNumberText = mBuffer.mid(mPos, end - mPos);
+    mNumber = mNumberText.toDouble(&ok);
+    if ( !ok ) {
+        notWellFormed(QString("Bad number at offset %1").arg(bytesConsumed()));
+        return Invalid;
+    }
+
+    mPos = end;
+    valueDone();
+    return Number;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::parseLiteral(const char* literal, TokenType type, bool value)
+{
+    int length = int(qstrlen(literal));
+    if ( !ensure(length) ) {
+        mError = PrematureEndOfDocumentError;
+        return Invalid;
+    }
+    if ( qstrncmp(mBuffer.constData() + mPos, literal, length) != 0 ) {
+        notWellFormed(QString("Unexpected literal at offset %1").arg(bytesConsumed()));
+        return Invalid;
+    }
+
+    mPos += length;
+    mBool = value;
+    valueDone();
+    return type;
+}
+
+void JsonStreamReader::valueDone()
+{
+    mExpect = mStack.isEmpty() ? ExpectDone : ExpectCommaOrEnd;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::premature()
+{
+    mError = PrematureEndOfDocumentError;
+    mErrorString = "Premature end of document";
+    mTokenType = Invalid;
+    return Invalid;
+}
+
+JsonStreamReader::TokenType JsonStreamReader::notWellFormed(const QString& message)
+{
+    mError = NotWellFormedError;
+    mErrorString = message;
+    mTokenType = Invalid;
+    return Invalid;
+}
@@ -0,0 +1,107 @@
+#ifndef JSONSTREAMREADER_H
+#define JSONSTREAMREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+// Pull parser for JSON, used like QXmlStreamReader.
+// Input comes from a QIODevice or from addData() chunks. Only the token
+// being parsed is buffered, consumed input is dropped. When the input runs
+// out in the middle of a token, readNext() returns Invalid with
+// PrematureEndOfDocumentError and continues from the same spot after more
+// data arrives (e.g. from a QNetworkReply's readyRead).
+class JsonStreamReader
+{
+public:
+    enum TokenType {
+        NoToken,
+        Invalid,
+        StartObject,
+        EndObject,
+        StartArray,
+        EndArray,
+        Name,
+        String,
+        Number,
+        Bool,
+        Null,
+        EndDocument
+    };
+
+    enum Error {
+        NoError,
+        NotWellFormedError,
+        PrematureEndOfDocumentError
+    };
+
+    JsonStreamReader();
+    explicit JsonStreamReader(QIODevice* device);
+
+    void setDevice(QIODevice* device);
+    void addData(const QByteArray& data);
+    void clear();
+
+    TokenType readNext();
+    TokenType tokenType() const { return mTokenType; }
+    bool atEnd() const { return mTokenType == EndDocument || mError == NotWellFormedError; }
+
+    // Name and String tokens
+    const QString& text() const { return mText; }
+    // Number tokens, the raw text is kept for integers that do not fit a double
+    double number() const { return mNumber; }
+    const QByteArray& numberText() const { return mNumberText; }
+    // Bool tokens
+    bool boolean() const { return mBool; }
+
+    int depth() const { return mStack.size(); }
+    qint64 bytesConsumed() const { return mConsumed + mPos; }
+
+    Error error() const { return mError; }
+    bool hasError() const { return mError != NoError; }
+    QString errorString() const { return mErrorString; }
+
+private:
+    enum Expect {
+        ExpectValue,
+        ExpectNameOrEnd,   // after '{'
+        ExpectValueOrEnd,  // after '['
+        ExpectCommaOrEnd,  // after a value inside a container
+        ExpectDone         // top level value complete
+    };
+
+    bool fill();
+    bool ensure(int count);
+    bool skipWhitespace();
+
+    TokenType parseValue();
+    TokenType parseName();
+    bool parseString(QString* out);
+    TokenType parseNumber();
+    TokenType parseLiteral(const char* literal, TokenType type, bool value);
+    void valueDone();
+
+    TokenType premature();
+    TokenType notWellFormed(const QString& message);
+
+    QIODevice* mDevice;
+    QByteArray mBuffer;
+    int mPos;
+    qint64 mConsumed;  // bytes dropped from the front of mBuffer
+
+    QVector<char> mStack;  // '{' or '['
+    Expect mExpect;
+
+    TokenType mTokenType;
+    QString mText;
+    double mNumber;
+    QByteArray mNumberText;
+    bool mBool;
+
+    Error mError;
+    QString mErrorString;
+};
+
+#endif // JSONSTREAMREADER_H
@@ -0,0 +1,161 @@
+#include "MapView.h"
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPainterPath>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+
+#include "Theme.h"
+#include "WeatherLog.h"
+
+static const double MARKER_SPACING = 40;  // px, closer cities are clustered
+static const double MAX_SCALE = 1 << 22;  // px per map unit, street level
+
+MapView::MapView(QWidget* parent) : QWidget(parent), mCenter(0.5, 0.5), mScale(1024)
+{
+    setWindowTitle("Weather Map");
+    resize(1024, 700);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void MapView::setCities(const CityStorePtr& cities)
+{
+    if ( !cities || cities == mCities ) {
+        return;
+    }
+    mCities = cities;
+
+    QElapsedTimer timer;
+    timer.start();
+    mTree.sync(*cities);
+    qCDebug(lcWeatherPerf) << "MapView:" << mTree.size() << "cities synced in" << timer.nsecsElapsed() / 1000 << "us";
+    update();
+}
+
+void MapView::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+    QElapsedTimer timer;
+    timer.start();
+
+    QPainter painter(this);
+    int markers = paintMap(&painter, size());
+    qCDebug(lcWeatherPerf) << "MapView:" << markers << "markers painted in" << timer.nsecsElapsed() / 1000 << "us";
+}
+
+void MapView::wheelEvent(QWheelEvent* event)
+{
+    zoom(std::pow(1.2, event->angleDelta().y() / 120.0), event->position());
+    event->accept();
+}
+
+void MapView::mousePressEvent(QMouseEvent* event)
+{
+    mDragFrom = event->pos();
+}
+
+void MapView::mouseMoveEvent(QMouseEvent* event)
+{
+    mCenter -= QPointF(event->pos() - mDragFrom) / mScale;
+    mDragFrom = event->pos();
+    update();
+}
+
+void MapView::zoom(double factor, const QPointF& anchor)
+{
+    // the map point under the anchor stays where it is
+    QRectF visible = viewport(size());
+    QPointF fixed = visible.topLeft() + anchor / mScale;
+    mScale = qBound(double(qMax(width(), 1)), mScale * factor, MAX_SCALE);
+    mCenter = fixed + (QPointF(width(), height()) / 2 - anchor) / mScale;
+    update();
+}
+
+QRectF MapView::viewport(const QSizeF& size) const
+{
+    QSizeF span = size / mScale;
+    return QRectF(mCenter - QPointF(span.width(), span.height()) / 2, span);
+}
+
+int MapView::paintMap(QPainter* painter, const QSizeF& size)
+{
+    painter->fillRect(QRectF(QPointF(), size), QColor(24, 32, 48));
+
+    // 1. Markers, about one per MARKER_SPACING px
+    QRectF visible = viewport(size);
+    QVector<MapCluster> clusters = mTree.clusters(visible, MARKER_SPACING / mScale);
+
+    QVector<QPainterPath> bands(Theme::aqiBandCount());
+    QVector<QPointF> centers;
+    centers.reserve(clusters.size());
+    for ( const MapCluster& cluster : clusters ) {
+        QPointF center = (cluster.total.position() - visible.topLeft()) * mScale;
+        double radius = 8 + 3 * std::log2(double(cluster.total.count));
+        bands[Theme::aqiBand(cluster.total.worstAqi)].addEllipse(center, radius, radius);
+        centers.append(center);
+    }
+
+    // 2. One fill per AQI band
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    for ( int band = 0; band < bands.size(); band++ ) {
+        if ( !bands[band].isEmpty() ) {
+            painter->fillPath(bands[band], Theme::aqiColor(band));
+        }
+    }
+
+    // 3. Temperatures
+    painter->setPen(Qt::white);
+    for ( int i = 0; i < clusters.size(); i++ ) {
+        const QStaticText& text = label(qRound(clusters[i].total.meanTemp()));
+        painter->drawStaticText(centers[i] - QPointF(text.size().width(), text.size().height()) / 2, text);
+    }
+    return clusters.size();
+}
+
+const QStaticText& MapView::label(int temp)
+{
+    auto it = mLabels.find(temp);
+    if ( it == mLabels.end() ) {
+        it = mLabels.insert(temp, QStaticText(QString::number(temp) + "°"));
+        it->prepare(QTransform(), font());
+    }
+    return it.value();
+}
+
+void MapView::benchmark(int frames)
+{
+    if ( frames <= 0 ) {
+        return;
+    }
+
+    QImage image(size(), QImage::Format_ARGB32_Premultiplied);
+    QPointF center = mCenter;
+    double scale = mScale;
+
+    // zooms from the whole world down to city level and back while panning east
+    QVector<qint64> samples;
+    qint64 markers = 0;
+    samples.reserve(frames);
+    for ( int f = 0; f < frames; f++ ) {
+        double phase = double(f) / frames;
+        mScale = qMax(double(width()), std::pow(2.0, 10 + 10 * std::sin(phase * M_PI)));
+        mCenter = QPointF(std::fmod(0.2 + phase * 0.6, 1.0), 0.35 + 0.1 * std::sin(phase * 4 * M_PI));
+
+        QElapsedTimer timer;
+        timer.start();
+        QPainter painter(&image);
+        markers += paintMap(&painter, image.size());
+        painter.end();
+        samples.append(timer.nsecsElapsed());
+    }
+
+    mCenter = center;
+    mScale = scale;
+    std::sort(samples.begin(), samples.end());
+    qCDebug(lcWeatherPerf) << "MapView benchmark:" << frames << "frames over" << mTree.size() << "cities,"
+                           << markers / frames << "markers each, p50" << samples[frames / 2] / 1000 << "us, p99"
+                           << samples[qMin(frames - 1, frames * 99 / 100)] / 1000 << "us, max" << samples.last() / 1000 << "us";
+}
@@ -0,0 +1,51 @@
+#ifndef MAPVIEW_H
+#define MAPVIEW_H
+
+#include <QHash>
+#include <QStaticText>
+#include <QWidget>
+
+#include "CityQuadtree.h"
+#include "CityStore.h"
+
+// Every city with a position as a marker on a Web Mercator plane, colored
+// by its worst AQI and labeled with its (mean) temperature. Drag to pan,
+// wheel to zoom. Markers come from a CityQuadtree: cities closer than a
+// marker apart are drawn as one cluster, so a frame draws a few hundred
+// markers however many cities are in view. Markers of one AQI band are
+// filled as one path, temperature labels are cached QStaticTexts.
+class MapView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MapView(QWidget* parent = nullptr);
+
+    void setCities(const CityStorePtr& cities);
+
+    // pans and zooms through frames frames off screen, logs the frame times
+    void benchmark(int frames);
+
+protected:
+    void paintEvent(QPaintEvent* event);
+    void wheelEvent(QWheelEvent* event);
+    void mousePressEvent(QMouseEvent* event);
+    void mouseMoveEvent(QMouseEvent* event);
+
+private:
+    QRectF viewport(const QSizeF& size) const;  // visible map units
+    int paintMap(QPainter* painter, const QSizeF& size);
+    const QStaticText& label(int temp);
+    void zoom(double factor, const QPointF& anchor);
+
+    CityStorePtr mCities;
+    CityQuadtree mTree;
+
+    QPointF mCenter;  // map units
+    double mScale;    // pixels per map unit
+    QPoint mDragFrom;
+
+    QHash<int, QStaticText> mLabels;  // temperature -> label
+};
+
+#endif // MAPVIEW_H
@@ -0,0 +1,240 @@
+#include "RefreshScheduler.h"
+#include <QVector>
+#include <algorithm>
+#include <climits>
+
+#include "CityPublisher.h"
+
+RefreshScheduler::RefreshScheduler(const CityPublisher* cities, QObject* parent)
+    : QObject(parent), mCities(cities), mActive(false), mDwell(3000), mPrepareLead(300), mRefreshInterval(600),
+      mRetryInterval(60), mIndex(0), mPreparedIndex(-1), mNextRotateMs(0)
+{
+    mClock.start();
+    mTimer.setSingleShot(true);
+    // up to 5% late, so the wakeup can share the OS timer with others
+    mTimer.setTimerType(Qt::CoarseTimer);
+    connect(&mTimer, &QTimer::timeout, this, &RefreshScheduler::wake);
+}
+
+void RefreshScheduler::setDwell(int ms)
+{
+    mDwell = qMax(100, ms);
+    mPrepareLead = qMin(mPrepareLead, mDwell / 2);
+    mNextRotateMs = mClock.elapsed() + mDwell;
+    reschedule();
+}
+
+void RefreshScheduler::setPrepareLead(int ms)
+{
+    mPrepareLead = qBound(0, ms, mDwell / 2);
+    reschedule();
+}
+
+void RefreshScheduler::setRefreshInterval(int seconds)
+{
+    mRefreshInterval = qMax(1, seconds);
+    reschedule();
+}
+
+void RefreshScheduler::setActive(bool active)
+{
+    if ( mActive == active ) {
+        return;
+    }
+    mActive = active;
+
+    if ( mActive ) {
+        // the city chosen while inactive (a jump, the prepared turn) was not
+        // drawn, it is now and gets a full dwell, stale data right away
+        mNextRotateMs = mClock.elapsed() + mDwell;
+        if ( mIndex < mCities->current()->size() ) {
+            emit showCity(mIndex);
+        }
+        wake();
+        return;
+    }
+
+    // a prepared turn is taken now, the window shows it when it comes back
+    if ( mPreparedIndex >= 0 ) {
+        mIndex = mPreparedIndex;
+        mPreparedIndex = -1;
+        emit showCity(mIndex);
+    }
+    reschedule();
+}
+
+void RefreshScheduler::jumpTo(int index)
+{
+    if ( index < 0 || index >= mCities->current()->size() ) {
+        return;
+    }
+    mIndex = index;
+    mPreparedIndex = -1;
+    mNextRotateMs = mClock.elapsed() + mDwell;
+    emit showCity(mIndex);
+    reschedule();
+}
+
+void RefreshScheduler::track(const QStringList& codes)
+{
+    for ( const QString& code : codes ) {
+        if ( !mEntries.contains(code) ) {
+            mEntries.insert(code, Entry());
+        }
+    }
+    wake();
+}
+
+void RefreshScheduler::refetch(const QString& code)
+{
+    // one in flight already brings the newest data
+    Entry& entry = mEntries[code];
+    if ( !entry.inFlight ) {
+        entry.dueMs = mClock.elapsed();
+    }
+    wake();
+}
+
+void RefreshScheduler::markFetched(const QString& code, const QString& city)
+{
+    auto it = mEntries.find(code);
+    if ( it == mEntries.end() ) {
+        return;  // not tracked, e.g. loaded from a file
+    }
+    it->city = city;
+    it->inFlight = false;
+    it->dueMs = mClock.elapsed() + qint64(mRefreshInterval) * 1000;
+    reschedule();
+}
+
+void RefreshScheduler::markFailed(const QString& code)
+{
+    auto it = mEntries.find(code);
+    if ( it == mEntries.end() ) {
+        return;
+    }
+    it->inFlight = false;
+    it->dueMs = mClock.elapsed() + qint64(qMin(mRetryInterval, mRefreshInterval)) * 1000;
+    reschedule();
+}
+
+void RefreshScheduler::markCancelled()
+{
+    qint64 now = mClock.elapsed();
+    for ( Entry& entry : mEntries ) {
+        if ( entry.inFlight ) {
+            entry.inFlight = false;
+            entry.dueMs = now;
+        }
+    }
+    reschedule();
+}
+
+void RefreshScheduler::wake()
+{
+    qint64 now = mClock.elapsed();
+    if ( mActive ) {
+        rotate(now);
+        refresh(now);
+        prepare(now);
+    }
+    reschedule();
+}
+
+int RefreshScheduler::nextIndex() const
+{
+    // the store only grows, but a new snapshot may have arrived since the last turn
+    int count = mCities->current()->size();
+    return count > 0 ? (mIndex + 1) % count : 0;
+}
+
+void RefreshScheduler::prepare(qint64 now)
+{
+    if ( mPreparedIndex >= 0 || mPrepareLead == 0 || now < mNextRotateMs - mPrepareLead ) {
+        return;
+    }
+
+    int next = nextIndex();
+    if ( next != mIndex ) {
+        mPreparedIndex = next;
+        emit prepareCity(next);
+    }
+}
+
+void RefreshScheduler::rotate(qint64 now)
+{
+    if ( now < mNextRotateMs ) {
+        return;
+    }
+    mNextRotateMs = now + mDwell;
+    mPreparedIndex = -1;
+
+    int next = nextIndex();
+    if ( next == mIndex ) {
+        return;  // one city (or none), nothing to rotate to
+    }
+    mIndex = next;
+    emit showCity(mIndex);
+}
+
+void RefreshScheduler::refresh(qint64 now)
+{
+    // 1. Visible City
+    QString visible;
+    CityStorePtr cities = mCities->current();
+    if ( mIndex < cities->size() ) {
+        visible = cities->view(mIndex).city();
+    }
+
+    // 2. Due Codes, visible first, then the longest overdue
+    struct Due {
+        QString code;
+        bool visible;
+        qint64 dueMs;
+    };
+    QVector<Due> due;
+    for ( auto it = mEntries.begin(); it != mEntries.end(); ++it ) {
+        if ( it->inFlight || it->dueMs > now ) {
+            continue;
+        }
+        due.append({it.key(), !visible.isEmpty() && it->city == visible, it->dueMs});
+    }
+    if ( due.isEmpty() ) {
+        return;
+    }
+    std::sort(due.begin(), due.end(), [](const Due& a, const Due& b) {
+        if ( a.visible != b.visible ) {
+            return a.visible;
+        }
+        return a.dueMs < b.dueMs;
+    });
+
+    QStringList codes;
+    for ( const Due& d : due ) {
+        mEntries[d.code].inFlight = true;
+        codes.append(d.code);
+    }
+    emit refreshDue(codes);
+}
+
+void RefreshScheduler::reschedule()
+{
+    if ( !mActive ) {
+        // nothing rotates or refreshes while nobody can see it
+        mTimer.stop();
+        return;
+    }
+
+    qint64 next = mNextRotateMs;
+    if ( mPreparedIndex < 0 && mPrepareLead > 0 ) {
+        next -= mPrepareLead;
+    }
+    for ( const Entry& entry : mEntries ) {
+        if ( !entry.inFlight ) {
+            next = qMin(next, entry.dueMs);
+        }
+    }
+
+    qint64 wait = qMax(qint64(0), next - mClock.elapsed());
+    mTimer.start(int(qMin(wait, qint64(INT_MAX))));
+}
@@ -0,0 +1,95 @@
+#ifndef REFRESHSCHEDULER_H
+#define REFRESHSCHEDULER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
+#include <QTimer>
+
+class CityPublisher;
+
+// Decides when the display rotates to the next city and when cities are
+// fetched again. Everything runs off one coarse single-shot timer that is
+// armed for the nearest deadline only, so an idle (or hidden) window does
+// not wake up at all.
+// - rotation: every dwell() ms over the cities that are actually published,
+//   paused while the window is inactive (hidden or minimized). prepareLead()
+//   ms before a turn prepareCity() names the next city, so it can be
+//   rendered ahead of time
+// - refresh: every tracked city code is fetched again refreshInterval()
+//   after its last result, the visible city first, then the stalest;
+//   inactive windows only refresh when they come back
+class RefreshScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RefreshScheduler(const CityPublisher* cities, QObject* parent = nullptr);
+
+    void setDwell(int ms);
+    int dwell() const { return mDwell; }
+
+    void setPrepareLead(int ms);
+    int prepareLead() const { return mPrepareLead; }
+
+    void setRefreshInterval(int seconds);
+    int refreshInterval() const { return mRefreshInterval; }
+
+    void setRetryInterval(int seconds) { mRetryInterval = seconds; }
+    int retryInterval() const { return mRetryInterval; }
+
+    void setActive(bool active);
+    bool isActive() const { return mActive; }
+
+    // index into the published store, always valid while it is not empty
+    int currentIndex() const { return mIndex; }
+    // shows index out of turn (a search, the location), drops the prepared
+    // turn and gives it a full dwell
+    void jumpTo(int index);
+
+    // city codes to keep fresh, new ones are due right away
+    void track(const QStringList& codes);
+    // due right away, tracked from now on if it is not yet
+    void refetch(const QString& code);
+    void markFetched(const QString& code, const QString& city);
+    void markFailed(const QString& code);
+    // the client dropped every fetch, whatever was in flight is due again
+    void markCancelled();
+
+signals:
+    void prepareCity(int index);  // followed by showCity(index) unless the store changed meanwhile
+    void showCity(int index);
+    void refreshDue(const QStringList& codes);  // in priority order
+
+private:
+    struct Entry {
+        QString city;       // known after the first result
+        qint64 dueMs = 0;   // next fetch, mClock time
+        bool inFlight = false;
+    };
+
+    void wake();
+    int nextIndex() const;
+    void prepare(qint64 now);
+    void rotate(qint64 now);
+    void refresh(qint64 now);
+    void reschedule();
+
+    const CityPublisher* mCities;
+    QElapsedTimer mClock;
+    QTimer mTimer;
+
+    bool mActive;
+    int mDwell;            // ms
+    int mPrepareLead;      // ms
+    int mRefreshInterval;  // s
+    int mRetryInterval;    // s
+
+    int mIndex;
+    int mPreparedIndex;    // -1 when nothing is prepared for the next turn
+    qint64 mNextRotateMs;
+    QHash<QString, Entry> mEntries;  // city code -> state
+};
+
+#endif // REFRESHSCHEDULER_H
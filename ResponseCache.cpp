@@ -0,0 +1,359 @@
+#include "ResponseCache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QVector>
+#include <algorithm>
+
+static const quint32 CACHE_MAGIC = 0x57524331;  // "WRC1"
+static const quint32 CACHE_VERSION = 1;
+
+struct ResponseCache::Disk {
+    QString directory;
+    QMutex lock;
+
+    // 1. Pool -> cache, taken by adopt()
+    bool indexed = false;
+    QHash<QString, Entry> index;
+    QHash<QString, CachedResponse> read;  // an invalid fetched time: the file could not be read
+
+    // 2. Cache -> pool, one writer at a time, a null array removes the file
+    QHash<QString, QByteArray> writes;
+    bool writing = false;
+};
+
+ResponseCache::ResponseCache(const QString& directory)
+    : mDisk(std::make_shared<Disk>()), mTtl(600), mMaxBytes(64 * 1024 * 1024), mMaxMemoryBytes(8 * 1024 * 1024)
+{
+    mDisk->directory = directory;
+    if ( mDisk->directory.isEmpty() ) {
+        mDisk->directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/responses";
+    }
+}
+
+void ResponseCache::setPool(QThreadPool* pool)
+{
+    mPool = pool;
+    if ( !mIndexStarted ) {
+        loadIndex();
+    }
+}
+
+void ResponseCache::setMaxBytes(qint64 bytes)
+{
+    mMaxBytes = bytes;
+    evict();
+}
+
+void ResponseCache::setMaxMemoryBytes(qint64 bytes)
+{
+    mMaxMemoryBytes = bytes;
+    evict();
+}
+
+ResponseCache::Freshness ResponseCache::lookup(const QString& key, CachedResponse* response)
+{
+    adopt();
+    QString file = fileName(key);
+    auto it = mEntries.find(file);
+    if ( it == mEntries.end() ) {
+        mStats.misses++;
+        return Missing;
+    }
+
+    // only on disk, read for the next lookup
+    auto hot = mHot.constFind(file);
+    if ( hot == mHot.constEnd() ) {
+        readLater(file);
+        mStats.misses++;
+        return Missing;
+    }
+
+    *response = hot.value();
+    it->lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+    if ( response->fetched.secsTo(QDateTime::currentDateTimeUtc()) < mTtl ) {
+        mStats.hits++;
+        return Fresh;
+    }
+
+    mStats.stale++;
+    return Stale;
+}
+
+void ResponseCache::store(const QString& key, const CachedResponse& response)
+{
+    adopt();
+    QString file = fileName(key);
+    QByteArray bytes = encode(key, response);
+
+    Entry& entry = mEntries[file];
+    mStats.bytes += bytes.size() - entry.size;
+    entry.size = bytes.size();
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+    keep(file, response);
+    writeLater(file, bytes);
+
+    evict();
+}
+
+bool ResponseCache::revalidated(const QString& key, CachedResponse* response)
+{
+    adopt();
+    QString file = fileName(key);
+    auto hot = mHot.constFind(file);
+    if ( !mEntries.contains(file) || hot == mHot.constEnd() ) {
+        return false;
+    }
+
+    // body unchanged, it is fresh again from now on
+    mStats.revalidations++;
+    *response = hot.value();
+    response->fetched = QDateTime::currentDateTimeUtc();
+    store(key, *response);
+    return true;
+}
+
+void ResponseCache::clear()
+{
+    adopt();
+    for ( auto it = mEntries.constBegin(); it != mEntries.constEnd(); ++it ) {
+        writeLater(it.key(), QByteArray());
+    }
+    mEntries.clear();
+    mHot.clear();
+    mStats.bytes = 0;
+    mStats.memoryBytes = 0;
+}
+
+QString ResponseCache::fileName(const QString& key) const
+{
+    return QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()) + ".bin";
+}
+
+bool ResponseCache::read(const QString& path, CachedResponse* response)
+{
+    QFile in(path);
+    if ( !in.open(QIODevice::ReadOnly) ) {
+        return false;
+    }
+
+    QDataStream stream(&in);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString key;
+    stream >> magic >> version;
+    if ( magic != CACHE_MAGIC || version != CACHE_VERSION ) {
+        return false;
+    }
+
+    stream >> key >> response->etag >> response->lastModified >> response->fetched >> response->body;
+    return stream.status() == QDataStream::Ok && response->fetched.isValid();
+}
+
+QByteArray ResponseCache::encode(const QString& key, const CachedResponse& response)
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream << CACHE_MAGIC << CACHE_VERSION;
+    stream << key << response.etag << response.lastModified << response.fetched << response.body;
+    return bytes;
+}
+
+void ResponseCache::flush(const std::shared_ptr<Disk>& disk)
+{
+    for ( ;; ) {
+        QString file;
+        QByteArray bytes;
+        {
+            QMutexLocker locker(&disk->lock);
+            if ( disk->writes.isEmpty() ) {
+                disk->writing = false;
+                return;
+            }
+            auto it = disk->writes.begin();
+            file = it.key();
+            bytes = it.value();
+            disk->writes.erase(it);
+        }
+
+        QString path = disk->directory + "/" + file;
+        if ( bytes.isNull() ) {
+            QFile::remove(path);
+            continue;
+        }
+
+        // write to a temporary file and rename, a crash never leaves half an entry
+        QSaveFile out(path);
+        if ( out.open(QIODevice::WriteOnly) ) {
+            out.write(bytes);
+            out.commit();
+        }
+    }
+}
+
+void ResponseCache::run(const std::function<void()>& task)
+{
+    if ( mPool ) {
+        mPool->start(task);
+    } else {
+        task();
+    }
+}
+
+void ResponseCache::loadIndex()
+{
+    mIndexStarted = true;
+    std::shared_ptr<Disk> disk = mDisk;
+    qint64 budget = mMaxMemoryBytes;
+    run([disk, budget]() {
+        QDir().mkpath(disk->directory);
+
+        // LRU index from what is on disk, seeded with the last write time.
+        // The newest bodies are read right away, as many as memory takes
+        QHash<QString, Entry> index;
+        QHash<QString, CachedResponse> read;
+        qint64 bytes = 0;
+        const QFileInfoList files = QDir(disk->directory).entryInfoList(QStringList() << "*.bin", QDir::Files, QDir::Time);
+        for ( const QFileInfo& info : files ) {
+            Entry entry;
+            entry.size = info.size();
+            entry.lastUsed = info.lastModified().toMSecsSinceEpoch();
+            index.insert(info.fileName(), entry);
+
+            CachedResponse response;
+            if ( bytes + entry.size <= budget && ResponseCache::read(info.filePath(), &response) ) {
+                read.insert(info.fileName(), response);
+                bytes += entry.size;
+            }
+        }
+
+        QMutexLocker locker(&disk->lock);
+        disk->index = index;
+        disk->indexed = true;
+        for ( auto it = read.constBegin(); it != read.constEnd(); ++it ) {
+            disk->read.insert(it.key(), it.value());
+        }
+    });
+}
+
+void ResponseCache::adopt()
+{
+    if ( !mIndexStarted ) {
+        loadIndex();
+    }
+
+    QHash<QString, Entry> index;
+    QHash<QString, CachedResponse> read;
+    {
+        QMutexLocker locker(&mDisk->lock);
+        if ( mDisk->indexed && !mIndexed ) {
+            index.swap(mDisk->index);
+            mIndexed = true;
+        }
+        read.swap(mDisk->read);
+    }
+
+    // 1. Index, entries stored meanwhile are newer than their files were
+    for ( auto it = index.constBegin(); it != index.constEnd(); ++it ) {
+        if ( !mEntries.contains(it.key()) ) {
+            mEntries.insert(it.key(), it.value());
+            mStats.bytes += it->size;
+        }
+    }
+
+    // 2. Bodies read, unless a newer one was stored or the entry evicted meanwhile
+    for ( auto it = read.constBegin(); it != read.constEnd(); ++it ) {
+        mReading.remove(it.key());
+        if ( !mEntries.contains(it.key()) || mHot.contains(it.key()) ) {
+            continue;
+        }
+        if ( !it->fetched.isValid() ) {
+            mStats.bytes -= mEntries.take(it.key()).size;  // unreadable, fetched again
+            continue;
+        }
+        keep(it.key(), it.value());
+    }
+
+    if ( !index.isEmpty() ) {
+        evict();
+    }
+}
+
+void ResponseCache::readLater(const QString& file)
+{
+    if ( mReading.contains(file) ) {
+        return;
+    }
+    mReading.insert(file);
+
+    std::shared_ptr<Disk> disk = mDisk;
+    run([disk, file]() {
+        CachedResponse response;
+        if ( !read(disk->directory + "/" + file, &response) ) {
+            response = CachedResponse();
+        }
+        QMutexLocker locker(&disk->lock);
+        disk->read.insert(file, response);
+    });
+}
+
+void ResponseCache::writeLater(const QString& file, const QByteArray& bytes)
+{
+    // the writer that is running takes it, replacing an older write of the file still waiting
+    {
+        QMutexLocker locker(&mDisk->lock);
+        mDisk->writes.insert(file, bytes);
+        if ( mDisk->writing ) {
+            return;
+        }
+        mDisk->writing = true;
+    }
+    std::shared_ptr<Disk> disk = mDisk;
+    run([disk]() { flush(disk); });
+}
+
+void ResponseCache::keep(const QString& file, const CachedResponse& response)
+{
+    auto it = mHot.find(file);
+    if ( it != mHot.end() ) {
+        mStats.memoryBytes -= it->body.size();
+    }
+    mHot.insert(file, response);
+    mStats.memoryBytes += response.body.size();
+}
+
+void ResponseCache::evict()
+{
+    if ( mStats.bytes <= mMaxBytes && mStats.memoryBytes <= mMaxMemoryBytes ) {
+        return;
+    }
+
+    // oldest use first
+    QVector<QPair<qint64, QString>> byAge;
+    byAge.reserve(mEntries.size());
+    for ( auto it = mEntries.constBegin(); it != mEntries.constEnd(); ++it ) {
+        byAge.append(qMakePair(it->lastUsed, it.key()));
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    // 1. Disk, the files go
+    int i = 0;
+    for ( ; i < byAge.size() && mStats.bytes > mMaxBytes; i++ ) {
+        const QString& file = byAge[i].second;
+        writeLater(file, QByteArray());
+        mStats.bytes -= mEntries.take(file).size;
+        mStats.memoryBytes -= mHot.take(file).body.size();
+        mStats.evictions++;
+    }
+
+    // 2. Memory, the files stay and are read again when they are looked up
+    for ( ; i < byAge.size() && mStats.memoryBytes > mMaxMemoryBytes; i++ ) {
+        mStats.memoryBytes -= mHot.take(byAge[i].second).body.size();
+    }
+}
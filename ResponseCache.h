@@ -0,0 +1,104 @@
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <functional>
+#include <memory>
+
+class QThreadPool;
+
+struct CachedResponse {
+    QByteArray body;
+    QByteArray etag;
+    QByteArray lastModified;
+    QDateTime fetched;  // last time the server sent or confirmed this body
+};
+
+struct ResponseCacheStats {
+    quint64 hits = 0;           // fresh, served without network
+    quint64 misses = 0;         // nothing cached, or only on disk
+    quint64 stale = 0;          // cached but expired, sent as conditional request
+    quint64 revalidations = 0;  // 304 answers that reused the cached body
+    quint64 evictions = 0;
+    qint64 bytes = 0;           // on disk
+    qint64 memoryBytes = 0;     // bodies kept in memory
+};
+
+// Persistent cache of raw responses, one file per key (city + endpoint).
+// Entries younger than ttl() are fresh. Older entries still keep their
+// ETag/Last-Modified so the request can be made conditional. The
+// directory is capped at maxBytes(), the least recently used entries go
+// first.
+// Lookups never wait for the disk: the index and the most recently used
+// bodies (up to maxMemoryBytes()) are kept in memory, and files are read
+// and written on the pool given to setPool(). The index is read there when
+// the pool is set; until it arrives, and for bodies that had to leave
+// memory, a lookup is a miss and the file is read for the next one.
+class ResponseCache
+{
+public:
+    enum Freshness {
+        Missing,
+        Fresh,
+        Stale
+    };
+
+    // empty directory: <cache location>/responses
+    explicit ResponseCache(const QString& directory = QString());
+
+    // not owned, file I/O runs on the calling thread without one
+    void setPool(QThreadPool* pool);
+
+    void setTtl(int seconds) { mTtl = seconds; }
+    int ttl() const { return mTtl; }
+    void setMaxBytes(qint64 bytes);
+    qint64 maxBytes() const { return mMaxBytes; }
+    void setMaxMemoryBytes(qint64 bytes);
+    qint64 maxMemoryBytes() const { return mMaxMemoryBytes; }
+
+    Freshness lookup(const QString& key, CachedResponse* response);
+    void store(const QString& key, const CachedResponse& response);
+    bool revalidated(const QString& key, CachedResponse* response);  // server answered 304
+    void clear();
+
+    ResponseCacheStats stats() const { return mStats; }
+
+private:
+    struct Entry {
+        qint64 size = 0;
+        qint64 lastUsed = 0;  // msecs since epoch
+    };
+    struct Disk;  // shared with the pool tasks, which never touch the cache itself
+
+    QString fileName(const QString& key) const;
+    static bool read(const QString& path, CachedResponse* response);
+    static QByteArray encode(const QString& key, const CachedResponse& response);
+    static void flush(const std::shared_ptr<Disk>& disk);
+
+    void run(const std::function<void()>& task);
+    void loadIndex();
+    void adopt();
+    void readLater(const QString& file);
+    void writeLater(const QString& file, const QByteArray& bytes);
+    void keep(const QString& file, const CachedResponse& response);
+    void evict();
+
+    std::shared_ptr<Disk> mDisk;
+    QThreadPool* mPool = nullptr;
+    int mTtl;
+    qint64 mMaxBytes;
+    qint64 mMaxMemoryBytes;
+
+    bool mIndexStarted = false;
+    bool mIndexed = false;
+    QHash<QString, Entry> mEntries;          // file name -> size and last use
+    QHash<QString, CachedResponse> mHot;     // file name -> response, the bodies in memory
+    QSet<QString> mReading;                  // files being read by the pool
+    ResponseCacheStats mStats;
+};
+
+#endif // RESPONSECACHE_H
@@ -0,0 +1,137 @@
+#ifndef SERIESRENDERER_H
+#define SERIESRENDERER_H
+
+#include <QColor>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+
+template <typename T>
+struct SeriesStats {
+    T min = T();
+    T max = T();
+};
+
+// min/max in one pass. The loop has no branches or early exits so the
+// compiler can vectorize it.
+template <typename T>
+SeriesStats<T> seriesStats(const T* values, int count)
+{
+    SeriesStats<T> stats;
+    if ( count <= 0 ) {
+        return stats;
+    }
+
+    T lo = values[0];
+    T hi = values[0];
+    for ( int i = 0; i < count; i++ ) {
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+
+    stats.min = lo;
+    stats.max = hi;
+    return stats;
+}
+
+template <typename T>
+struct Series {
+    const T* values = nullptr;
+    int count = 0;
+    QColor color;
+    bool dashFirst = true;        // first segment is yesterday, drawn dotted
+    QString suffix = "°";
+};
+
+// Draws any number of series with any number of points into one rect.
+// All series share the y axis, which is scaled so that min/max (plus the
+// value text) fill the rect height. The x positions can be given (e.g. the
+// centers of the day columns), otherwise points are spread evenly.
+template <typename T>
+class SeriesRenderer
+{
+public:
+    static constexpr int POINT_RADIUS = 3;    // size of dot on graph
+    static constexpr int TEXT_OFFSET_X = 12;  // text movement around dot on x-axis
+    static constexpr int TEXT_OFFSET_Y = 10;  // text movement around dot on y-axis
+
+    void addSeries(const Series<T>& series) { mSeries.append(series); }
+    void setPointX(const QVector<int>& pointX) { mPointX = pointX; }
+
+    void render(QPainter& painter, const QRect& rect) const
+    {
+        if ( mSeries.isEmpty() ) {
+            return;
+        }
+
+        painter.setRenderHint(QPainter::Antialiasing, true);
+
+        // 1. Shared y-axis Range
+        T lo = T();
+        T hi = T();
+        bool first = true;
+        for ( const Series<T>& series : mSeries ) {
+            if ( series.count <= 0 ) {
+                continue;
+            }
+            SeriesStats<T> stats = seriesStats(series.values, series.count);
+            lo = first ? stats.min : std::min(lo, stats.min);
+            hi = first ? stats.max : std::max(hi, stats.max);
+            first = false;
+        }
+
+        // text sits above the dot, keep room for it at the top
+        int textHeight = QFontMetrics(painter.font()).ascent() + TEXT_OFFSET_Y;
+        int top = rect.top() + textHeight;
+        int bottom = rect.bottom() - POINT_RADIUS;
+        double span = double(hi) - double(lo);
+        double scale = span > 0 ? (bottom - top) / span : 0.0;
+        int yCenter = (top + bottom) / 2;
+
+        // 2. Draw Each Series
+        for ( const Series<T>& series : mSeries ) {
+            QVector<QPoint> points(series.count);
+            for ( int i = 0; i < series.count; i++ ) {
+                int x = pointX(i, series.count, rect);
+                int y = span > 0 ? bottom - int((double(series.values[i]) - double(lo)) * scale) : yCenter;
+                points[i] = QPoint(x, y);
+            }
+
+            QPen pen = painter.pen();
+            pen.setWidth(1);
+            pen.setColor(series.color);
+            painter.setPen(pen);
+            painter.setBrush(series.color);
+
+            // 2.1 Draw dots and texts
+            for ( int i = 0; i < series.count; i++ ) {
+                painter.drawEllipse(points[i], POINT_RADIUS, POINT_RADIUS);
+                painter.drawText(points[i] - QPoint(TEXT_OFFSET_X, TEXT_OFFSET_Y), QString::number(series.values[i]) + series.suffix);
+            }
+
+            // 2.2 Draw Curve
+            for ( int i = 0; i + 1 < series.count; i++ ) {
+                pen.setStyle(i == 0 && series.dashFirst ? Qt::DotLine : Qt::SolidLine);
+                painter.setPen(pen);
+                painter.drawLine(points[i], points[i + 1]);
+            }
+        }
+    }
+
+private:
+    int pointX(int i, int count, const QRect& rect) const
+    {
+        if ( mPointX.size() == count ) {
+            return mPointX[i];
+        }
+        return rect.left() + int((i + 0.5) * rect.width() / count);
+    }
+
+    QVector<Series<T>> mSeries;
+    QVector<int> mPointX;
+};
+
+#endif // SERIESRENDERER_H
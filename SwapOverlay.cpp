@@ -0,0 +1,94 @@
+#include "SwapOverlay.h"
+#include <QPaintEvent>
+#include <QPainter>
+#include <QTimer>
+#include <QVariantAnimation>
+
+#include "WeatherLog.h"
+
+SwapOverlay::SwapOverlay(QWidget* parent)
+    : QWidget(parent), mFrontOpacity(1.0), mSwapping(false), mReportFrame(false)
+{
+    // covers everything it is shown over, so nothing underneath is repainted for it
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    hide();
+
+    mFade = new QVariantAnimation(this);
+    mFade->setStartValue(1.0);
+    mFade->setEndValue(0.0);
+    connect(mFade, &QVariantAnimation::valueChanged, this, [this](const QVariant& value) {
+        mFrontOpacity = value.toReal();
+        update();
+    });
+    connect(mFade, &QVariantAnimation::finished, this, &SwapOverlay::finish);
+}
+
+void SwapOverlay::cover(const QPixmap& front)
+{
+    mFade->stop();
+    mSwapping = false;
+    mFront = front;
+    mNext = QPixmap();
+    mFrontOpacity = 1.0;
+
+    setGeometry(parentWidget()->rect());
+    raise();
+    show();
+    update();
+}
+
+void SwapOverlay::setNext(const QPixmap& next)
+{
+    mNext = next;
+}
+
+void SwapOverlay::swap(int fadeMs)
+{
+    if ( !isVisible() || mNext.isNull() ) {
+        finish();
+        return;
+    }
+
+    mSwapping = true;
+    mSwapClock.start();
+    mReportFrame = true;
+
+    if ( fadeMs > 0 ) {
+        mFade->setDuration(fadeMs);
+        mFade->start();
+    } else {
+        mFrontOpacity = 0.0;
+        update();
+        // the labels underneath already look like mNext, drop the cover after this frame
+        QTimer::singleShot(0, this, &SwapOverlay::finish);
+    }
+}
+
+void SwapOverlay::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    painter.setClipRegion(event->region());
+
+    // 1. Back Buffer (once swapping), 2. Front Buffer fading out on top
+    if ( mSwapping ) {
+        painter.drawPixmap(0, 0, mNext);
+    }
+    if ( mFrontOpacity > 0.0 && !mFront.isNull() ) {
+        painter.setOpacity(mFrontOpacity);
+        painter.drawPixmap(0, 0, mFront);
+    }
+
+    if ( mReportFrame ) {
+        mReportFrame = false;
+        qCDebug(lcWeatherPerf) << "SwapOverlay: switch frame painted" << mSwapClock.nsecsElapsed() / 1000 << "us after the swap";
+    }
+}
+
+void SwapOverlay::finish()
+{
+    mSwapping = false;
+    hide();
+    mFront = QPixmap();
+    mNext = QPixmap();
+}
@@ -0,0 +1,44 @@
+#ifndef SWAPOVERLAY_H
+#define SWAPOVERLAY_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QPixmap>
+
+class QVariantAnimation;
+
+// Front/back buffer over the whole parent for the city rotation.
+// cover() freezes what is on screen, so the parent can switch its labels
+// to the next city underneath and render that into the back buffer ahead
+// of time. swap() then only blits the back buffer (optionally cross-fading
+// from the front), the labels themselves repaint later, under the overlay.
+class SwapOverlay : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SwapOverlay(QWidget* parent);
+
+    void cover(const QPixmap& front);
+    void setNext(const QPixmap& next);
+    void swap(int fadeMs);
+
+    bool isCovering() const { return isVisible() && !mSwapping; }
+
+protected:
+    void paintEvent(QPaintEvent* event);
+
+private:
+    void finish();
+
+    QPixmap mFront;
+    QPixmap mNext;
+    qreal mFrontOpacity;
+    bool mSwapping;
+
+    QVariantAnimation* mFade;
+    QElapsedTimer mSwapClock;  // swap() -> first frame painted
+    bool mReportFrame;
+};
+
+#endif // SWAPOVERLAY_H
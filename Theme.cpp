@@ -0,0 +1,112 @@
+#include "Theme.h"
+
+Theme& Theme::instance()
+{
+    static Theme theme;
+    return theme;
+}
+
+Theme::Theme()
+{
+    mStyleSheet = R"(
+        QWidget#weather_widget {
+            background-color: rgba(50, 115,165, 255);
+        }
+
+        QLabel {
+            font: 12pt "Microsoft YaHei";
+            border-radius: 4px;
+            color: rgb(255,255,255);
+            padding: 12px;
+        }
+
+        /* top */
+        QLineEdit#leCity {
+            font: 14pt Microsoft YaHei;
+            background-color: rgb(255,255,255);
+            border-radius: 4px;
+            padding: 4px 8px;
+        }
+        QPushButton#btnSearch {
+            background-color: rgba(255,255,255, 0);
+        }
+        QLabel#lblDate {
+            font: 20pt Arial;
+            background-color: rgba(255,255,255, 0);
+        }
+
+        /* left */
+        QLabel[role="icon"] {
+            background-color: rgba(255,255,255,0);
+        }
+        QLabel#lblTemp {
+            font: 50pt Arial;
+            background-color: rgba(255,255,255,0);
+            padding: 0px;
+        }
+        QLabel[role="headline"] {
+            font: 12pt Microsoft YaHei;
+            background-color: rgba(255,255,255,0);
+            padding: 0px 0px 24px 0px;
+        }
+        QLabel#lblGanMao {
+            font: 12pt Microsoft YaHei;
+            background-color: rgba(255,255,255,0);
+            padding-left: 5px;
+            padding-right: 5px;
+        }
+        QWidget#infoPanel {
+            background-color: rgb(157,133,255);
+            border-radius: 15px;
+        }
+        QLabel[role="infoTitle"] {
+            font: 10pt Microsoft YaHei;
+            background-color: rgba(255,255,255,0);
+            padding: 24px 0px 0px 0px;
+        }
+        QLabel[role="infoValue"] {
+            font: bold 12pt Microsoft YaHei;
+            background-color: rgba(255,255,255,0);
+            padding: 0px 0px 24px 0px;
+        }
+
+        /* right */
+        ForecastStrip {
+            font: 12pt "Microsoft YaHei";
+            qproperty-weekColor: rgb(10, 180,190);
+            qproperty-cellColor: rgb(54, 93,122);
+            qproperty-textColor: rgb(255,255,255);
+            qproperty-highColor: rgb(255, 170, 0);
+            qproperty-lowColor: rgb(0, 255, 255);
+        }
+    )";
+}
+
+int Theme::aqiBand(quint16 aqi)
+{
+    static const quint16 upper[] = {50, 100, 150, 200, 300};
+    int band = 0;
+    while ( band < 5 && aqi > upper[band] ) {
+        band++;
+    }
+    return band;
+}
+
+QString Theme::aqiText(int band)
+{
+    static const char* const text[] = {"Good", "Fair", "Light Pollution", "Medium Pollution", "Heavy Pollution", "Severe Pollution"};
+    return text[band];
+}
+
+QColor Theme::aqiColor(int band)
+{
+    static const QColor colors[] = {
+        QColor(121, 184, 0),
+        QColor(255, 187, 23),
+        QColor(255, 87, 97),
+        QColor(235, 17, 27),
+        QColor(170, 0, 0),
+        QColor(110, 0, 0),
+    };
+    return colors[band];
+}
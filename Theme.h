@@ -0,0 +1,31 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include <QColor>
+#include <QString>
+
+// The whole look of the widget in one style sheet.
+// The sheet is built once and set on the top level widget, the labels only
+// pick their rule by object name or by the "role" property, the forecast
+// strip gets its colors through qproperty- rules. Nothing is re-parsed or
+// re-polished while the widget runs.
+class Theme
+{
+public:
+    static Theme& instance();
+
+    const QString& styleSheet() const { return mStyleSheet; }
+
+    // AQI bands: 0 Good, 1 Fair, 2 Light, 3 Medium, 4 Heavy, 5 Severe Pollution
+    static int aqiBand(quint16 aqi);
+    static int aqiBandCount() { return 6; }
+    static QString aqiText(int band);
+    static QColor aqiColor(int band);
+
+private:
+    Theme();
+
+    QString mStyleSheet;
+};
+
+#endif // THEME_H
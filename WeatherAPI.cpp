@@ -0,0 +1,318 @@
+#include "WeatherAPI.h"
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <algorithm>
+
+#include "CityJsonReader.h"
+#include "CityUpdateQueue.h"
+#include "ResponseCache.h"
+#include "WeatherLog.h"
+
+static const int LATENCY_SAMPLES = 4096;
+
+WeatherAPI::WeatherAPI(QObject* parent)
+    : QObject(parent), mBaseUrl("http://t.weather.sojson.com/api/weather/city/"), mMaxConcurrent(6)
+{
+    mClock.start();
+    mLatencies.reserve(LATENCY_SAMPLES);
+}
+
+WeatherAPI::~WeatherAPI()
+{
+    // parse workers use this object and the update queue, cancelAll() lets
+    // those waiting for room in the queue give up, nobody drains it meanwhile
+    cancelAll();
+    mParsePool.waitForDone();
+}
+
+void WeatherAPI::setBaseUrl(const QUrl& url)
+{
+    mBaseUrl = url;
+}
+
+void WeatherAPI::setMaxConcurrent(int count)
+{
+    mMaxConcurrent = qMax(1, count);
+    startNext();
+}
+
+void WeatherAPI::fetch(const QString& cityCode)
+{
+    mQueue.enqueue(cityCode);
+    startNext();
+}
+
+void WeatherAPI::fetch(const QStringList& cityCodes)
+{
+    for ( const QString& code : cityCodes ) {
+        mQueue.enqueue(code);
+    }
+    startNext();
+}
+
+void WeatherAPI::cancelAll()
+{
+    mQueue.clear();
+    mUnconditional.clear();
+    mCachedPending = 0;
+    mGeneration++;
+
+    // abort() emits finished, take the replies out first so onFinished ignores them
+    QList<QNetworkReply*> replies = mInFlight.keys();
+    mInFlight.clear();
+    mStarted.clear();
+    for ( QNetworkReply* reply : replies ) {
+        reply->abort();
+        reply->deleteLater();
+    }
+    emit cancelled();
+}
+
+WeatherAPIStats WeatherAPI::stats() const
+{
+    WeatherAPIStats stats;
+    stats.requests = mRequests;
+    stats.failures = mFailures;
+
+    qint64 elapsedUs = mLastFinishUs - mFirstStartUs;
+    if ( mFirstStartUs >= 0 && elapsedUs > 0 ) {
+        stats.requestsPerSecond = mRequests * 1e6 / elapsedUs;
+    }
+
+    if ( !mLatencies.isEmpty() ) {
+        QVector<qint64> sorted = mLatencies;
+        std::sort(sorted.begin(), sorted.end());
+        stats.p50Us = sorted[sorted.size() / 2];
+        stats.p99Us = sorted[qMin(sorted.size() - 1, sorted.size() * 99 / 100)];
+    }
+    return stats;
+}
+
+QNetworkAccessManager* WeatherAPI::networkManager()
+{
+    // one manager per application, it owns the connection pool
+    static QNetworkAccessManager* manager = nullptr;
+    if ( !manager ) {
+        manager = new QNetworkAccessManager(QCoreApplication::instance());
+    }
+    return manager;
+}
+
+void WeatherAPI::startNext()
+{
+    while ( !mQueue.isEmpty() && mInFlight.size() < mMaxConcurrent ) {
+        QString code = mQueue.dequeue();
+        QUrl url = mBaseUrl.resolved(QUrl(code));
+        QString key = url.toString();
+
+        QNetworkRequest request(url);
+        // stay on pooled HTTP/1.1 keep-alive connections
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+
+        // 1. Fresh in the cache: no round trip, stale: ask the server if it changed
+        bool unconditional = mUnconditional.remove(code);
+        if ( mCache ) {
+            CachedResponse cached;
+            ResponseCache::Freshness freshness = mCache->lookup(key, &cached);
+            if ( freshness == ResponseCache::Fresh ) {
+                deliverCached(code, key, cached.body);
+                continue;
+            }
+            if ( freshness == ResponseCache::Stale && !unconditional ) {
+                if ( !cached.etag.isEmpty() ) {
+                    request.setRawHeader("If-None-Match", cached.etag);
+                }
+                if ( !cached.lastModified.isEmpty() ) {
+                    request.setRawHeader("If-Modified-Since", cached.lastModified);
+                }
+            }
+        }
+
+        // 2. Network
+        qint64 now = mClock.nsecsElapsed() / 1000;
+        if ( mFirstStartUs < 0 ) {
+            mFirstStartUs = now;
+        }
+
+        QNetworkReply* reply = networkManager()->get(request);
+        mInFlight.insert(reply, code);
+        mStarted.insert(reply, now);
+        connect(reply, &QNetworkReply::finished, this, [=]() { onFinished(reply); });
+    }
+}
+
+void WeatherAPI::onFinished(QNetworkReply* reply)
+{
+    reply->deleteLater();
+    if ( !mInFlight.contains(reply) ) {
+        return;  // cancelled
+    }
+
+    QString code = mInFlight.take(reply);
+    QString key = reply->request().url().toString();
+    qint64 now = mClock.nsecsElapsed() / 1000;
+    recordLatency(now - mStarted.take(reply));
+    mLastFinishUs = now;
+    mRequests++;
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    bool conditional = reply->request().hasRawHeader("If-None-Match") || reply->request().hasRawHeader("If-Modified-Since");
+    CachedResponse cached;
+
+    if ( status == 304 && mCache && mCache->revalidated(key, &cached) ) {
+        // 1. Not Modified: same body, same parse
+        deliver(code, key, cached.body, true);
+    } else if ( status == 304 && conditional ) {
+        // 2. Not Modified, but the entry was evicted meanwhile: asked again without validators, ahead of the queue
+        mUnconditional.insert(code);
+        mQueue.prepend(code);
+    } else if ( reply->error() != QNetworkReply::NoError || status == 304 ) {
+        // 3. Transport Errors, and a 304 to a request that had nothing to revalidate
+        mFailures++;
+        emit weatherFailed(code, status == 304 ? QString("Not Modified, but nothing is cached") : reply->errorString());
+    } else {
+        // 4. New Body
+        cached.body = reply->readAll();
+        cached.etag = reply->rawHeader("ETag");
+        cached.lastModified = reply->rawHeader("Last-Modified");
+        cached.fetched = QDateTime::currentDateTimeUtc();
+        if ( mCache ) {
+            mCache->store(key, cached);
+        }
+        deliver(code, key, cached.body, false);
+    }
+
+    startNext();
+    checkIdle();
+}
+
+void WeatherAPI::deliverCached(const QString& code, const QString& key, const QByteArray& body)
+{
+    // keep fetch() asynchronous even when nothing goes over the network
+    mCachedPending++;
+    quint64 generation = mGeneration.load();
+    QMetaObject::invokeMethod(this, [=]() {
+        if ( generation != mGeneration.load() ) {
+            return;  // cancelled, no longer counted in mCachedPending
+        }
+        mCachedPending--;
+        deliver(code, key, body, true);
+        checkIdle();
+    }, Qt::QueuedConnection);
+}
+
+void WeatherAPI::deliver(const QString& code, const QString& key, const QByteArray& body, bool reuseParse)
+{
+    // 1. Same body as last time, same parse
+    if ( reuseParse ) {
+        QMutexLocker locker(&mParsedLock);
+        auto it = mParsed.constFind(key);
+        if ( it != mParsed.constEnd() ) {
+            WeatherInfo info = it.value();
+            locker.unlock();
+
+            if ( mUpdates ) {
+                // this thread must not wait for room, a full queue leaves it to a worker
+                if ( !mUpdates->tryPush(CityUpdate{code, info}) ) {
+                    parseInPool(code, key, body);
+                }
+            } else {
+                emit weatherReady(code, info);
+            }
+            return;
+        }
+    }
+
+    // 2. Parse on a worker, results arrive through the update queue
+    if ( mUpdates ) {
+        parseInPool(code, key, body);
+        return;
+    }
+
+    // 3. No queue, parse here
+    WeatherInfo info;
+    QString error;
+    if ( parseWeather(body, &info, &error) ) {
+        QMutexLocker locker(&mParsedLock);
+        mParsed.insert(key, info);
+        locker.unlock();
+        emit weatherReady(code, info);
+    } else {
+        mFailures++;
+        QMutexLocker locker(&mParsedLock);
+        mParsed.remove(key);
+        locker.unlock();
+        emit weatherFailed(code, error);
+    }
+}
+
+void WeatherAPI::parseInPool(const QString& code, const QString& key, const QByteArray& body)
+{
+    mParsing++;
+    quint64 generation = mGeneration.load();
+    mParsePool.start([=]() {
+        WeatherInfo info;
+        QString error;
+        bool ok = parseWeather(body, &info, &error);
+
+        {
+            QMutexLocker locker(&mParsedLock);
+            if ( ok ) {
+                mParsed.insert(key, info);
+            } else {
+                mParsed.remove(key);
+            }
+        }
+
+        if ( ok ) {
+            // dropped when cancelled while waiting for room
+            mUpdates->push(CityUpdate{code, info}, [this, generation]() { return mGeneration.load() != generation; });
+        } else {
+            // failures are rare, they can take the event loop
+            QMetaObject::invokeMethod(this, [=]() {
+                mFailures++;
+                emit weatherFailed(code, error);
+            }, Qt::QueuedConnection);
+        }
+
+        // the last parse of a burst may be what the client was waiting for
+        if ( --mParsing == 0 ) {
+            QMetaObject::invokeMethod(this, [this]() { checkIdle(); }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void WeatherAPI::checkIdle()
+{
+    if ( !mInFlight.isEmpty() || !mQueue.isEmpty() || mCachedPending > 0 || mParsing.load() > 0 ) {
+        return;
+    }
+
+    WeatherAPIStats s = stats();
+    qCDebug(lcWeatherPerf) << "WeatherAPI:" << s.requests << "requests," << s.failures << "failed,"
+                           << s.requestsPerSecond << "req/s, p50" << s.p50Us << "us, p99" << s.p99Us << "us";
+    if ( mCache ) {
+        ResponseCacheStats c = mCache->stats();
+        qCDebug(lcWeatherPerf) << "ResponseCache:" << c.hits << "hits," << c.misses << "misses," << c.stale << "stale,"
+                               << c.revalidations << "revalidated," << c.evictions << "evicted," << c.bytes << "bytes,"
+                               << c.memoryBytes << "in memory";
+    }
+    emit idle();
+}
+
+void WeatherAPI::recordLatency(qint64 us)
+{
+    if ( mLatencies.size() < LATENCY_SAMPLES ) {
+        mLatencies.append(us);
+    } else {
+        mLatencies[mLatencyPos] = us;
+        mLatencyPos = (mLatencyPos + 1) % LATENCY_SAMPLES;
+    }
+}
+
+bool WeatherAPI::parseWeather(const QByteArray& json, WeatherInfo* info, QString* error)
+{
+    return CityJsonReader::parseCity(json, info, error);
+}
@@ -1,4 +1,116 @@
 #ifndef WEATHERAPI_H
 #define WEATHERAPI_H
 
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVector>
+#include <atomic>
+
+#include "CityStore.h"
+
+class QNetworkAccessManager;
+class CityUpdateQueue;
+class ResponseCache;
+class QNetworkReply;
+
+struct WeatherAPIStats {
+    quint64 requests = 0;   // finished, successful or not
+    quint64 failures = 0;
+    double requestsPerSecond = 0;
+    qint64 p50Us = 0;       // latency percentiles over the recent requests
+    qint64 p99Us = 0;
+};
+
+// Client for the city weather endpoint (sojson format: cityInfo/data/forecast).
+// All clients share one QNetworkAccessManager, which keeps HTTP/1.1
+// keep-alive connections per host and asks for gzip (and inflates it)
+// by itself. The client queues requests and keeps at most maxConcurrent()
+// of them in flight. Results are delivered on the thread the client
+// lives in, normally the UI thread.
+// With a ResponseCache set, fresh entries are answered without a request
+// and stale ones are revalidated with If-None-Match/If-Modified-Since.
+// With a CityUpdateQueue set, bodies are parsed on worker threads and the
+// results go into the queue instead of weatherReady().
+class WeatherAPI : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WeatherAPI(QObject* parent = nullptr);
+    ~WeatherAPI();
+
+    // city code is appended to the base url, e.g. a local mock server for testing
+    void setBaseUrl(const QUrl& url);
+    QUrl baseUrl() const { return mBaseUrl; }
+
+    void setMaxConcurrent(int count);
+    int maxConcurrent() const { return mMaxConcurrent; }
+
+    // not owned, nullptr disables caching
+    void setCache(ResponseCache* cache) { mCache = cache; }
+    ResponseCache* cache() const { return mCache; }
+
+    // not owned, must outlive the client. nullptr parses on this thread and emits weatherReady()
+    void setUpdateQueue(CityUpdateQueue* queue) { mUpdates = queue; }
+    CityUpdateQueue* updateQueue() const { return mUpdates; }
+
+    void fetch(const QString& cityCode);
+    void fetch(const QStringList& cityCodes);
+    void cancelAll();
+
+    int pendingCount() const { return mQueue.size() + mInFlight.size() + mCachedPending + mParsing.load(); }
+    WeatherAPIStats stats() const;
+
+    static QNetworkAccessManager* networkManager();
+    static bool parseWeather(const QByteArray& json, WeatherInfo* info, QString* error = nullptr);
+
+signals:
+    void weatherReady(const QString& cityCode, const WeatherInfo& info);
+    void weatherFailed(const QString& cityCode, const QString& error);
+    void idle();  // queue drained, nothing in flight
+    void cancelled();  // cancelAll() dropped whatever was queued or in flight
+
+private:
+    void startNext();
+    void onFinished(QNetworkReply* reply);
+    void deliverCached(const QString& code, const QString& key, const QByteArray& body);
+    void deliver(const QString& code, const QString& key, const QByteArray& body, bool reuseParse);
+    void parseInPool(const QString& code, const QString& key, const QByteArray& body);
+    void checkIdle();
+    void recordLatency(qint64 us);
+
+    QUrl mBaseUrl;
+    int mMaxConcurrent;
+
+    QQueue<QString> mQueue;
+    QSet<QString> mUnconditional;  // codes to fetch without validators, their cache entry is gone
+    QHash<QNetworkReply*, QString> mInFlight;  // reply -> city code
+    QHash<QNetworkReply*, qint64> mStarted;    // reply -> start time (us)
+
+    ResponseCache* mCache = nullptr;
+    QHash<QString, WeatherInfo> mParsed;  // cache key -> parse of the cached body
+    QMutex mParsedLock;                   // parse workers write mParsed
+    int mCachedPending = 0;               // fresh hits waiting to be delivered
+
+    CityUpdateQueue* mUpdates = nullptr;
+    QThreadPool mParsePool;
+    std::atomic<int> mParsing{0};  // bodies handed to the pool and not parsed yet
+    std::atomic<quint64> mGeneration{0};  // bumped by cancelAll(), work queued before it is dropped
+
+    QElapsedTimer mClock;
+    qint64 mFirstStartUs = -1;
+    qint64 mLastFinishUs = 0;
+    quint64 mRequests = 0;
+    quint64 mFailures = 0;
+    QVector<qint64> mLatencies;  // ring buffer of the most recent latencies (us)
+    int mLatencyPos = 0;
+};
+
 #endif // WEATHERAPI_H
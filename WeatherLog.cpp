@@ -0,0 +1,3 @@
+#include "WeatherLog.h"
+
+Q_LOGGING_CATEGORY(lcWeatherPerf, "weather.perf", QtInfoMsg)
@@ -0,0 +1,10 @@
+#ifndef WEATHERLOG_H
+#define WEATHERLOG_H
+
+#include <QLoggingCategory>
+
+// Timing and counter output, off by default.
+// Enable with QT_LOGGING_RULES="weather.perf.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcWeatherPerf)
+
+#endif // WEATHERLOG_H
@@ -0,0 +1,301 @@
+#ifndef WEATHERTYPE_H
+#define WEATHERTYPE_H
+
+#include <QtGlobal>
+#include <QStringView>
+#include <QLatin1String>
+#include <string_view>
+
+// Every weather type we have an icon for (res/*.png), named after the icon file.
+enum class WeatherType : quint8 {
+    Unknown = 0,
+    BaoXue,
+    BaoYu,
+    BaoYuDaoDaBaoYu,
+    DaBaoYu,
+    DaBaoYuDaoTeDaBaoYu,
+    DaDaoBaoXue,
+    DaDaoBaoYu,
+    DaXue,
+    DaYu,
+    DongYu,
+    DuoYun,
+    FuChen,
+    LeiZhenYu,
+    LeiZhenYuBanYouBingBao,
+    Mai,
+    QiangShaChenBao,
+    Qing,
+    ShaChenBao,
+    TeDaBaoYu,
+    Wu,
+    XiaoDaoZhongXue,
+    XiaoDaoZhongYu,
+    XiaoXue,
+    XiaoYu,
+    Xue,
+    YangSha,
+    Yin,
+    Yu,
+    YuJiaXue,
+    ZhenXue,
+    ZhenYu,
+    ZhongDaoDaXue,
+    ZhongDaoDaYu,
+    ZhongXue,
+    ZhongYu,
+    Count
+};
+
+namespace WeatherTypes {
+
+struct TypeInfo {
+    WeatherType type;
+    const char* label;  // English text shown in the UI
+    const char* icon;   // resource path, the icon id is the enum value
+};
+
+// indexed by WeatherType, unknown types fall back to the cloudy icon
+// (there is no undefined.png in the resources)
+inline constexpr TypeInfo kTypes[] = {
+    {WeatherType::Unknown, "Unknown", ":/res/DuoYun.png"},
+    {WeatherType::BaoXue, "Heavy Snow", ":/res/BaoXue.png"},
+    {WeatherType::BaoYu, "Heavy Rain", ":/res/BaoYu.png"},
+    {WeatherType::BaoYuDaoDaBaoYu, "Heavy to Big Heavy Rain", ":/res/BaoYuDaoDaBaoYu.png"},
+    {WeatherType::DaBaoYu, "Big Heavy Rain", ":/res/DaBaoYu.png"},
+    {WeatherType::DaBaoYuDaoTeDaBaoYu, "Big to Extreme Heavy Rain", ":/res/DaBaoYuDaoTeDaBaoYu.png"},
+    {WeatherType::DaDaoBaoXue, "Big to Heavy Snow", ":/res/DaDaoBaoXue.png"},
+    {WeatherType::DaDaoBaoYu, "Big to Heavy Rain", ":/res/DaDaoBaoYu.png"},
+    {WeatherType::DaXue, "Big Snow", ":/res/DaXue.png"},
+    {WeatherType::DaYu, "Big Rain", ":/res/DaYu.png"},
+    {WeatherType::DongYu, "Ice Rain", ":/res/DongYu.png"},
+    {WeatherType::DuoYun, "Cloudy", ":/res/DuoYun.png"},
+    {WeatherType::FuChen, "Dust", ":/res/FuChen.png"},
+    {WeatherType::LeiZhenYu, "Thunderstorm", ":/res/LeiZhenYu.png"},
+    {WeatherType::LeiZhenYuBanYouBingBao, "Hail", ":/res/LeiZhenYuBanYouBingBao.png"},
+    {WeatherType::Mai, "Haze", ":/res/Mai.png"},
+    {WeatherType::QiangShaChenBao, "Severe Sandstorm", ":/res/QiangShaChenBao.png"},
+    {WeatherType::Qing, "Sunny", ":/res/Qing.png"},
+    {WeatherType::ShaChenBao, "Sandstorm", ":/res/ShaChenBao.png"},
+    {WeatherType::TeDaBaoYu, "Extreme Heavy Rain", ":/res/TeDaBaoYu.png"},
+    {WeatherType::Wu, "Fog", ":/res/Wu.png"},
+    {WeatherType::XiaoDaoZhongXue, "Light to Medium Snow", ":/res/XiaoDaoZhongXue.png"},
+    {WeatherType::XiaoDaoZhongYu, "Light to Medium Rain", ":/res/XiaoDaoZhongYu.png"},
+    {WeatherType::XiaoXue, "Light Snow", ":/res/XiaoXue.png"},
+    {WeatherType::XiaoYu, "Drizzling", ":/res/XiaoYu.png"},
+    {WeatherType::Xue, "Snow", ":/res/Xue.png"},
+    {WeatherType::YangSha, "Blowing Sand", ":/res/YangSha.png"},
+    {WeatherType::Yin, "Overcast", ":/res/Yin.png"},
+    {WeatherType::Yu, "Rain", ":/res/Yu.png"},
+    {WeatherType::YuJiaXue, "Rain with Snow", ":/res/YuJiaXue.png"},
+    {WeatherType::ZhenXue, "Snow Shower", ":/res/ZhenXue.png"},
+    {WeatherType::ZhenYu, "Shower", ":/res/ZhenYu.png"},
+    {WeatherType::ZhongDaoDaXue, "Medium to Big Snow", ":/res/ZhongDaoDaXue.png"},
+    {WeatherType::ZhongDaoDaYu, "Medium to Big Rain", ":/res/ZhongDaoDaYu.png"},
+    {WeatherType::ZhongXue, "Medium Snow", ":/res/ZhongXue.png"},
+    {WeatherType::ZhongYu, "Medium Rain", ":/res/ZhongYu.png"},
+};
+static_assert(sizeof(kTypes) / sizeof(kTypes[0]) == size_t(WeatherType::Count), "kTypes must cover every WeatherType");
+
+struct Key {
+    std::u16string_view name;
+    WeatherType type;
+};
+
+// Every string a provider may send: English labels, icon (pinyin) names and Chinese names.
+inline constexpr Key kKeys[] = {
+    // English
+    {u"Unknown", WeatherType::Unknown},
+    {u"undefined", WeatherType::Unknown},
+    {u"Heavy Snow", WeatherType::BaoXue},
+    {u"Heavy Rain", WeatherType::BaoYu},
+    {u"Heavy to Big Heavy Rain", WeatherType::BaoYuDaoDaBaoYu},
+    {u"Big Heavy Rain", WeatherType::DaBaoYu},
+    {u"Big to Extreme Heavy Rain", WeatherType::DaBaoYuDaoTeDaBaoYu},
+    {u"Big to Heavy Snow", WeatherType::DaDaoBaoXue},
+    {u"Big to Heavy Rain", WeatherType::DaDaoBaoYu},
+    {u"Big Snow", WeatherType::DaXue},
+    {u"Big Rain", WeatherType::DaYu},
+    {u"Ice Rain", WeatherType::DongYu},
+    {u"Cloudy", WeatherType::DuoYun},
+    {u"Dust", WeatherType::FuChen},
+    {u"Thunderstorm", WeatherType::LeiZhenYu},
+    {u"Hail", WeatherType::LeiZhenYuBanYouBingBao},
+    {u"Haze", WeatherType::Mai},
+    {u"Severe Sandstorm", WeatherType::QiangShaChenBao},
+    {u"Sunny", WeatherType::Qing},
+    {u"Sandstorm", WeatherType::ShaChenBao},
+    {u"Extreme Heavy Rain", WeatherType::TeDaBaoYu},
+    {u"Fog", WeatherType::Wu},
+    {u"Light to Medium Snow", WeatherType::XiaoDaoZhongXue},
+    {u"Light to Medium Rain", WeatherType::XiaoDaoZhongYu},
+    {u"Light Snow", WeatherType::XiaoXue},
+    {u"Drizzling", WeatherType::XiaoYu},
+    {u"Light Rain", WeatherType::XiaoYu},
+    {u"Snow", WeatherType::Xue},
+    {u"Blowing Sand", WeatherType::YangSha},
+    {u"Overcast", WeatherType::Yin},
+    {u"Rain", WeatherType::Yu},
+    {u"Rain with Snow", WeatherType::YuJiaXue},
+    {u"Snow Shower", WeatherType::ZhenXue},
+    {u"Shower", WeatherType::ZhenYu},
+    {u"Medium to Big Snow", WeatherType::ZhongDaoDaXue},
+    {u"Medium to Big Rain", WeatherType::ZhongDaoDaYu},
+    {u"Medium Snow", WeatherType::ZhongXue},
+    {u"Medium Rain", WeatherType::ZhongYu},
+
+    // icon names
+    {u"BaoXue", WeatherType::BaoXue},
+    {u"BaoYu", WeatherType::BaoYu},
+    {u"BaoYuDaoDaBaoYu", WeatherType::BaoYuDaoDaBaoYu},
+    {u"DaBaoYu", WeatherType::DaBaoYu},
+    {u"DaBaoYuDaoTeDaBaoYu", WeatherType::DaBaoYuDaoTeDaBaoYu},
+    {u"DaDaoBaoXue", WeatherType::DaDaoBaoXue},
+    {u"DaDaoBaoYu", WeatherType::DaDaoBaoYu},
+    {u"DaXue", WeatherType::DaXue},
+    {u"DaYu", WeatherType::DaYu},
+    {u"DongYu", WeatherType::DongYu},
+    {u"DuoYun", WeatherType::DuoYun},
+    {u"FuChen", WeatherType::FuChen},
+    {u"LeiZhenYu", WeatherType::LeiZhenYu},
+    {u"LeiZhenYuBanYouBingBao", WeatherType::LeiZhenYuBanYouBingBao},
+    {u"Mai", WeatherType::Mai},
+    {u"QiangShaChenBao", WeatherType::QiangShaChenBao},
+    {u"Qing", WeatherType::Qing},
+    {u"ShaChenBao", WeatherType::ShaChenBao},
+    {u"TeDaBaoYu", WeatherType::TeDaBaoYu},
+    {u"Wu", WeatherType::Wu},
+    {u"XiaoDaoZhongXue", WeatherType::XiaoDaoZhongXue},
+    {u"XiaoDaoZhongYu", WeatherType::XiaoDaoZhongYu},
+    {u"XiaoXue", WeatherType::XiaoXue},
+    {u"XiaoYu", WeatherType::XiaoYu},
+    {u"Xue", WeatherType::Xue},
+    {u"YangSha", WeatherType::YangSha},
+    {u"Yin", WeatherType::Yin},
+    {u"Yu", WeatherType::Yu},
+    {u"YuJiaXue", WeatherType::YuJiaXue},
+    {u"ZhenXue", WeatherType::ZhenXue},
+    {u"ZhenYu", WeatherType::ZhenYu},
+    {u"ZhongDaoDaXue", WeatherType::ZhongDaoDaXue},
+    {u"ZhongDaoDaYu", WeatherType::ZhongDaoDaYu},
+    {u"ZhongXue", WeatherType::ZhongXue},
+    {u"ZhongYu", WeatherType::ZhongYu},
+
+    // Chinese
+    {u"暴雪", WeatherType::BaoXue},
+    {u"暴雨", WeatherType::BaoYu},
+    {u"暴雨到大暴雨", WeatherType::BaoYuDaoDaBaoYu},
+    {u"大暴雨", WeatherType::DaBaoYu},
+    {u"大暴雨到特大暴雨", WeatherType::DaBaoYuDaoTeDaBaoYu},
+    {u"大到暴雪", WeatherType::DaDaoBaoXue},
+    {u"大到暴雨", WeatherType::DaDaoBaoYu},
+    {u"大雪", WeatherType::DaXue},
+    {u"大雨", WeatherType::DaYu},
+    {u"冻雨", WeatherType::DongYu},
+    {u"多云", WeatherType::DuoYun},
+    {u"浮尘", WeatherType::FuChen},
+    {u"雷阵雨", WeatherType::LeiZhenYu},
+    {u"雷阵雨伴有冰雹", WeatherType::LeiZhenYuBanYouBingBao},
+    {u"霾", WeatherType::Mai},
+    {u"强沙尘暴", WeatherType::QiangShaChenBao},
+    {u"晴", WeatherType::Qing},
+    {u"沙尘暴", WeatherType::ShaChenBao},
+    {u"特大暴雨", WeatherType::TeDaBaoYu},
+    {u"雾", WeatherType::Wu},
+    {u"小到中雪", WeatherType::XiaoDaoZhongXue},
+    {u"小到中雨", WeatherType::XiaoDaoZhongYu},
+    {u"小雪", WeatherType::XiaoXue},
+    {u"小雨", WeatherType::XiaoYu},
+    {u"雪", WeatherType::Xue},
+    {u"扬沙", WeatherType::YangSha},
+    {u"阴", WeatherType::Yin},
+    {u"雨", WeatherType::Yu},
+    {u"雨夹雪", WeatherType::YuJiaXue},
+    {u"阵雪", WeatherType::ZhenXue},
+    {u"阵雨", WeatherType::ZhenYu},
+    {u"中到大雪", WeatherType::ZhongDaoDaXue},
+    {u"中到大雨", WeatherType::ZhongDaoDaYu},
+    {u"中雪", WeatherType::ZhongXue},
+    {u"中雨", WeatherType::ZhongYu},
+};
+inline constexpr int kKeyCount = sizeof(kKeys) / sizeof(kKeys[0]);
+static_assert(kKeyCount < 255, "slot table stores key index + 1 in a quint8");
+
+// FNV-1a over the UTF-16 code units, so QStringView can be hashed without converting
+constexpr quint32 hash(std::u16string_view name, quint32 seed)
+{
+    quint32 h = 2166136261u ^ seed;
+    for ( char16_t c : name ) {
+        h = (h ^ (c & 0xFF)) * 16777619u;
+        h = (h ^ (c >> 8)) * 16777619u;
+    }
+    return h;
+}
+
+// Open table with one key per slot. The seed is searched at compile time
+// until no two keys collide, which makes the hash perfect for kKeys.
+inline constexpr int kSlotBits = 12;
+inline constexpr int kSlotCount = 1 << kSlotBits;
+
+struct PerfectHash {
+    quint32 seed = 0;
+    quint8 slots[kSlotCount] = {};  // key index + 1, 0 = empty
+};
+
+constexpr PerfectHash buildPerfectHash()
+{
+    PerfectHash table;
+    for ( quint32 seed = 1; ; seed++ ) {
+        for ( int i = 0; i < kSlotCount; i++ ) {
+            table.slots[i] = 0;
+        }
+
+        bool collision = false;
+        for ( int i = 0; i < kKeyCount && !collision; i++ ) {
+            quint32 slot = hash(kKeys[i].name, seed) & (kSlotCount - 1);
+            collision = table.slots[slot] != 0;
+            table.slots[slot] = quint8(i + 1);
+        }
+
+        if ( !collision ) {
+            table.seed = seed;
+            return table;
+        }
+    }
+}
+
+inline constexpr PerfectHash kPerfectHash = buildPerfectHash();
+
+constexpr WeatherType lookup(std::u16string_view name)
+{
+    quint32 slot = hash(name, kPerfectHash.seed) & (kSlotCount - 1);
+    int key = kPerfectHash.slots[slot];
+    if ( key == 0 || kKeys[key - 1].name != name ) {
+        return WeatherType::Unknown;
+    }
+    return kKeys[key - 1].type;
+}
+
+static_assert(lookup(u"Sunny") == WeatherType::Qing, "perfect hash broken");
+static_assert(lookup(u"晴") == WeatherType::Qing, "perfect hash broken");
+static_assert(lookup(u"not a weather") == WeatherType::Unknown, "perfect hash broken");
+
+}  // namespace WeatherTypes
+
+// Provider string (English, pinyin or Chinese) -> WeatherType, Unknown when not in the table.
+inline WeatherType weatherTypeFromString(QStringView name)
+{
+    return WeatherTypes::lookup(std::u16string_view(reinterpret_cast<const char16_t*>(name.data()), name.size()));
+}
+
+inline QLatin1String weatherTypeLabel(WeatherType type)
+{
+    return QLatin1String(WeatherTypes::kTypes[int(type)].label);
+}
+
+inline QLatin1String weatherTypeIcon(WeatherType type)
+{
+    return QLatin1String(WeatherTypes::kTypes[int(type)].icon);
+}
+
+#endif // WEATHERTYPE_H
@@ -1,123 +1,498 @@
 #include <iostream>
 // #include <QCoreApplication>
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDOcument>
-#include <QFile>
+#include <QDate>
+#include <QtMath>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
 
 #include "mainwindow.h"
 #include "widget.h"
+#include "CityCbor.h"
+#include "CityExporter.h"
+#include "CityHistory.h"
+#include "CityJsonReader.h"
+#include "CitySearch.h"
+#include "CityUpdateQueue.h"
+#include "DashboardView.h"
+#include "DataLoader.h"
+#include "GeoIndex.h"
+#include "MapView.h"
+#include "RefreshScheduler.h"
+#include "WeatherAPI.h"
+#include "WeatherLog.h"
 
-void writeJson() {
-    QJsonObject rootObj;
+// Pushes count synthetic city updates from worker threads and logs the
+// sustained updates/s, together with how late a 10 ms timer on the UI thread
+// fired meanwhile (event loop lag).
+void floodUpdates(CityUpdateQueue* queue, int count) {
+    const int producers = 4;
+    const int cities = 1000;
 
-    // Country name
-    rootObj.insert("name", "United States");
+    WeatherInfo info;
+    info.dateWeek = "2024/04/26 Friday";
+    info.weekList = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
+    info.dateList = {"04/25", "04/26", "04/27", "04/28", "04/29", "04/30"};
+    info.typeList = {"Sunny", "Sunny", "Cloudy", "Sunny", "Cloudy", "Drizzling"};
+    info.qualityList = {12, 45, 156, 88, 23, 9};
+    info.highTemp = {20, 26, 22, 28, 25, 30};
+    info.lowTemp = {5, 9, 6, 12, 11, 14};
+    info.fx = {"N Wind", "N Wind", "NW Wind", "S Wind", "NW Wind", "NE Wind"};
+    info.fl = {5, 10, 8, 12, 15, 18};
 
-    // Country info
-    QJsonObject infoObj;
-    infoObj.insert("capital", "Washington, D.C.");
-    infoObj.insert("North America", true);
-    infoObj.insert("founded year", 1776);
+    struct Flood {
+        QElapsedTimer clock;
+        qint64 last = 0;
+        qint64 maxLagMs = 0;
+        quint64 drainedBefore = 0;
+        QMetaObject::Connection done;
+        std::atomic<bool> stop{false};
+    };
+    auto flood = std::make_shared<Flood>();
+    flood->drainedBefore = queue->stats().drained;
 
-    rootObj.insert("info", infoObj);
+    // 1. Lag Probe
+    QTimer* probe = new QTimer(queue);
+    QObject::connect(probe, &QTimer::timeout, [=]() {
+        qint64 now = flood->clock.elapsed();
+        flood->maxLagMs = qMax(flood->maxLagMs, now - flood->last - probe->interval());
+        flood->last = now;
+    });
 
-    // Country states
-    QJsonArray stateArray;
+    // 2. Report once everything is drained
+    flood->done = QObject::connect(queue, &CityUpdateQueue::updatesReady, [=]() {
+        CityUpdateQueueStats s = queue->stats();
+        if ( s.drained - flood->drainedBefore < quint64(count) ) {
+            return;
+        }
+        qint64 ms = qMax(flood->clock.elapsed(), qint64(1));
+        qCDebug(lcWeatherPerf) << "flood:" << count << "updates in" << ms << "ms," << count * 1000.0 / ms << "updates/s,"
+                               << s.batches << "batches," << s.coalesced << "coalesced," << s.rejected << "rejected,"
+                               << "max event loop lag" << flood->maxLagMs << "ms";
+        probe->deleteLater();
+        QObject::disconnect(flood->done);
+    });
+
+    // 3. Producers, stopped before the queue goes away
+    QObject::connect(qApp, &QCoreApplication::aboutToQuit, queue, [=]() {
+        flood->stop = true;
+        QThreadPool::globalInstance()->waitForDone();
+    });
 
-    QJsonObject stateCAObj;
-    stateCAObj.insert("name", "California");
-    stateCAObj.insert("capital", "Sacramento");
+    flood->clock.start();
+    probe->start(10);
+    for ( int p = 0; p < producers; p++ ) {
+        QThreadPool::globalInstance()->start([=]() {
+            WeatherInfo update = info;
+            for ( int i = p; i < count && !flood->stop; i += producers ) {
+                update.city = QString("City %1").arg(i % cities);
+                update.temp = qint8(i % 40);
+                while ( !queue->tryPush(CityUpdate{QString::number(i % cities), update}) && !flood->stop ) {
+                    QThread::msleep(1);
+                }
+            }
+        });
+    }
+}
 
-    stateArray.append(stateCAObj);
+// Builds a GeoIndex over count random points and logs the build time and
+// how many nearest / radius queries per second it answers.
+void benchGeo(int count) {
+    QRandomGenerator random(165);
+    auto randomPoint = [&random](float* latitude, float* longitude) {
+        // uniform over the sphere, not crowded at the poles
+        *latitude = float(qRadiansToDegrees(std::asin(random.generateDouble() * 2 - 1)));
+        *longitude = float(random.generateDouble() * 360 - 180);
+    };
 
-    rootObj.insert("states", stateArray);
+    QVector<GeoPoint> points(count);
+    for ( int i = 0; i < count; i++ ) {
+        randomPoint(&points[i].latitude, &points[i].longitude);
+        points[i].id = quint32(i);
+    }
 
-    // Convert rootObj to Json string
-    QJsonDocument doc(rootObj);
-    QByteArray json = doc.toJson();
+    QElapsedTimer timer;
+    timer.start();
+    GeoIndex index;
+    index.build(points);
+    qint64 buildMs = timer.elapsed();
 
-    // Print
-    qDebug() << QString(json).toUtf8().data();
+    const int queries = 100000;
+    QVector<GeoPoint> targets(queries);
+    for ( GeoPoint& target : targets ) {
+        randomPoint(&target.latitude, &target.longitude);
+    }
 
-    // Write Json to file
-    QFile file("/Users/rocky/QT Projects/CSE165_Project/United_States.json");
-    file.open(QFile::WriteOnly);
-    file.write(json);
-    file.close();
+    auto rate = [&](const char* kind, const std::function<int(const GeoPoint&)>& query) {
+        qint64 found = 0;
+        timer.restart();
+        for ( const GeoPoint& target : targets ) {
+            found += query(target);
+        }
+        qint64 ns = qMax(timer.nsecsElapsed(), qint64(1));
+        qCDebug(lcWeatherPerf) << "geo bench:" << kind << queries * 1e9 / ns << "queries/s," << ns / 1000.0 / queries << "us each,"
+                               << double(found) / queries << "points each";
+    };
+
+    qCDebug(lcWeatherPerf) << "geo bench:" << count << "points indexed in" << buildMs << "ms";
+    rate("nearest", [&](const GeoPoint& p) { return index.nearest(p.latitude, p.longitude).size(); });
+    rate("8 nearest", [&](const GeoPoint& p) { return index.nearest(p.latitude, p.longitude, 8).size(); });
+    rate("within 50 km", [&](const GeoPoint& p) { return index.within(p.latitude, p.longitude, 50).size(); });
 }
 
-void fromJson() {
-    QFile file("/Users/rocky/QT Projects/CSE165_Project/United_States.json");
-    file.open(QFile::ReadOnly);
-    QByteArray json = file.readAll();
-    file.close();
+// Encodes count synthetic cities as provider (sojson) JSON and as a CityCbor
+// batch, decodes both back into a CityStore and logs size and throughput.
+void benchCbor(int count) {
+    CityStorePtr cities = DataLoader::buildSynthetic(count);
+    QElapsedTimer timer;
 
-    QJsonDocument doc = QJsonDocument::fromJson(json);
-    if (!doc.isObject()) {
-        qDebug() << "Not an object!";
-        return;
+    // 1. JSON: yesterday plus the forecast, numbers as the provider formats them
+    timer.start();
+    QJsonArray array;
+    for ( int i = 0; i < cities->size(); i++ ) {
+        CityView city = cities->view(i);
+        QJsonObject yesterday;
+        QJsonArray forecast;
+        for ( int day = 0; day < city.dayCount(); day++ ) {
+            QJsonObject dayObj;
+            dayObj.insert("week", city.week(day));
+            dayObj.insert("ymd", "2024-" + QString(city.date(day)).replace('/', '-'));
+            dayObj.insert("type", QString(city.typeLabel(day)));
+            dayObj.insert("aqi", city.aqi(day));
+            dayObj.insert("high", QString::fromUtf8("高温 %1℃").arg(int(city.highTemp(day))));
+            dayObj.insert("low", QString::fromUtf8("低温 %1℃").arg(int(city.lowTemp(day))));
+            dayObj.insert("fx", city.fx(day));
+            dayObj.insert("fl", QString::fromUtf8("%1级").arg(int(city.fl(day))));
+            if ( day == 0 ) {
+                yesterday = dayObj;
+            } else {
+                forecast.append(dayObj);
+            }
+        }
+
+        QJsonObject infoObj{{"city", city.city()}};
+        if ( city.hasLocation() ) {
+            infoObj.insert("lat", city.latitude());
+            infoObj.insert("lon", city.longitude());
+        }
+        QJsonObject dataObj{{"wendu", QString::number(int(city.temp()))}, {"ganmao", city.ganMao()}, {"pm25", city.pm25()},
+                            {"shidu", QString("%1%").arg(int(city.humidity()))}, {"quality", city.quality()},
+                            {"yesterday", yesterday}, {"forecast", forecast}};
+        QString date = QDate::fromString(city.dateWeek().left(10), "yyyy/MM/dd").toString("yyyyMMdd");
+        array.append(QJsonObject{{"status", 200}, {"date", date}, {"cityInfo", infoObj}, {"data", dataObj}});
     }
+    QByteArray json = QJsonDocument(array).toJson(QJsonDocument::Compact);
+    qint64 jsonEncodeNs = timer.nsecsElapsed();
 
-    QJsonObject obj = doc.object();
-    QStringList keys = obj.keys();
+    timer.restart();
+    CityStore fromJson;
+    CityJsonReader jsonReader(&fromJson);
+    jsonReader.addData(json);
+    bool jsonOk = jsonReader.read();
+    qint64 jsonDecodeNs = timer.nsecsElapsed();
 
-    for (int i = 0; i < keys.size(); i++) {
-        QString key = keys[i];
-        QJsonValue value = obj.value(key);
+    // 2. CBOR, written straight from the store
+    timer.restart();
+    QByteArray cbor = CityCborWriter::encode(*cities);
+    qint64 cborEncodeNs = timer.nsecsElapsed();
 
-        if (value.isBool()) {
-            qDebug() << key << ":" << value.toBool();
-        }
-        else if (value.isString()) {
-            qDebug() << key << ":" << value.toString();
-        }
-        else if (value.isDouble()) {
-            qDebug() << key << ":" << value.toInt();
-        }
-        else if (value.isObject()) {
-            qDebug() << key << ":";
+    timer.restart();
+    CityStore fromCbor;
+    CityCborReader cborReader(&fromCbor);
+    bool cborOk = cborReader.read(cbor);
+    qint64 cborDecodeNs = timer.nsecsElapsed();
 
-            QJsonObject infoObj = value.toObject();
-            QString capital = infoObj["capital"].toString();
-            bool north_america = infoObj["North America"].toBool();
-            int founded = infoObj["founded year"].toInt();
+    // 3. Report
+    auto report = [count](const char* kind, const QByteArray& bytes, qint64 encodeNs, qint64 decodeNs, bool ok, int decoded) {
+        encodeNs = qMax(encodeNs, qint64(1));
+        decodeNs = qMax(decodeNs, qint64(1));
+        qCDebug(lcWeatherPerf) << "cbor bench:" << kind << bytes.size() << "bytes," << bytes.size() / count << "per city,"
+                               << "encode" << bytes.size() * 1e3 / encodeNs << "MB/s" << count * 1e9 / encodeNs << "cities/s,"
+                               << "decode" << bytes.size() * 1e3 / decodeNs << "MB/s" << count * 1e9 / decodeNs << "cities/s,"
+                               << (ok && decoded == count ? "all cities read back" : "FAILED");
+    };
+    report("json", json, jsonEncodeNs, jsonDecodeNs, jsonOk, fromJson.size());
+    report("cbor", cbor, cborEncodeNs, cborDecodeNs, cborOk, fromCbor.size());
+    qCDebug(lcWeatherPerf) << "cbor bench: cbor is" << 100.0 * cbor.size() / qMax(json.size(), 1) << "% of the json size";
+}
 
-            qDebug() << "  " << "captial" << ":" << capital;
-            qDebug() << "  " << "North America" << ":" << north_america;
-            qDebug() << "  " << "founded year" << ":" << founded;
-        }
-        else if (value.isArray()) {
-            qDebug() << key << ":";
+// peak resident set size in KB, 0 where it is not known
+static qint64 peakRssKb() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if ( getrusage(RUSAGE_SELF, &usage) == 0 ) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;  // bytes there
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
 
-            QJsonArray stateArray = value.toArray();
+// the peak starts over at the current size (Linux), elsewhere it only grows
+static void resetPeakRss() {
+    QFile clearRefs("/proc/self/clear_refs");
+    if ( clearRefs.open(QIODevice::WriteOnly) ) {
+        clearRefs.write("5");
+    }
+}
 
-            for (int i = 0; i < stateArray.size(); i++) {
-                QJsonObject stateObj = stateArray[i].toObject();
+// Parses the same provider (sojson) JSON, count made up cities as
+// CityExporter writes them, with CityJsonReader into a CityStore and with
+// QJsonDocument::fromJson, and logs the throughput and peak RSS of each.
+// Both read the file: CityJsonReader streams it, QJsonDocument needs all of it.
+void benchJson(int count) {
+    // 1. Payload on disk, the cities are gone again before anything is measured
+    QTemporaryFile file;
+    QString error;
+    if ( !file.open() || !CityExporter::write(*DataLoader::buildSynthetic(count), file.fileName(), CityExporter::Json, &error) ) {
+        qWarning() << "json bench:" << (error.isEmpty() ? file.errorString() : error);
+        return;
+    }
+    const QString path = file.fileName();  // renamed over the temporary file
+    const qint64 bytes = QFileInfo(path).size();
 
-                QString name = stateObj["name"].toString();
-                QString capital = stateObj["capital"].toString();
+    // 2. Each parse on its own, with what it built freed before the next
+    auto run = [bytes, count](const char* kind, const std::function<int()>& parse) {
+        resetPeakRss();
+        qint64 before = peakRssKb();
+        QElapsedTimer timer;
+        timer.start();
+        int cities = parse();
+        qint64 ns = qMax(timer.nsecsElapsed(), qint64(1));
+        qCDebug(lcWeatherPerf) << "json bench:" << kind << bytes << "bytes," << bytes * 1e3 / ns << "MB/s,"
+                               << cities * 1e9 / ns << "cities/s, peak RSS +" << peakRssKb() - before << "KB,"
+                               << (cities == count ? "all cities read" : "FAILED");
+    };
+    run("CityJsonReader", [&path]() {
+        QFile json(path);
+        if ( !json.open(QIODevice::ReadOnly) ) {
+            return -1;
+        }
+        CityStore store;
+        CityJsonReader reader(&store);
+        reader.setDevice(&json);
+        return reader.read() && reader.atEnd() ? store.size() : -1;
+    });
+    run("QJsonDocument", [&path]() {
+        QFile json(path);
+        if ( !json.open(QIODevice::ReadOnly) ) {
+            return -1;
+        }
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(json.readAll(), &error);
+        return error.error == QJsonParseError::NoError ? int(document.array().size()) : -1;
+    });
+}
 
-                qDebug() << "  " << "name" << ":" << name << ", capital" << ":" << capital;
-            }
+// Records a year of hourly readings for count cities into a CityHistory and
+// logs the ingest rate, the compression ratio and what one week scans cost.
+void benchHistory(int count) {
+    const qint64 start = 1704067200;  // 2024-01-01
+    const int hours = 24 * 365;
+    QRandomGenerator random(165);
+
+    QStringList names;
+    QVector<int> pm25(count, 30);
+    for ( int c = 0; c < count; c++ ) {
+        names.append(QString("City %1").arg(c));
+    }
 
+    // 1. Ingest, an hour of every city at a time, only the appends are timed
+    CityHistory history;
+    QVector<Observation> hour(count);
+    QElapsedTimer timer;
+    qint64 appendNs = 0;
+    for ( int h = 0; h < hours; h++ ) {
+        double daily = std::sin((h % 24 - 9) * M_PI / 12);
+        double season = -std::cos(h / 24.0 * 2 * M_PI / 365);
+        for ( int c = 0; c < count; c++ ) {
+            Observation& observation = hour[c];
+            observation.time = start + h * 3600 + random.bounded(5);  // fetches land a few seconds apart
+            observation.temp = qint8(qRound(15 + 10 * season + 6 * daily) + c % 7);
+            observation.humidity = quint8(qBound(0, qRound(60 - 20 * daily) + random.bounded(3), 100));
+            pm25[c] = qBound(1, pm25[c] + random.bounded(-3, 4), 400);
+            observation.pm25 = quint16(pm25[c]);
+            observation.aqi = quint16(qMin(500, pm25[c] * 3 / 2 + 10));
+        }
 
+        timer.restart();
+        for ( int c = 0; c < count; c++ ) {
+            history.append(names[c], hour[c]);
         }
+        appendNs += timer.nsecsElapsed();
+    }
+
+    qint64 readings = history.observationCount();
+    qint64 raw = readings * 14;  // time, temp, humidity, pm25, aqi packed
+    qCDebug(lcWeatherPerf) << "history bench:" << readings << "readings of" << count << "cities,"
+                           << readings * 1e9 / qMax(appendNs, qint64(1)) << "readings/s," << history.byteSize() << "bytes,"
+                           << double(history.byteSize()) / qMax(readings, qint64(1)) << "bytes per reading,"
+                           << double(raw) / qMax(history.byteSize(), qint64(1)) << "x smaller than packed";
+
+    // 2. One week of a random city
+    const int scans = 1000;
+    qint64 found = 0;
+    qint64 blocks = 0;
+    timer.restart();
+    for ( int s = 0; s < scans; s++ ) {
+        qint64 from = start + random.bounded(hours - 168) * qint64(3600);
+        blocks += history.scan(names[random.bounded(count)], from, from + 7 * 24 * 3600, [&found](const Observation&) { found++; });
     }
+    qCDebug(lcWeatherPerf) << "history bench: one week scans" << timer.nsecsElapsed() / 1000.0 / scans << "us each,"
+                           << double(found) / scans << "readings," << double(blocks) / scans << "blocks decoded";
 }
 
 int main(int argc, char *argv[]) {
     QApplication a(argc, argv);
 
-    // writeJson();
-    fromJson();
 
     // MainWindow w;
     // w.show();
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption apiOption("api", "Weather endpoint, the city code is appended.", "url");
+    QCommandLineOption cityOption("city", "City code to fetch, can be repeated.", "code");
+    QCommandLineOption connectionsOption("connections", "Requests in flight at most.", "count", "6");
+    QCommandLineOption dataOption("data", "Weather dump (JSON or CBOR) to load at startup.", "file");
+    QCommandLineOption dwellOption("dwell", "Milliseconds each city stays on screen.", "ms", "3000");
+    QCommandLineOption fadeOption("fade", "Cross-fade between cities in ms, 0 switches at once.", "ms", "250");
+    QCommandLineOption gazetteerOption("gazetteer", "City list to search, \"code<TAB>name<TAB>aliases\" lines or its index.", "file");
+    QCommandLineOption searchBenchOption("search-bench", "Time this many city searches once the gazetteer is loaded.", "count");
+    QCommandLineOption locationOption("location", "Show the city closest to this position.", "lat,lon");
+    QCommandLineOption geoBenchOption("geo-bench", "Time nearest city lookups over this many random points.", "count");
+    QCommandLineOption mapOption("map", "Also show every city on a map.");
+    QCommandLineOption mapBenchOption("map-bench", "Pan and zoom the map over this many frames once cities are loaded.", "frames");
+    QCommandLineOption syntheticOption("synthetic", "Load this many made up cities.", "count");
+    QCommandLineOption dashboardOption("dashboard", "Also show every city in a table.");
+    QCommandLineOption floodOption("flood", "Push this many synthetic city updates and log the rate.", "count");
+    QCommandLineOption exportOption("export", "Write the cities to this file after every load, as JSON, CSV or CBOR by its suffix.", "file");
+    QCommandLineOption historyBenchOption("history-bench", "Record a year of hourly readings for this many cities and log the rate and size.", "count");
+    QCommandLineOption cborBenchOption("cbor-bench", "Compare CBOR and JSON encoding on this many made up cities.", "count");
+    QCommandLineOption jsonBenchOption("json-bench", "Compare CityJsonReader and QJsonDocument parsing on this many made up cities.", "count");
+    parser.addOption(apiOption);
+    parser.addOption(cityOption);
+    parser.addOption(connectionsOption);
+    parser.addOption(dataOption);
+    parser.addOption(dwellOption);
+    parser.addOption(fadeOption);
+    parser.addOption(gazetteerOption);
+    parser.addOption(searchBenchOption);
+    parser.addOption(locationOption);
+    parser.addOption(geoBenchOption);
+    parser.addOption(mapOption);
+    parser.addOption(mapBenchOption);
+    parser.addOption(syntheticOption);
+    parser.addOption(dashboardOption);
+    parser.addOption(floodOption);
+    parser.addOption(exportOption);
+    parser.addOption(cborBenchOption);
+    parser.addOption(jsonBenchOption);
+    parser.addOption(historyBenchOption);
+    parser.process(a);
+
     Widget w;
     w.show();
 
+    // read and parsed on a worker, the window is up before the data
+    if ( parser.isSet(dataOption) ) {
+        w.dataLoader()->load(parser.value(dataOption));
+    }
+    if ( parser.isSet(syntheticOption) ) {
+        w.dataLoader()->loadSynthetic(parser.value(syntheticOption).toInt());
+    }
+
+    if ( parser.isSet(gazetteerOption) ) {
+        if ( parser.isSet(searchBenchOption) ) {
+            int count = parser.value(searchBenchOption).toInt();
+            QObject::connect(w.citySearch(), &CitySearch::ready, [&w, count]() { w.citySearch()->benchmark(count); });
+        }
+        w.citySearch()->load(parser.value(gazetteerOption));
+    }
+
+    if ( parser.isSet(locationOption) ) {
+        QStringList position = parser.value(locationOption).split(',');
+        bool latOk = false;
+        bool lonOk = false;
+        double latitude = position.value(0).toDouble(&latOk);
+        double longitude = position.value(1).toDouble(&lonOk);
+        if ( latOk && lonOk ) {
+            w.setLocation(latitude, longitude);
+        } else {
+            qWarning() << "--location expects latitude,longitude in degrees";
+        }
+    }
+    if ( parser.isSet(geoBenchOption) ) {
+        benchGeo(parser.value(geoBenchOption).toInt());
+    }
+    if ( parser.isSet(cborBenchOption) ) {
+        benchCbor(parser.value(cborBenchOption).toInt());
+    }
+    if ( parser.isSet(jsonBenchOption) ) {
+        benchJson(parser.value(jsonBenchOption).toInt());
+    }
+    if ( parser.isSet(historyBenchOption) ) {
+        benchHistory(parser.value(historyBenchOption).toInt());
+    }
+
+    std::unique_ptr<DashboardView> dashboard;
+    if ( parser.isSet(dashboardOption) ) {
+        dashboard.reset(new DashboardView());
+        dashboard->setCities(w.cities());
+        QObject::connect(&w, &Widget::citiesChanged, dashboard.get(), &DashboardView::setCities);
+        dashboard->show();
+    }
+
+    std::unique_ptr<MapView> map;
+    if ( parser.isSet(mapOption) || parser.isSet(mapBenchOption) ) {
+        map.reset(new MapView());
+        map->setCities(w.cities());
+        QObject::connect(&w, &Widget::citiesChanged, map.get(), &MapView::setCities);
+        map->show();
+    }
+    if ( parser.isSet(mapBenchOption) ) {
+        // after the widget, so the map already has the loaded cities
+        int frames = parser.value(mapBenchOption).toInt();
+        MapView* view = map.get();
+        QObject::connect(w.dataLoader(), &DataLoader::loaded, view, [view, frames]() { view->benchmark(frames); });
+    }
+
+    if ( parser.isSet(exportOption) ) {
+        // after the widget, so its cities already include the load
+        QString path = parser.value(exportOption);
+        QObject::connect(w.dataLoader(), &DataLoader::loaded, &w, [&w, path]() { w.dataLoader()->exportCities(w.cities(), path); });
+    }
+
+    if ( parser.isSet(apiOption) ) {
+        w.weatherAPI()->setBaseUrl(QUrl(parser.value(apiOption)));
+    }
+    w.weatherAPI()->setMaxConcurrent(parser.value(connectionsOption).toInt());
+    w.scheduler()->setDwell(parser.value(dwellOption).toInt());
+    w.setFadeDuration(parser.value(fadeOption).toInt());
+    w.fetchCities(parser.values(cityOption));
+
+    if ( parser.isSet(floodOption) ) {
+        floodUpdates(w.updateQueue(), parser.value(floodOption).toInt());
+    }
+
     return a.exec();
 }
@@ -1,37 +1,53 @@
 #include "widget.h"
+#include <QAbstractItemView>
 #include <QApplication>
+#include <QCompleter>
 #include <QContextMenuEvent>
+#include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QHBoxLayout>
-#include <QTimer>
 #include <QPainter>
+#include <QStringListModel>
+
+#include "CitySearch.h"
+#include "CitySnapshot.h"
+#include "CityUpdateQueue.h"
+#include "IconCache.h"
+#include "RefreshScheduler.h"
+#include "SwapOverlay.h"
+#include "Theme.h"
+#include "WeatherAPI.h"
+#include "WeatherLog.h"
+
+// yesterday, today and four more, the feed sends about two weeks
+static const int SHOWN_DAYS = 6;
+
+// Pre-scaled icon for a fixed size label, replaces setScaledContents(true)
+static QPixmap labelIcon(QLabel* label, const QString& path)
+{
+    label->ensurePolished();
+    return IconCache::instance().pixmap(path, label->contentsRect().size(), label->devicePixelRatioF());
+}
 
-// weather graph
-#define INCREMENT     3   // y axis movement w/ respect to weather temperature +/- 1c
-#define POINT_RADIUS  3   // size of dot on graph
-#define TEXT_OFFSET_X 12  // moisture text movement around dot on x-axis
-#define TEXT_OFFSET_Y 10  // moisture text movement around dot on y-axis
+static QPixmap labelIcon(QLabel* label, WeatherType type)
+{
+    label->ensurePolished();
+    return IconCache::instance().pixmap(type, label->contentsRect().size(), label->devicePixelRatioF());
+}
 
 Widget::Widget(QWidget* parent) : QWidget(parent)
 {
+    mStartup.start();
+
     // frameless settings
     setWindowFlag(Qt::FramelessWindowHint);
 
     this->setObjectName("weather_widget");
-    this->setStyleSheet(R"(
-        QWidget#weather_widget {
-            background-color: rgba(50, 115,165, 255);
-        }
-
-        QLabel {
-            font: 12pt "Microsoft YaHei";
-            border-radius: 4px;
-            color: rgb(255,255,255);
-            padding: 12px;
-        }
-    )");
+    this->setStyleSheet(Theme::instance().styleSheet());
 
     // 1. center
     mainLayout = new QVBoxLayout(this);
@@ -57,11 +73,123 @@ Widget::Widget(QWidget* parent) : QWidget(parent)
     mainLayout->addLayout(topLayout);
     mainLayout->addLayout(bottomLayout);
 
+    QElapsedTimer preload;
+    preload.start();
+    IconCache::instance().preload();
+    qCDebug(lcWeatherPerf) << "IconCache: preloaded in" << preload.nsecsElapsed() / 1000 << "us,"
+                           << IconCache::instance().stats().bytes << "bytes";
+
     initTop();
     initLeft();
     initRight();
 
-    initData();
+    // shown until the loader delivers the first cities
+    cityIndex = 0;
+    applySnapshot(placeholderSnapshot());
+
+    mCities.setPublished([this]() {
+        QMetaObject::invokeMethod(this, [this]() { onCitiesPublished(); }, Qt::QueuedConnection);
+    });
+
+    mDataLoader = new DataLoader(this);
+    mResponseCache.setPool(mDataLoader->pool());
+    connect(mDataLoader, &DataLoader::geoIndexReady, this, [this](const GeoIndex& index, int cities) {
+        // an older build finishing late changes nothing
+        if ( cities > mGeoIndexed ) {
+            mGeoIndex = index;
+            mGeoIndexed = cities;
+            locateCity();
+        }
+    });
+    connect(mDataLoader, &DataLoader::loaded, this, &Widget::onCitiesLoaded);
+    connect(mDataLoader, &DataLoader::failed, this, [this](const QString& source, const QString& error) {
+        qWarning() << "City data" << source << "failed:" << error;
+
+        // unreadable history, written anew with the readings from now on
+        if ( source == mHistoryPath ) {
+            mHistoryLoading = false;
+        }
+
+        // unreadable snapshot, start from the example cities instead
+        if ( source == mSnapshotPath && mCities.current()->isEmpty() ) {
+            mDataLoader->loadSample();
+        }
+    });
+    connect(mDataLoader, &DataLoader::saved, this, [this](const QString&, quint64 generation) {
+        mSavedGeneration = qMax(mSavedGeneration, generation);
+    });
+
+    // last known good cities if there are any, they are shown before anything is fetched
+    mSnapshotPath = CitySnapshot::defaultPath();
+    if ( QFile::exists(mSnapshotPath) ) {
+        mDataLoader->loadSnapshot(mSnapshotPath);
+    } else {
+        mDataLoader->loadSample();
+    }
+
+    // readings of earlier runs, only the compressed blocks are read. Readings
+    // fetched in the meantime go on after them, nothing is saved until then
+    mHistoryPath = CityHistory::defaultPath();
+    connect(mDataLoader, &DataLoader::historyLoaded, this, [this](const CityHistory& history, const QString&) {
+        CityHistory fetched = mHistory;
+        mHistory = history;
+        mHistory.merge(fetched);
+        mSavedObservations = history.observationCount();
+        mHistoryLoading = false;
+    });
+    if ( QFile::exists(mHistoryPath) ) {
+        mHistoryLoading = true;
+        mDataLoader->loadHistory(mHistoryPath);
+    }
+
+    // written after every refresh, but at most once per burst of them
+    mSnapshotTimer.setSingleShot(true);
+    mSnapshotTimer.setInterval(2000);
+    connect(&mSnapshotTimer, &QTimer::timeout, this, [this]() {
+        CityStorePtr cities = mCities.current();
+        if ( !cities->isEmpty() && cities->generation() != mSavedGeneration ) {
+            mDataLoader->save(cities, mSnapshotPath);
+        }
+        if ( !mHistoryLoading && mHistory.observationCount() != mSavedObservations ) {
+            mDataLoader->saveHistory(mHistory, mHistoryPath);
+            mSavedObservations = mHistory.observationCount();
+        }
+    });
+    connect(this, &Widget::citiesChanged, &mSnapshotTimer, qOverload<>(&QTimer::start));
+
+    // typeahead over the gazetteer, loaded with --gazetteer
+    mSearch = new CitySearch(this);
+    connect(mSearch, &CitySearch::resultsReady, this, &Widget::onSearchResults);
+    connect(mSearch, &CitySearch::failed, this, [](const QString& error) {
+        qWarning() << "City search unavailable:" << error;
+    });
+    connect(leCity, &QLineEdit::textEdited, mSearch, &CitySearch::setQuery);
+    connect(leCity, &QLineEdit::returnPressed, this, [this]() { searchCity(leCity->text()); });
+    connect(btnSearch, &QPushButton::clicked, this, [this]() { searchCity(leCity->text()); });
+    connect(mCompleter, qOverload<const QString&>(&QCompleter::activated), this, [this](const QString& text) {
+        leCity->setText(text);
+        searchCity(text);
+    });
+
+    mWeatherAPI = new WeatherAPI(this);
+    mWeatherAPI->setCache(&mResponseCache);
+    connect(mWeatherAPI, &WeatherAPI::weatherReady, this, &Widget::onWeatherReady);
+    connect(mWeatherAPI, &WeatherAPI::weatherFailed, this, [this](const QString& code, const QString& error) {
+        qWarning() << "Weather for" << code << "failed:" << error;
+        mScheduler->markFailed(code);
+    });
+
+    // created after the client, so it is deleted after the client's workers are done with it
+    mUpdateQueue = new CityUpdateQueue(4096, this);
+    mWeatherAPI->setUpdateQueue(mUpdateQueue);
+    connect(mUpdateQueue, &CityUpdateQueue::updatesReady, this, &Widget::onCityUpdates);
+    connect(mWeatherAPI, &WeatherAPI::idle, this, [this]() {
+        CityUpdateQueueStats s = mUpdateQueue->stats();
+        qCDebug(lcWeatherPerf) << "CityUpdateQueue:" << s.pushed << "pushed," << s.rejected << "rejected," << s.coalesced << "coalesced,"
+                               << s.batches << "batches, max batch" << s.maxBatch << ", max depth" << s.maxDepth << ", max lag" << s.maxLagUs << "us";
+        IconCacheStats icons = IconCache::instance().stats();
+        qCDebug(lcWeatherPerf) << "IconCache:" << icons.hits << "hits," << icons.misses << "scaled," << icons.bytes << "bytes";
+    });
 
     mExitMenu = new QMenu(this);
     mExitAct = new QAction();
@@ -71,14 +199,29 @@ Widget::Widget(QWidget* parent) : QWidget(parent)
 
     connect(mExitAct, &QAction::triggered, this, [=]() { qApp->exit(0); });
 
-    QTimer* timer = new QTimer();
-    connect(timer, &QTimer::timeout, this, &Widget::updateUI);
-    cityIndex = 0;
-    timer->start(3000);
+    // rotation and refetching, started by showEvent
+    mScheduler = new RefreshScheduler(&mCities, this);
+    mScheduler->setRefreshInterval(mResponseCache.ttl());
+    connect(mScheduler, &RefreshScheduler::prepareCity, this, &Widget::prepareCity);
+    connect(mScheduler, &RefreshScheduler::showCity, this, &Widget::showCity);
+    mSwap = new SwapOverlay(this);
+    connect(mScheduler, &RefreshScheduler::refreshDue, mWeatherAPI, qOverload<const QStringList&>(&WeatherAPI::fetch));
+    connect(mWeatherAPI, &WeatherAPI::cancelled, mScheduler, &RefreshScheduler::markCancelled);
+
+    qCDebug(lcWeatherPerf) << "Widget constructed in" << mStartup.nsecsElapsed() / 1000 << "us,"
+                           << findChildren<QWidget*>().size() << "child widgets";
 }
 
 Widget::~Widget()
 {
+    // children are deleted after the members, but the client uses
+    // mResponseCache and the scheduler mCities: both go first. Nobody drains
+    // the queue from here on, closing it lets the parse workers give up
+    mUpdateQueue->close();
+    delete mWeatherAPI;
+    mWeatherAPI = nullptr;
+    delete mScheduler;
+    mScheduler = nullptr;
 }
 
 // rewrite parent's virtual function
@@ -103,33 +246,52 @@ void Widget::mouseMoveEvent(QMouseEvent* event)
     this->move(event->globalPos() - mOffset);
 }
 
-bool Widget::eventFilter(QObject* watched, QEvent* event)
+void Widget::paintEvent(QPaintEvent* event)
 {
-    if ( watched == lblHigh && event->type() == QEvent::Paint ) {
-        paintHighCurve();
-    }
-    if ( watched == lblLow && event->type() == QEvent::Paint ) {
-        paintLowCurve();
+    if ( !mPainted ) {
+        mPainted = true;
+        qCDebug(lcWeatherPerf) << "First paint after" << mStartup.elapsed() << "ms";
     }
+    QWidget::paintEvent(event);
+}
+
+void Widget::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    mScheduler->setActive(!isMinimized());
+}
+
+void Widget::hideEvent(QHideEvent* event)
+{
+    QWidget::hideEvent(event);
+    mScheduler->setActive(false);
+}
 
-    return QWidget::eventFilter(watched, event);
+void Widget::changeEvent(QEvent* event)
+{
+    QWidget::changeEvent(event);
+    if ( event->type() == QEvent::WindowStateChange ) {
+        mScheduler->setActive(isVisible() && !isMinimized());
+    }
 }
 
 void Widget::initTop()
 {
     // 1. City Search Bar
-    QLineEdit* leCity = new QLineEdit(this);
+    leCity = new QLineEdit(this);
     leCity->setFixedWidth(360);
-    leCity->setStyleSheet(R"(
-        font: 14pt Microsoft YaHei;
-        background-color: rgb(255,255,255);
-        border-radius: 4px;
-        padding: 4px 8px;
-    )");
+    leCity->setObjectName("leCity");
+
+    // 1.1 Suggestions, the list is already matched by the search
+    mCompletions = new QStringListModel(this);
+    mCompleter = new QCompleter(mCompletions, this);
+    mCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    mCompleter->setMaxVisibleItems(12);
+    mCompleter->setWidget(leCity);
 
     // 2. Search Button
-    QPushButton* btnSearch = new QPushButton(this);
-    btnSearch->setStyleSheet("background-color: rgba(255,255,255, 0);");
+    btnSearch = new QPushButton(this);
+    btnSearch->setObjectName("btnSearch");
     btnSearch->setIcon(QIcon(":/res/search.png"));
     btnSearch->setIconSize(QSize(24, 24));
 
@@ -138,10 +300,7 @@ void Widget::initTop()
 
     // 4. Date
     lblDate = new QLabel(this);
-    lblDate->setStyleSheet(R"(
-        font: 20pt Arial;
-        background-color: rgba(255,255,255, 0);
-    )");
+    lblDate->setObjectName("lblDate");
     lblDate->setAlignment(Qt::AlignCenter);
     lblDate->setText("2024/04/26 Friday");
 
@@ -160,9 +319,8 @@ void Widget::initLeft()
     // 1.1 Weather Type
     lblTypeIcon = new QLabel(this);
     lblTypeIcon->setFixedSize(150, 150);
-    lblTypeIcon->setStyleSheet("background-color: rga(255,255,255,0)");
-    lblTypeIcon->setPixmap(QPixmap(":/res/DuoYun.png"));
-    lblTypeIcon->setScaledContents(true);
+    lblTypeIcon->setProperty("role", "icon");
+    lblTypeIcon->setPixmap(labelIcon(lblTypeIcon, WeatherType::DuoYun));
     lblTypeIcon->setAlignment(Qt::AlignCenter);
     layout->addWidget(lblTypeIcon);
 
@@ -173,22 +331,14 @@ void Widget::initLeft()
 
     lblTemp = new QLabel(this);
     lblTemp->setText("28°");
-    lblTemp->setStyleSheet(R"(
-        font: 50pt Arial;
-        background-color: rgba(255,255,255,0);
-        padding: 0px;
-    )");
+    lblTemp->setObjectName("lblTemp");
     lblTemp->setAlignment(Qt::AlignBottom);
     hLayout1->addWidget(lblTemp);
 
     // City
     lblCity = new QLabel(this);
     lblCity->setText("Merced");     // ***** TBC *****
-    lblCity->setStyleSheet(R"(
-        font: 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblCity->setProperty("role", "headline");
     lblCity->setAlignment(Qt::AlignTop);
     hLayout2->addWidget(lblCity);
 
@@ -199,11 +349,7 @@ void Widget::initLeft()
     // Type
     lblType = new QLabel(this);
     lblType->setText("Cloudy");   // ***** TBC *****
-    lblType->setStyleSheet(R"(
-        font: 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblType->setProperty("role", "headline");
     lblType->setAlignment(Qt::AlignTop);
     hLayout2->addWidget(lblType);
 
@@ -214,11 +360,7 @@ void Widget::initLeft()
     // Low and High Temp
     lblLowHigh = new QLabel(this);
     lblLowHigh->setText("17-39°");
-    lblLowHigh->setStyleSheet(R"(
-        font: 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblLowHigh->setProperty("role", "headline");
     lblLowHigh->setAlignment(Qt::AlignTop);
     hLayout2->addWidget(lblLowHigh);
     vLayout->addLayout(hLayout1);
@@ -235,21 +377,13 @@ void Widget::initLeft()
     // 3. Sickness Index
     lblGanMao = new QLabel(this);
     lblGanMao->setText("Sickness Index：Children, elderly and repository patients should redeuce time outdoor");
-    lblGanMao->setStyleSheet(R"(
-        font: 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding-left: 5px;
-        padding-right: 5px;
-    )");
+    lblGanMao->setObjectName("lblGanMao");
     lblGanMao->setWordWrap(true);
     leftLayout->addWidget(lblGanMao);
 
     // 4. Wind/PM2.5/Moisture/Air Quality
     QWidget* widget = new QWidget(this);
-    widget->setStyleSheet(R"(
-        background-color: rgb(157,133,255);
-        border-radius: 15px;
-    )");
+    widget->setObjectName("infoPanel");
     QGridLayout* gridLayout = new QGridLayout(widget);
     gridLayout->setHorizontalSpacing(40);
     gridLayout->setVerticalSpacing(30);
@@ -261,9 +395,8 @@ void Widget::initLeft()
 
     lblFlIcon = new QLabel(this);
     lblFlIcon->setFixedSize(72, 72);
-    lblFlIcon->setStyleSheet("background-color: rgba(255,255,255,0);");
-    lblFlIcon->setPixmap(QPixmap(":/res/wind.png"));
-    lblFlIcon->setScaledContents(true);
+    lblFlIcon->setProperty("role", "icon");
+    lblFlIcon->setPixmap(labelIcon(lblFlIcon, ":/res/wind.png"));
     lblFlIcon->setAlignment(Qt::AlignCenter);
 
     hItem0->addWidget(lblFlIcon);
@@ -271,21 +404,13 @@ void Widget::initLeft()
     QVBoxLayout* vItem0 = new QVBoxLayout();
     lblFx = new QLabel(this);
     lblFx->setText("NW Wind");  // ***** TBC *****
-    lblFx->setStyleSheet(R"(
-        font: 10pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 24px 0px 0px 0px;
-    )");
+    lblFx->setProperty("role", "infoTitle");
     lblFx->setAlignment(Qt::AlignCenter);
     vItem0->addWidget(lblFx);
 
     lblFl = new QLabel(this);
     lblFl->setText("Level 3");  // ***** TBC *****
-    lblFl->setStyleSheet(R"(
-        font: bold 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblFl->setProperty("role", "infoValue");
     lblFl->setAlignment(Qt::AlignCenter);
     vItem0->addWidget(lblFl);
     hItem0->addLayout(vItem0);
@@ -297,9 +422,8 @@ void Widget::initLeft()
 
     lblPM25Icon = new QLabel(this);
     lblPM25Icon->setFixedSize(72, 72);
-    lblPM25Icon->setStyleSheet("background-color: rgba(255,255,255,0);");
-    lblPM25Icon->setPixmap(QPixmap(":/res/wind.png"));
-    lblPM25Icon->setScaledContents(true);
+    lblPM25Icon->setProperty("role", "icon");
+    lblPM25Icon->setPixmap(labelIcon(lblPM25Icon, ":/res/wind.png"));
     lblPM25Icon->setAlignment(Qt::AlignCenter);
 
     hItem1->addWidget(lblPM25Icon);
@@ -307,21 +431,13 @@ void Widget::initLeft()
     QVBoxLayout* vItem1 = new QVBoxLayout();
     lblPM25Title = new QLabel(this);
     lblPM25Title->setText("PM2.5");
-    lblPM25Title->setStyleSheet(R"(
-        font: 10pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 24px 0px 0px 0px;
-    )");
+    lblPM25Title->setProperty("role", "infoTitle");
     lblPM25Title->setAlignment(Qt::AlignCenter);
     vItem1->addWidget(lblPM25Title);
 
     lblPM25 = new QLabel(this);
     lblPM25->setText("47");     // ***** TBC *****
-    lblPM25->setStyleSheet(R"(
-        font: bold 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblPM25->setProperty("role", "infoValue");
     lblPM25->setAlignment(Qt::AlignCenter);
     vItem1->addWidget(lblPM25);
     hItem1->addLayout(vItem1);
@@ -333,9 +449,8 @@ void Widget::initLeft()
 
     lblHumidityIcon = new QLabel(this);
     lblHumidityIcon->setFixedSize(72, 72);
-    lblHumidityIcon->setStyleSheet("background-color: rgba(255,255,255,0);");
-    lblHumidityIcon->setPixmap(QPixmap(":/res/wind.png"));
-    lblHumidityIcon->setScaledContents(true);
+    lblHumidityIcon->setProperty("role", "icon");
+    lblHumidityIcon->setPixmap(labelIcon(lblHumidityIcon, ":/res/wind.png"));
     lblHumidityIcon->setAlignment(Qt::AlignCenter);
 
     hItem2->addWidget(lblHumidityIcon);
@@ -343,21 +458,13 @@ void Widget::initLeft()
     QVBoxLayout* vItem2 = new QVBoxLayout();
     lblHumidityTitle = new QLabel(this);
     lblHumidityTitle->setText("Moisture");
-    lblHumidityTitle->setStyleSheet(R"(
-        font: 10pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 24px 0px 0px 0px;
-    )");
+    lblHumidityTitle->setProperty("role", "infoTitle");
     lblHumidityTitle->setAlignment(Qt::AlignCenter);
     vItem2->addWidget(lblHumidityTitle);
 
     lblHumidity = new QLabel(this);
     lblHumidity->setText("50%");    // ***** TBC *****
-    lblHumidity->setStyleSheet(R"(
-        font: bold 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblHumidity->setProperty("role", "infoValue");
     lblHumidity->setAlignment(Qt::AlignCenter);
     vItem2->addWidget(lblHumidity);
     hItem2->addLayout(vItem2);
@@ -369,9 +476,8 @@ void Widget::initLeft()
 
     lblQualityIcon = new QLabel(this);
     lblQualityIcon->setFixedSize(72, 72);
-    lblQualityIcon->setStyleSheet("background-color: rgba(255,255,255,0);");
-    lblQualityIcon->setPixmap(QPixmap(":/res/wind.png"));
-    lblQualityIcon->setScaledContents(true);
+    lblQualityIcon->setProperty("role", "icon");
+    lblQualityIcon->setPixmap(labelIcon(lblQualityIcon, ":/res/wind.png"));
     lblQualityIcon->setAlignment(Qt::AlignCenter);
 
     hItem3->addWidget(lblQualityIcon);
@@ -379,21 +485,13 @@ void Widget::initLeft()
     QVBoxLayout* vItem3 = new QVBoxLayout();
     lblQualityTitle = new QLabel(this);
     lblQualityTitle->setText("Air Quality");
-    lblQualityTitle->setStyleSheet(R"(
-        font: 10pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 24px 0px 0px 0px;
-    )");
+    lblQualityTitle->setProperty("role", "infoTitle");
     lblQualityTitle->setAlignment(Qt::AlignCenter);
     vItem3->addWidget(lblQualityTitle);
 
     lblQuality = new QLabel(this);
     lblQuality->setText("98");  // ***** TBC *****
-    lblQuality->setStyleSheet(R"(
-        font: bold 12pt Microsoft YaHei;
-        background-color: rgba(255,255,255,0);
-        padding: 0px 0px 24px 0px;
-    )");
+    lblQuality->setProperty("role", "infoValue");
     lblQuality->setAlignment(Qt::AlignCenter);
     vItem3->addWidget(lblQuality);
     hItem3->addLayout(vItem3);
@@ -404,447 +502,367 @@ void Widget::initLeft()
 
 void Widget::initRight()
 {
-    // 1. Week/Date
-    QGridLayout* gridLayout1 = new QGridLayout();
-    gridLayout1->setHorizontalSpacing(6);
-    gridLayout1->setVerticalSpacing(0);
-
-    QStringList weekList = {"Yesterday", "Today", "Tomorrow", "Tuesday", "Wednesday", "Thursday"};
-    // 0, 1, 2, 3, 4, 5, 6, 7
-    // QStringList weekList = {"Yesterday", "Today", "Tomorrow", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
-    QStringList dateList = {"12/30", "12/31", "01/01", "01/02", "01/03", "01/04"};  // ***** TBC *****
-
-    for ( int i = 0; i < weekList.size(); i++ ) {
-        QLabel* lblWeek = new QLabel(this);
-        QLabel* lblDate = new QLabel(this);
-        lblWeek->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblDate->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblWeek->setText(weekList[i]);
-        lblDate->setText(dateList[i]);
-        lblWeek->setStyleSheet(R"(
-            border-bottom-left-radius: 0px;
-            border-bottom-right-radius: 0px;
-            padding-bottom:2px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(10, 180,190);
-        )");
-        lblDate->setStyleSheet(R"(
-            border-top-left-radius: 0px;
-            border-top-right-radius: 0px;
-            padding-top:2px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(10, 180,190);
-        )");
-        lblWeek->setAlignment(Qt::AlignCenter);
-        lblDate->setAlignment(Qt::AlignCenter);
-
-        mWeekList << lblWeek;
-        mDateList << lblDate;
-
-        gridLayout1->addWidget(lblWeek, 0, i);
-        gridLayout1->addWidget(lblDate, 1, i);
+    // Week/Date, Weather Type, Air Quality, Weather Curve and Wind Speed of every day
+    mForecast = new ForecastStrip(this);
+    rightLayout->addWidget(mForecast);
+    rightLayout->addStretch();
+}
+
+void Widget::fetchCities(const QStringList& cityCodes)
+{
+    mScheduler->track(cityCodes);
+}
+
+void Widget::setLocation(double latitude, double longitude)
+{
+    mHasLocation = true;
+    mLatitude = latitude;
+    mLongitude = longitude;
+    locateCity();
+}
+
+void Widget::locateCity()
+{
+    CityStorePtr cities = mCities.current();
+    if ( !mHasLocation || cities->isEmpty() ) {
+        return;
     }
 
-    rightLayout->addLayout(gridLayout1);
-
-    // 2. Weather Type
-    QGridLayout* gridLayout2 = new QGridLayout();
-    gridLayout2->setHorizontalSpacing(6);
-    gridLayout2->setVerticalSpacing(0);
-
-    QMap<QString, QString> typeMap;
-    typeMap.insert("Heavy Snow", ":/res/DaXue.png");
-    typeMap.insert("Sunny", ":/res/Qing.png");
-    typeMap.insert("Light Rain", ":/res/XiaoYu.png");
-    typeMap.insert("Thunderstorm", ":/res/LeiZhenYu.png");
-    typeMap.insert("Snow", ":/res/Xue.png");
-    typeMap.insert("Cloudy", ":/res/DuoYun.png");
-
-    QList<QString> keys = typeMap.keys();
-    for ( int i = 0; i < keys.size(); i++ ) {
-        QLabel* lblTypeIcon = new QLabel(this);
-        QLabel* lblType = new QLabel(this);
-        lblTypeIcon->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblType->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblTypeIcon->setPixmap(typeMap[keys[i]]);
-        lblType->setText(keys[i]);
-        lblTypeIcon->setStyleSheet(R"(
-            border-bottom-left-radius: 0px;
-            border-bottom-right-radius: 0px;
-            padding-bottom:2px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(54, 93,122);
-        )");
-        lblType->setStyleSheet(R"(
-            border-top-left-radius: 0px;
-            border-top-right-radius: 0px;
-            padding-top:2px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(54, 93,122);
-        )");
-        lblTypeIcon->setAlignment(Qt::AlignCenter);
-        lblType->setAlignment(Qt::AlignCenter);
-
-        mTypeIconList << lblTypeIcon;
-        mTypeList << lblType;
-
-        gridLayout2->addWidget(lblTypeIcon, 0, i);
-        gridLayout2->addWidget(lblType, 1, i);
+    // cities are never removed, a new size means new positions. They are
+    // indexed on the loader's pool, the city is located when that is done
+    if ( mGeoIndexed != cities->size() ) {
+        if ( mGeoIndexing != cities->size() ) {
+            mGeoIndexing = cities->size();
+            mDataLoader->buildGeoIndex(cities);
+        }
+        return;
     }
-    rightLayout->addLayout(gridLayout2);
-
-    // 3. Air Quality
-    QWidget* qualityWidget = new QWidget(this);
-    qualityWidget->setStyleSheet("background-color: rgba(51,115,163,255);");
-    qualityWidget->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-    QHBoxLayout* hLayout = new QHBoxLayout(qualityWidget);
-    hLayout->setSpacing(6);
-    hLayout->setContentsMargins(0, 0, 0, 0);
-
-    QStringList qualityList = {"Good", "Fair", "Light Pollution", "Medium Pollution", "Heavy Pollution", "Severe Pollution"};
-    QStringList qualityBgList;
-    qualityBgList << "rgb(121, 184, 0)"
-                  << "rgb(255, 187, 23)"
-                  << "rgb(255, 87, 97)"
-                  << "rgb(235, 17, 27)"
-                  << "rgb(170, 0, 0)"
-                  << "rgb(110, 0, 0)";
-    for ( int i = 0; i < qualityList.size(); i++ ) {
-        QLabel* lblQuality = new QLabel(this);
-        lblQuality->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblQuality->setText(qualityList[i]);
-        lblQuality->setStyleSheet(QString("padding:8px; background-color:%1;").arg(qualityBgList[i]));
-        lblQuality->setAlignment(Qt::AlignCenter);
-
-        mAqiList << lblQuality;
-
-        hLayout->addWidget(lblQuality);
+
+    QVector<GeoMatch> nearest = mGeoIndex.nearest(mLatitude, mLongitude);
+    if ( nearest.isEmpty() ) {
+        return;
     }
-    rightLayout->addWidget(qualityWidget);
+    qCDebug(lcWeatherPerf) << "Location" << mLatitude << mLongitude << "is" << nearest.first().km << "km from"
+                           << cities->view(int(nearest.first().id)).city();
+    mScheduler->jumpTo(int(nearest.first().id));
+}
 
-    // 4. Weather Curve
-    QVBoxLayout* vLayout = new QVBoxLayout();
-    vLayout->setSpacing(0);
-
-    lblHigh = new QLabel(this);
-    lblHigh->setMinimumHeight(80);
-    lblHigh->setStyleSheet(R"(
-            border-bottom-left-radius: 0px;
-            border-bottom-right-radius: 0px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(54, 93,122);
-        )");
-
-    lblLow = new QLabel(this);
-    lblLow->setMinimumHeight(80);
-    lblLow->setStyleSheet(R"(
-            border-top-left-radius: 0px;
-            border-top-right-radius: 0px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(54, 93,122);
-        )");
-    lblHigh->installEventFilter(this);  // lblHigh->update()  Paint
-    lblLow->installEventFilter(this);
-    vLayout->addWidget(lblHigh);
-    vLayout->addWidget(lblLow);
-    rightLayout->addLayout(vLayout);
-
-    // 5. Wind Speed
-    QGridLayout* gridLayout3 = new QGridLayout();
-    gridLayout3->setHorizontalSpacing(6);
-    gridLayout3->setVerticalSpacing(0);
-
-    // ***** TBC *****
-    QStringList fxList = {"N Wind", "N Wind", "E Wind", "S Wind", "N Wind", "NE Wind"};
-    QStringList flList = {"Level 1", "Level 1", "Level 2", "Level 2", "Level 3", "Level 1"};
-    // ***** TBC *****
-
-    for ( int i = 0; i < fxList.size(); i++ ) {
-        QLabel* lblFx = new QLabel(this);
-        QLabel* lblFl = new QLabel(this);
-        lblFx->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblFl->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
-        lblFx->setText(fxList[i]);
-        lblFl->setText(flList[i]);
-        lblFx->setStyleSheet(R"(
-            border-bottom-left-radius: 0px;
-            border-bottom-right-radius: 0px;
-            padding-bottom:2px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(54, 93,122);
-        )");
-        lblFl->setStyleSheet(R"(
-            border-top-left-radius: 0px;
-            border-top-right-radius: 0px;
-            padding-top:2px;
-            padding-left:20px;
-            padding-right:20px;
-            background-color: rgb(54, 93,122);
-        )");
-        lblFx->setAlignment(Qt::AlignCenter);
-        lblFl->setAlignment(Qt::AlignCenter);
-
-        mFxList << lblFx;
-        mFlList << lblFl;
-
-        gridLayout3->addWidget(lblFx, 0, i);
-        gridLayout3->addWidget(lblFl, 1, i);
+void Widget::onCitiesLoaded(const CityStorePtr& store, const QString& source)
+{
+    bool first = mCities.current()->isEmpty();
+    if ( first && source == mSnapshotPath ) {
+        mSavedGeneration = store->generation();  // adopted as is, already on disk
     }
+    mCities.merge(store);
+    emit citiesChanged(mCities.current());
 
-    rightLayout->addLayout(gridLayout3);
+    CityStorePtr cities = mCities.current();
+    if ( first && !cities->isEmpty() ) {
+        cityIndex = 0;
+        mLastMutations = applySnapshot(displaySnapshot(cities->view(cityIndex)));
+        qCDebug(lcWeatherPerf) << "First data after" << mStartup.elapsed() << "ms," << store->size() << "cities from" << source;
+    }
+    locateCity();
 }
 
-void Widget::paintHighCurve()
+void Widget::onWeatherReady(const QString& cityCode, const WeatherInfo& info)
 {
-    WeatherInfo info = weatherInfoList[cityIndex];
+    // every publish copies the whole store (on a worker), so single results join the next batch
+    CityUpdate update{cityCode, info};
+    if ( !mUpdateQueue->tryPush(update) ) {
+        update.time = QDateTime::currentSecsSinceEpoch();
+        onCityUpdates({update});
+    }
+}
+
+void Widget::onCityUpdates(const QVector<CityUpdate>& updates)
+{
+    // one snapshot per batch, not one per city
+    QVector<WeatherInfo> infos;
+    infos.reserve(updates.size());
+    for ( const CityUpdate& update : updates ) {
+        // readings of updates coalesced into this one first, the history keeps them all
+        for ( const Observation& observation : update.earlier ) {
+            mHistory.append(update.info.city, observation);
+        }
+        mHistory.record(update.info, update.time);
+        infos.append(update.info);
+        infos.last().code = update.code;  // cities are told apart by code, names repeat
+        mScheduler->markFetched(update.code, update.info.city);
+    }
+    // copied and updated on the publisher's worker, announced when it is swapped in
+    mCities.publishLater(infos);
+}
 
-    QPainter painter(lblHigh);
+void Widget::onCitiesPublished()
+{
+    emit citiesChanged(mCities.current());
 
-    // Anti-Aliasing
-    painter.setRenderHint(QPainter::Antialiasing, true);
+    // the shown city may be among them, unchanged cities cost nothing
+    updateUI();
+}
 
-    // 1. Set x-axis Coordinates
-    int pointX[6] = {0};
-    for ( int i = 0; i < 6; i++ ) {
-        pointX[i] = mAqiList[i]->pos().x() + mAqiList[i]->width() / 2;
+void Widget::prepareCity(int index)
+{
+    CityStorePtr cities = mCities.current();
+    if ( index >= cities->size() ) {
+        return;
     }
 
-    // 2. Set y-axis Coordinates
-    int tempSum = 0;
-    int tempAverage = 0;
+    QElapsedTimer prepare;
+    prepare.start();
 
-    // 2.1 Calculate Average
-    for ( int i = 0; i < 6; i++ ) {
-        tempSum += info.highTemp[i];
-    }
-    tempAverage = tempSum / 6;
+    // 1. Freeze the current city, 2. switch the labels underneath, 3. render them offscreen
+    mSwap->cover(renderFrame());
+    cityIndex = index;
+    mLastMutations = applySnapshot(displaySnapshot(cities->view(cityIndex)));
+    mainLayout->activate();
+    mSwap->setNext(renderFrame());
+    mPreparedIndex = index;
+
+    qCDebug(lcWeatherPerf) << "prepareCity:" << mLastMutations << "widget mutations, rendered in" << prepare.nsecsElapsed() / 1000 << "us";
+}
 
-    // 2.2 Calculate y-axis Coordinates
-    int pointY[6] = {0};
-    int yCenter = lblHigh->height() / 2;
-    for ( int i = 0; i < 6; i++ ) {
-        pointY[i] = yCenter - ((info.highTemp[i] - tempAverage) * INCREMENT);
+void Widget::showCity(int index)
+{
+    QElapsedTimer swap;
+    swap.start();
+
+    // the labels already show the city, only the buffer changes on screen
+    if ( index == mPreparedIndex && mSwap->isCovering() ) {
+        mPreparedIndex = -1;
+        mSwap->swap(isVisible() ? mFadeMs : 0);
+        qCDebug(lcWeatherPerf) << "showCity: swapped in" << swap.nsecsElapsed() / 1000 << "us";
+        return;
     }
 
-    // 3. Start Drawing
-    // 3.1 Initialize Pen
-    QPen pen = painter.pen();
-    pen.setWidth(1);                    // Pen Thickness
-    pen.setColor(QColor(255, 170, 0));  // Pen Color
-    painter.save();
+    // not prepared (or prepared for another city, e.g. a jump), the prepared
+    // frame is dropped and the labels switch in place
+    mPreparedIndex = -1;
+    mSwap->swap(0);
+    cityIndex = index;
+    updateUI();
+}
 
-    painter.setPen(pen);
-    painter.setBrush(QColor(255, 170, 0));  // Brush Color
+void Widget::onSearchResults(const QString& query, const QVector<GazetteerMatch>& matches)
+{
+    // typed on meanwhile, newer results follow
+    if ( query != leCity->text() ) {
+        return;
+    }
 
-    // 3.2 Draw dots and texts
-    for ( int i = 0; i < 6; i++ ) {
-        painter.drawEllipse(QPoint(pointX[i], pointY[i]), POINT_RADIUS, POINT_RADIUS);
-        painter.drawText(QPoint(pointX[i] - TEXT_OFFSET_X, pointY[i] - TEXT_OFFSET_Y), QString::number(info.highTemp[i]) + "°");
+    QStringList names;
+    names.reserve(matches.size());
+    for ( const GazetteerMatch& match : matches ) {
+        names.append(match.name);
     }
+    mCompletions->setStringList(names);
 
-    // 3.3 Draw Curve
-    for ( int i = 0; i < 5; i++ ) {
-        if ( i == 0 ) {
-            pen.setStyle(Qt::DotLine);
-            painter.setPen(pen);
-        } else {
-            pen.setStyle(Qt::SolidLine);
-            painter.setPen(pen);
-        }
-        painter.drawLine(pointX[i], pointY[i], pointX[i + 1], pointY[i + 1]);
+    if ( names.isEmpty() ) {
+        mCompleter->popup()->hide();
+    } else {
+        mCompleter->complete();
     }
+}
+
+void Widget::searchCity(const QString& text)
+{
+    GazetteerMatch match = mSearch->find(text);
+    if ( match.entry < 0 ) {
+        qWarning() << "Unknown city" << text;
+        return;
+    }
+    mCompleter->popup()->hide();
 
-    painter.restore();
+    // shown right away when published already, fetched now either way
+    CityStorePtr cities = mCities.current();
+    CityHandle handle = cities->findCode(match.code);
+    if ( !handle.isValid() ) {
+        handle = cities->find(match.name);
+    }
+    if ( handle.isValid() ) {
+        mScheduler->jumpTo(int(handle.index));
+    }
+    mScheduler->refetch(match.code);
 }
 
-void Widget::paintLowCurve()
+QPixmap Widget::renderFrame()
 {
-    WeatherInfo info = weatherInfoList[cityIndex];
+    qreal dpr = devicePixelRatioF();
+    QPixmap frame(size() * dpr);
+    frame.setDevicePixelRatio(dpr);
 
-    QPainter painter(lblLow);
+    QPainter painter(&frame);
+    painter.fillRect(rect(), palette().brush(backgroundRole()));
 
-    // Anti-Aliasing
-    painter.setRenderHint(QPainter::Antialiasing, true);
+    // every child but the overlay, so the frame is what the overlay covers
+    for ( QWidget* child : findChildren<QWidget*>(QString(), Qt::FindDirectChildrenOnly) ) {
+        if ( child != mSwap && child->isVisible() ) {
+            child->render(&painter, child->pos());
+        }
+    }
+    return frame;
+}
 
-    // 1. Set x-axis coordinates
-    int pointX[6] = {0};
-    for ( int i = 0; i < 6; i++ ) {
-        pointX[i] = mAqiList[i]->pos().x() + mAqiList[i]->width() / 2;
+void Widget::updateUI()
+{
+    // pinned for the whole update, writers publish new snapshots meanwhile
+    CityStorePtr cities = mCities.current();
+    if ( cities->isEmpty() || !mScheduler->isActive() ) {
+        return;
+    }
+    if ( cityIndex >= cities->size() ) {
+        cityIndex = 0;
     }
 
-    // 2. Set y-axis coordinates
-    int tempSum = 0;
-    int tempAverage = 0;
+    CityView info = cities->view(cityIndex);
 
-    // 2.1 Calculate Average
-    for ( int i = 0; i < 6; i++ ) {
-        tempSum += info.lowTemp[i];
+    // this version of the city is already on screen
+    if ( mShownValid && mShown.handle == info.handle() && mShown.version == info.version()
+         && qFuzzyCompare(mShown.dpr, devicePixelRatioF()) ) {
+        mLastMutations = 0;
+        return;
     }
-    tempAverage = tempSum / 6;
 
-    // 2.2 Calculate y-axis Coordinates
-    int pointY[6] = {0};
-    int yCenter = lblLow->height() / 2;
-    for ( int i = 0; i < 6; i++ ) {
-        pointY[i] = yCenter - ((info.lowTemp[i] - tempAverage) * INCREMENT);
+    // 1. Build what should be on screen, 2. touch only what differs from what is shown
+    QElapsedTimer apply;
+    apply.start();
+    mLastMutations = applySnapshot(displaySnapshot(info));
+
+    // labels changed under a prepared frame, render it again
+    if ( mLastMutations > 0 && mSwap->isCovering() ) {
+        mainLayout->activate();
+        mSwap->setNext(renderFrame());
     }
 
-    // 3. Start Drawing
-    // 3.1 Initialize Pen
-    QPen pen = painter.pen();
-    pen.setWidth(1);                    // Pen Thickness
-    pen.setColor(QColor(0, 255, 255));  // Pen Color
-    painter.save();
+    qCDebug(lcWeatherPerf) << "updateUI:" << mLastMutations << "widget mutations in" << apply.nsecsElapsed() / 1000 << "us";
+}
 
-    painter.setPen(pen);
-    painter.setBrush(QColor(0, 255, 255));  // Brush Color
+DisplaySnapshot Widget::placeholderSnapshot() const
+{
+    static const char* const fixedWeek[] = {"Yesterday", "Today", "Tomorrow"};
+    const QString none("--");
+
+    DisplaySnapshot snap;
+    snap.date = none;
+    snap.temp = none;
+    snap.city = none;
+    snap.typeLabel = none;
+    snap.lowHigh = none;
+    snap.ganMao = none;
+    snap.fx = none;
+    snap.fl = none;
+    snap.pm25 = none;
+    snap.humidity = none;
+    snap.quality = none;
+    snap.dpr = devicePixelRatioF();
+
+    snap.days.resize(SHOWN_DAYS);
+    for ( int i = 0; i < snap.days.size(); i++ ) {
+        DayDisplay& day = snap.days[i];
+        day.week = i < 3 ? QString(fixedWeek[i]) : none;
+        day.date = none;
+        day.fx = none;
+        day.fl = none;
+    }
+    return snap;
+}
 
-    // 3.2 Draw dots and texts
-    for ( int i = 0; i < 6; i++ ) {
-        painter.drawEllipse(QPoint(pointX[i], pointY[i]), POINT_RADIUS, POINT_RADIUS);
-        painter.drawText(QPoint(pointX[i] - TEXT_OFFSET_X, pointY[i] - TEXT_OFFSET_Y), QString::number(info.lowTemp[i]) + "°");
+DisplaySnapshot Widget::displaySnapshot(const CityView& info) const
+{
+    DisplaySnapshot snap;
+    snap.handle = info.handle();
+    snap.version = info.version();
+
+    // 1. Date, Weather Type, City, Temperature
+    snap.date = info.dateWeek();
+    snap.temp = QString::number(info.temp()) + "°";
+    snap.city = info.city();
+    snap.ganMao = "Sickness Likelihood：" + info.ganMao();
+    snap.pm25 = QString::number(info.pm25());
+    snap.humidity = QString::number(info.humidity()) + "%";
+    snap.dpr = devicePixelRatioF();
+
+    // today, or the last day a sparse feed sent; none at all shows the placeholders
+    if ( info.dayCount() > 0 ) {
+        int today = qMin(1, info.dayCount() - 1);
+        snap.type = info.type(today);
+        snap.typeLabel = info.typeLabel(today);
+        snap.lowHigh = QString::number(info.lowTemp(today)) + "~" + QString::number(info.highTemp(today)) + "°";
+        snap.fx = info.fx(today);
+        snap.fl = "Level" + QString::number(info.fl(today));
+        snap.quality = QString::number(info.aqi(today));
+    } else {
+        const QString none("--");
+        snap.type = WeatherType::Unknown;
+        snap.typeLabel = none;
+        snap.lowHigh = none;
+        snap.fx = none;
+        snap.fl = none;
+        snap.quality = none;
     }
 
-    // 3.3 Draw Curve
-    for ( int i = 0; i < 5; i++ ) {
-        if ( i == 0 ) {
-            pen.setStyle(Qt::DotLine);
-            painter.setPen(pen);
-        } else {
-            pen.setStyle(Qt::SolidLine);
-            painter.setPen(pen);
-        }
-        painter.drawLine(pointX[i], pointY[i], pointX[i + 1], pointY[i + 1]);
+    // 2. Days, the store keeps the whole forecast
+    static const char* const fixedWeek[] = {"Yesterday", "Today", "Tomorrow"};
+    int count = qMin(info.dayCount(), SHOWN_DAYS);
+    snap.days.resize(count);
+    for ( int i = 0; i < count; i++ ) {
+        DayDisplay& day = snap.days[i];
+        day.week = i < 3 ? QString(fixedWeek[i]) : info.week(i);
+        day.date = info.date(i);
+        day.type = info.type(i);
+        day.aqiBand = Theme::aqiBand(info.aqi(i));
+        day.fx = info.fx(i);
+        day.fl = "Level" + QString::number(info.fl(i));
     }
 
-    painter.restore();
-}
+    // 3. Curves
+    snap.highTemp = QVector<qint8>(info.highTemps(), info.highTemps() + count);
+    snap.lowTemp = QVector<qint8>(info.lowTemps(), info.lowTemps() + count);
 
-void Widget::initData()
-{
-    // 1. Initialize Weather Type and Corresponding Icons
-    mTypeMap.insert("Heavy Snow", ":/res/BaoXue.png");
-    mTypeMap.insert("Heavy Rain", ":/res/BaoYu.png");
-    mTypeMap.insert("Big Heavy Rain", ":/res/DaBaoYu.png");
-    mTypeMap.insert("Extreme Heavy Rain", ":/res/TeDaBaoYu.png");
-    mTypeMap.insert("Big Snow", ":/res/DaXue.png");
-    mTypeMap.insert("Big Rain", ":/res/DaYu.png");
-    mTypeMap.insert("Ice Rain", ":/res/DongYu.png");
-    mTypeMap.insert("Cloudy", ":/res/DuoYun.png");
-    mTypeMap.insert("Thunderstorm", ":/res/LeiZhenYu.png");
-    mTypeMap.insert("Hail", ":/res/LeiZhenYuBanYouBingBao.png");
-    mTypeMap.insert("Haze", ":/res/Mai.png");
-    mTypeMap.insert("Sunny", ":/res/Qing.png");
-    mTypeMap.insert("undefined", ":/res/undefined.png");
-    mTypeMap.insert("Fog", ":/res/Wu.png");
-    mTypeMap.insert("Light Snow", ":/res/XiaoXue.png");
-    mTypeMap.insert("Drizzling", ":/res/XiaoYu.png");
-    mTypeMap.insert("Snow", ":/res/Xue.png");
-    mTypeMap.insert("Rain", ":/res/Yu.png");
-    mTypeMap.insert("Rain with Snow", ":/res/YuJiaXue.png");
-    mTypeMap.insert("Medium Snow", ":/res/ZhongXue.png");
-    mTypeMap.insert("Medium Rain", ":/res/ZhongYu.png");
-
-    // 2. City Weather Example
-    // 北京
-    WeatherInfo Merced;
-    Merced.city = "Merced";
-    Merced.dateWeek = "2024/04/26 Friday";
-    Merced.temp = 16;
-    Merced.ganMao = "Great for Outdoor Activities";
-    Merced.pm25 = 92;
-    Merced.humidity = 55;
-    Merced.quality = "Good";
-    Merced.weekList = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
-    Merced.dateList = {"04/25", "04/26", "04/27", "04/28", "04/29", "04/30"};
-    Merced.typeList = {"Sunny", "Sunny", "Cloudy", "Sunny", "Cloudy", "Drizzling"};
-    Merced.qualityList = {12, 45, 156, 88, 23, 9};
-    Merced.highTemp = {20, 26, 22, 28, 25, 30};
-    Merced.lowTemp = {5, 9, 6, 12, 11, 14};
-    Merced.fx = {"N Wind", "N Wind", "NW Wind", "S Wind", "NW Wind", "NE Wind"};
-    Merced.fl = {5, 10, 8, 12, 15, 18};
-
-
-    weatherInfoList.append(Merced);
+    return snap;
 }
 
-void Widget::updateUI()
+static int setTextIfChanged(QLabel* label, const QString& shown, const QString& next, bool force)
 {
-    cityIndex++;
-    if ( cityIndex > 3 ) {
-        cityIndex = 0;
+    if ( !force && shown == next ) {
+        return 0;
     }
+    label->setText(next);
+    return 1;
+}
 
-    WeatherInfo info = weatherInfoList[cityIndex];
+int Widget::applySnapshot(const DisplaySnapshot& next)
+{
+    const DisplaySnapshot& shown = mShown;
+    bool force = !mShownValid;
+    bool dprChanged = force || !qFuzzyCompare(shown.dpr, next.dpr);
+    int mutations = 0;
 
     // 1. Update Date
-    lblDate->setText(info.dateWeek);
+    mutations += setTextIfChanged(lblDate, shown.date, next.date, force);
 
     // 2. Update Weather Type, City, Temperature
-    lblTypeIcon->setPixmap(mTypeMap[info.typeList[1]]);
-    lblTemp->setText(QString::number(info.temp) + "°");
-    lblCity->setText(info.city);
-    lblType->setText(info.typeList[1]);
-    lblLowHigh->setText(QString::number(info.lowTemp[1]) + "~" + QString::number(info.highTemp[1]) + "°");
-
-    lblGanMao->setText("Sickness Likelihood：" + info.ganMao);
-
-    lblFx->setText(info.fx[1]);
-    lblFl->setText("Level" + QString::number(info.fl[1]));
-
-    lblPM25->setText(QString::number(info.pm25));
-    lblHumidity->setText(QString::number(info.humidity) + "%");
-    lblQuality->setText(QString::number(info.qualityList[1]));
-
-    // 3. Update 6 days
-    for ( int i = 0; i < 6; i++ ) {
-        // 3.1 Update Week and Date
-        mWeekList[i]->setText(info.weekList[i]);
-
-        mWeekList[0]->setText("Yesterday");
-        mWeekList[1]->setText("Today");
-        mWeekList[2]->setText("Tomorrow");
-
-        mDateList[i]->setText(info.dateList[i]);
-
-        // 3.2 Update Weather Type
-        mTypeIconList[i]->setPixmap(mTypeMap[info.typeList[i]]);
-        mTypeList[i]->setText(info.typeList[i]);
-
-        // 3.3 Update Air Quality
-        if ( info.qualityList[i] >= 0 && info.qualityList[i] <= 50 ) {
-            mAqiList[i]->setText("Good");
-            mAqiList[i]->setStyleSheet("background-color: rgb(121, 184, 0);");
-        } else if ( info.qualityList[i] >= 50 && info.qualityList[i] <= 100 ) {
-            mAqiList[i]->setText("Fair");
-            mAqiList[i]->setStyleSheet("background-color: rgb(255, 187, 23);");
-        } else if ( info.qualityList[i] >= 100 && info.qualityList[i] <= 150 ) {
-            mAqiList[i]->setText("Light Pollution");
-            mAqiList[i]->setStyleSheet("background-color: rgb(255, 87, 97);");
-        } else if ( info.qualityList[i] >= 150 && info.qualityList[i] <= 200 ) {
-            mAqiList[i]->setText("Medium Pollution");
-            mAqiList[i]->setStyleSheet("background-color: rgb(235, 17, 27);");
-        } else if ( info.qualityList[i] >= 200 && info.qualityList[i] <= 300 ) {
-            mAqiList[i]->setText("Heavy Pollution");
-            mAqiList[i]->setStyleSheet("background-color: rgb(170, 0, 0);");
-        } else {
-            mAqiList[i]->setText("Servere Pollution");
-            mAqiList[i]->setStyleSheet("background-color: rgb(110, 0, 0);");
-        }
-
-        // 3.4 Update Wind Direction/Speed
-        mFxList[i]->setText(info.fx[i]);
-        mFlList[i]->setText("Level" + QString::number(info.fl[i]));
+    if ( dprChanged || shown.type != next.type ) {
+        lblTypeIcon->setPixmap(labelIcon(lblTypeIcon, next.type));
+        mutations++;
     }
-
-    // 4. Draw Temperature Curve
-    lblHigh->update();
-    lblLow->update();
+    mutations += setTextIfChanged(lblTemp, shown.temp, next.temp, force);
+    mutations += setTextIfChanged(lblCity, shown.city, next.city, force);
+    mutations += setTextIfChanged(lblType, shown.typeLabel, next.typeLabel, force);
+    mutations += setTextIfChanged(lblLowHigh, shown.lowHigh, next.lowHigh, force);
+    mutations += setTextIfChanged(lblGanMao, shown.ganMao, next.ganMao, force);
+    mutations += setTextIfChanged(lblFx, shown.fx, next.fx, force);
+    mutations += setTextIfChanged(lblFl, shown.fl, next.fl, force);
+    mutations += setTextIfChanged(lblPM25, shown.pm25, next.pm25, force);
+    mutations += setTextIfChanged(lblHumidity, shown.humidity, next.humidity, force);
+    mutations += setTextIfChanged(lblQuality, shown.quality, next.quality, force);
+
+    // 3. Update Days and Temperature Curves, the strip repaints only the damaged cells
+    mutations += mForecast->setDays(next.days);
+    mutations += mForecast->setTemperatures(next.highTemp, next.lowTemp);
+
+    mShown = next;
+    mShownValid = true;
+    return mutations;
 }
@@ -2,29 +2,55 @@
 #define WIDGET_H
 
 #include <QWidget>
+#include <QElapsedTimer>
 #include <QMenu>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
-
-struct WeatherInfo {
+#include <QTimer>
+
+#include "CityHistory.h"
+#include "CityPublisher.h"
+#include "CityStore.h"
+#include "Gazetteer.h"
+#include "GeoIndex.h"
+#include "DataLoader.h"
+#include "ForecastStrip.h"
+#include "ResponseCache.h"
+
+class CitySearch;
+class CityUpdateQueue;
+class QCompleter;
+class QLineEdit;
+class QPushButton;
+class QStringListModel;
+class RefreshScheduler;
+class SwapOverlay;
+struct CityUpdate;
+class WeatherAPI;
+
+// What the labels currently show, so updateUI only touches labels that change.
+struct DisplaySnapshot {
+    CityHandle handle;  // city and version the snapshot was built from
+    quint32 version = 0;
+
+    QString date;
+    WeatherType type = WeatherType::Unknown;
+    QString temp;
     QString city;
-    QString dateWeek;
-    qint8 temp;
-
+    QString typeLabel;
+    QString lowHigh;
     QString ganMao;
-    qint8 pm25;
-    qint8 humidity;
+    QString fx;
+    QString fl;
+    QString pm25;
+    QString humidity;
     QString quality;
+    qreal dpr = 0;
 
-    QList<QString> weekList;
-    QList<QString> dateList;
-    QList<QString> typeList;
-    QList<qint16> qualityList;
-    QList<qint8> highTemp;
-    QList<qint8> lowTemp;
-    QList<QString> fx;
-    QList<qint8> fl;
+    QVector<DayDisplay> days;
+    QVector<qint8> highTemp;
+    QVector<qint8> lowTemp;
 };
 
 class Widget : public QWidget
@@ -35,24 +61,53 @@ public:
     Widget(QWidget* parent = nullptr);
     ~Widget();
 
+    CityStorePtr cities() const { return mCities.current(); }
+    const CityHistory& history() const { return mHistory; }
+    DataLoader* dataLoader() const { return mDataLoader; }
+    CitySearch* citySearch() const { return mSearch; }
+    WeatherAPI* weatherAPI() const { return mWeatherAPI; }
+    CityUpdateQueue* updateQueue() const { return mUpdateQueue; }
+    RefreshScheduler* scheduler() const { return mScheduler; }
+
+    // cross-fade between cities, 0 swaps at once
+    void setFadeDuration(int ms) { mFadeMs = ms; }
+    void fetchCities(const QStringList& cityCodes);
+    // shows the city closest to this position, now and whenever cities are added
+    void setLocation(double latitude, double longitude);
+
+signals:
+    void citiesChanged(const CityStorePtr& cities);  // after every publish
+
 protected:
     void contextMenuEvent(QContextMenuEvent* event);
 
     void mousePressEvent(QMouseEvent* event);
     void mouseMoveEvent(QMouseEvent* event);
-
-    bool eventFilter(QObject* watched, QEvent* event);
+    void paintEvent(QPaintEvent* event);
+    void showEvent(QShowEvent* event);
+    void hideEvent(QHideEvent* event);
+    void changeEvent(QEvent* event);
 
 private:
     void initTop();
     void initLeft();
     void initRight();
 
-    void paintHighCurve();
-    void paintLowCurve();
-
-    void initData();
     void updateUI();
+    void prepareCity(int index);
+    void showCity(int index);
+    QPixmap renderFrame();
+    void onCitiesLoaded(const CityStorePtr& store, const QString& source);
+    void onWeatherReady(const QString& cityCode, const WeatherInfo& info);
+    void onCityUpdates(const QVector<CityUpdate>& updates);
+    void onCitiesPublished();
+    void onSearchResults(const QString& query, const QVector<GazetteerMatch>& matches);
+    void searchCity(const QString& text);
+    void locateCity();
+
+    DisplaySnapshot placeholderSnapshot() const;
+    DisplaySnapshot displaySnapshot(const CityView& info) const;
+    int applySnapshot(const DisplaySnapshot& next);
 
 private:
     QMenu* mExitMenu;   // Right Click Exit Menu
@@ -65,6 +120,10 @@ private:
 
     ////////// top
     QHBoxLayout* topLayout;
+    QLineEdit* leCity;
+    QPushButton* btnSearch;
+    QCompleter* mCompleter;          // popup under leCity, filled by mSearch
+    QStringListModel* mCompletions;
     QLabel* lblDate;
 
     ////////// left side
@@ -99,23 +158,39 @@ private:
 
     ////////// right side
     QVBoxLayout* rightLayout;
-    QList<QLabel*> mWeekList;         // week list
-    QList<QLabel*> mDateList;         // date list
-
-    QList<QLabel*> mTypeList;         // weather list
-    QList<QLabel*> mTypeIconList;     // weather icon list
-    QMap<QString, QString> mTypeMap;  // weather type map ex: heavy rain -> :/res/DaYu.png
-
-    QList<QLabel*> mAqiList;  // weather index list
-
-    QLabel* lblHigh;  // high temp
-    QLabel* lblLow;   // low temp
-
-    QList<QLabel*> mFxList;  // wind direction list
-    QList<QLabel*> mFlList;  // wind strength list
-
-    // simulate multiple cities
-    QList<WeatherInfo> weatherInfoList;
-    qint8 cityIndex;
+    ForecastStrip* mForecast;  // week, date, weather, AQI, curves and wind of every day
+
+    DisplaySnapshot mShown;   // last applied snapshot
+    bool mShownValid = false;
+    int mLastMutations = 0;   // widget mutations made by the last updateUI
+
+    QElapsedTimer mStartup;  // time to first paint / first data
+    bool mPainted = false;
+
+    DataLoader* mDataLoader;
+    CitySearch* mSearch;
+    WeatherAPI* mWeatherAPI;
+    ResponseCache mResponseCache;
+    CityUpdateQueue* mUpdateQueue;  // fetch/parse workers -> UI
+    RefreshScheduler* mScheduler;   // rotation and refetching
+    SwapOverlay* mSwap;             // next city rendered ahead of its turn
+    int mPreparedIndex = -1;
+    int mFadeMs = 250;
+
+    CityPublisher mCities;
+    QTimer mSnapshotTimer;        // writes the snapshot once updates settle
+    QString mSnapshotPath;
+    quint64 mSavedGeneration = 0; // store generation on disk
+    CityHistory mHistory;         // every fetched reading, saved with the snapshot
+    QString mHistoryPath;
+    qint64 mSavedObservations = 0;
+    bool mHistoryLoading = false; // earlier readings still being read, not saved meanwhile
+    GeoIndex mGeoIndex;        // positions of mCities, rebuilt on the loader's pool when cities are added
+    int mGeoIndexed = -1;      // store size mGeoIndex was built for
+    int mGeoIndexing = -1;     // store size last sent to the loader to index
+    bool mHasLocation = false;
+    double mLatitude = 0;
+    double mLongitude = 0;
+    int cityIndex;  // shown city, picked by mScheduler
 };
 #endif  // WIDGET_H